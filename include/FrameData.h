@@ -0,0 +1,48 @@
+#ifndef FRAMEDATA_H
+#define FRAMEDATA_H
+
+#include <limits>
+#include <string>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "utils/Util.h"
+
+
+// Everything the render paths need to know about the current frame. Fixed size,
+// filled in once per frame by the scene and handed down by const reference.
+struct FrameData {
+    glm::mat4 matrices[3];      // Indexed with I_MVP, I_M and I_V
+    glm::vec3 cameraPosition;
+    float     lightSourcePower;
+    float     windVelocity;
+    float     currentTime;
+    glm::quat orientation;      // Rotation of the objects, drives the inertia of the fur
+    int       dynamicsMode;     // CPU_DYNAMICS or GPU_DYNAMICS
+    float     pixelsPerUnit;    // Pixels one unit covers at distance one, for screen size estimates
+    bool      shellLOD;         // Pick the number of shells from the screen size of the fur
+    bool      meshLOD;          // Pick the level of detail of the meshes from their screen size
+    int       furPath;          // VERTEX_SHELLS, or TESSELLATED_SHELLS when the GL supports it
+    int       shellBlending;    // BLENDED_SHELLS, ALPHA_TO_COVERAGE_SHELLS or WEIGHTED_OIT_SHELLS
+    bool      fins;             // Draw fins on the silhouettes along with the shells
+    bool      meshletCulling;   // Cull the shell meshlets on the GPU and draw them indirectly
+    bool      temporalShells;   // The shells are jittered down by up to one drawn spacing, see FrameUniforms
+    float     shellFraction;    // Cap on the shells per geometry from the quality governor, of the shells it has
+};
+
+
+// std140 mirror of the Frame uniform block, written to the stream buffer once per frame
+struct FrameUniforms {
+    glm::mat4 MVP;
+    glm::mat4 M;
+    glm::mat4 V;
+    glm::vec3 cameraPosition;
+    float     lightPower;
+    int       noiseDetail;      // From the quality governor, see QualitySettings
+    int       shellBlending;    // As in FrameData, the fur shader writes weights for WEIGHTED_OIT_SHELLS
+    float     shellJitter;      // Fraction of the drawn shell spacing the shells move down, 0 unless temporal
+    float     pad[1];
+};
+
+#endif // FRAMEDATA_H
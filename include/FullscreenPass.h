@@ -0,0 +1,58 @@
+/*
+ *	What the passes with targets of their own share: the framebuffer and
+ *	viewport to go back to, the size their targets were made for, and the
+ *	triangle that covers the viewport. The triangle comes from gl_VertexID in
+ *	fullscreenvertexshader.glsl, the vertex array it is drawn with is empty.
+ */
+#ifndef FULLSCREENPASS_H
+#define FULLSCREENPASS_H
+
+#include <GL/glew.h>
+
+#include "RenderState.h"
+
+
+class FullscreenPass {
+
+public:
+
+    FullscreenPass();
+
+    ~FullscreenPass();
+
+    // The targets start out at this size
+    void initialize(int, int);
+
+    // Remembers the bound framebuffer and viewport. The targets follow the viewport, which may be larger than
+    // WIDTH x HEIGHT on high DPI screens, true if they have to be resized to getWidth() x getHeight().
+    bool begin();
+
+    // Back to the framebuffer and viewport from begin()
+    void end();
+
+    // The triangle, with whatever program and textures are bound
+    void draw(RenderState &);
+
+    int  getWidth()                            { return mWidth; }
+
+    int  getHeight()                           { return mHeight; }
+
+private:
+
+    // Instance variables
+
+    int mWidth  = 0;
+
+    int mHeight = 0;
+
+    GLint mPreviousFramebuffer = 0;
+
+    GLint mPreviousViewport[4];
+
+
+    // Indices for the empty vertex array
+
+    GLuint vertexArrayID = 0;
+};
+
+#endif // FULLSCREENPASS_H
@@ -0,0 +1,138 @@
+#ifndef FURDYNAMICS_H
+#define FURDYNAMICS_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "utils/WorkerPool.h"
+#include "WindField.h"
+#include "FurParameters.h"
+
+
+// Forces on the fur in object space for one step, shared by the CPU and GPU dynamics.
+// Keeps the previous orientation around to turn rotation of the object into inertia.
+class FurForces {
+
+public:
+
+    void update(float, const glm::quat &, float);
+
+    // Forget the previous orientation, so that the next update doesn't see a jump as motion
+    void reset()                                      { mHasPrevious = false; }
+
+    // Clamped time step
+    float dt = 0.0f;
+
+    // Gravity in object space
+    glm::vec3 gravity;
+
+    // Object to world rotation, to look up the wind field
+    glm::mat3 toWorld;
+
+    // Maps a rest position to how far the tip falls behind this step, in fur lengths
+    glm::mat3 inertia;
+
+private:
+
+    glm::mat3 mPreviousRotation;
+
+    bool mHasPrevious = false;
+};
+
+
+// Damped spring per fur vertex. The state is the displacement of the fur tip relative to the
+// rest pose in object space, in units of the fur length, and the shells bend towards it.
+// Driven by gravity, the inertia of the fur when the object is rotated and the wind field.
+class FurDynamics {
+
+public:
+
+    FurDynamics();
+
+    ~FurDynamics();
+
+    void initialize(const std::vector<glm::vec3> &, const std::vector<glm::vec3> &);
+
+    // Integrates one step, orientation is the rotation of the object.
+    // The interleaved displacement is written to the output, or to our own copy when there is none.
+    void step(WorkerPool &, float, const glm::quat &, const WindField &, const FurParameters &, glm::vec3 *output = nullptr);
+
+    void reset()                                      { mForces.reset(); }
+
+    const std::vector<glm::vec3> &getDisplacement()   { return mDisplacement; }
+
+    // Interleaves the displacement into our own copy again, for when the output of the last step was lost
+    const std::vector<glm::vec3> &gatherDisplacement();
+
+    const std::vector<float> &getWindWeights()        { return mWindWeight; }
+
+    unsigned int getVertexCount()                     { return mVertexCount; }
+
+    float getStepTime()                               { return mStepTime; }
+
+    // The tip never bends further away than this, in fur lengths
+    static const float MAX_DISPLACEMENT;
+
+private:
+
+    // Functions
+
+    static void integrateJob(unsigned int, unsigned int, void *);
+
+    void integrate(unsigned int, unsigned int);
+
+
+    // Constants
+
+    static const unsigned int SIMD_WIDTH = 4;
+
+    static const unsigned int VERTICES_PER_JOB = 4096;
+
+
+    // Instance variables
+
+    unsigned int mVertexCount = 0;
+
+    FurForces mForces;
+
+    float mStepTime = 0.0f;
+
+
+    // Everything the kernel needs for one step, set up by step() before the jobs run
+    struct StepConstants {
+        float dt;
+        float stiffness;
+        float damping;
+        float maxDisplacement;
+        float force[3];
+        float inertia[9];
+    } mConstants;
+
+
+    // Containers, one array per component and padded to a multiple of SIMD_WIDTH
+
+    std::vector<float> mPositionX, mPositionY, mPositionZ;
+
+    std::vector<float> mNormalX, mNormalY, mNormalZ;
+
+    std::vector<float> mDisplacementX, mDisplacementY, mDisplacementZ;
+
+    std::vector<float> mVelocityX, mVelocityY, mVelocityZ;
+
+    std::vector<float> mWindWeight;
+
+    // Wind at each vertex this step, in object space and weighted, looked up from the field
+    std::vector<float> mWindX, mWindY, mWindZ;
+
+    // Interleaved copy of the displacement, in the layout the vertex buffer wants
+    std::vector<glm::vec3> mDisplacement;
+
+    // Where this step's interleaved displacement goes
+    glm::vec3 *mOutput = nullptr;
+
+    const WindField *mWindField = nullptr;
+};
+
+#endif // FURDYNAMICS_H
@@ -0,0 +1,70 @@
+#ifndef FURHEIGHTMAP_H
+#define FURHEIGHTMAP_H
+
+#include <vector>
+
+#include <GL/glew.h>
+#include "utils/GLStats.h"
+
+#include <glm/glm.hpp>
+
+#include "utils/WorkerPool.h"
+
+
+// Upper bound of the fur noise over the surface, 0 where the hair map has no fur at all. A texel
+// holds the largest noise value that linear filtering can return anywhere in it, and every mip level
+// the largest value of the four texels below it, so a lookup at any level is conservative.
+// The fur shader rejects fragments of shells above it before doing any noise, and the CPU uses it
+// to find the highest shell each triangle can reach.
+class FurHeightMap {
+
+public:
+
+    FurHeightMap();
+
+    ~FurHeightMap();
+
+    // The RGBA noise texture and the red channel of the hair map, the hair map may be empty
+    void initialize(WorkerPool &, const std::vector<GLubyte> &, int, int, const std::vector<GLubyte> &, int, int);
+
+    // Largest value under the UV footprint of each triangle, 0 for the triangles the hair map leaves bald
+    void classify(WorkerPool &, const std::vector<glm::vec2> &, const std::vector<unsigned int> &, std::vector<unsigned char> &) const;
+
+    GLuint getTexture()                      { return textureID; }
+
+private:
+
+    // Functions
+
+    static void buildJob(unsigned int, unsigned int, void *);
+
+    static void classifyJob(unsigned int, unsigned int, void *);
+
+    unsigned char footprintMax(const glm::vec2 &, const glm::vec2 &, const glm::vec2 &) const;
+
+
+    // Constants
+
+    static const unsigned int ROWS_PER_JOB = 16;
+
+    static const unsigned int TRIANGLES_PER_JOB = 1024;
+
+
+    // Indices for the texture
+
+    GLuint textureID = 0;
+
+
+    // Containers
+
+    struct Level {
+        int width;
+        int height;
+        std::vector<GLubyte> texels;
+    };
+
+    // Finest first, down to 1 x 1
+    std::vector<Level> mLevels;
+};
+
+#endif // FURHEIGHTMAP_H
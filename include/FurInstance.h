@@ -0,0 +1,19 @@
+#ifndef FURINSTANCE_H
+#define FURINSTANCE_H
+
+#include <glm/glm.hpp>
+
+
+// One copy of a geometry, read by the shaders as per instance vertex attributes. All copies
+// share the mesh, the textures, the fur parameters and the fur dynamics.
+struct FurInstance {
+    glm::mat4 transform = glm::mat4(1.0f);   // Applied before the model matrix of the scene
+    glm::vec3 tint      = glm::vec3(1.0f);   // Multiplies the fur color
+    float     seed      = 0.0f;              // Moves the fur pattern and length noise
+};
+
+// Vertex attributes of the instance, the transform takes four of them, one per column
+#define INSTANCE_TRANSFORM_ATTRIBUTE	4
+#define INSTANCE_TINT_SEED_ATTRIBUTE	8
+
+#endif // FURINSTANCE_H
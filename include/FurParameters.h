@@ -0,0 +1,70 @@
+#ifndef FURPARAMETERS_H
+#define FURPARAMETERS_H
+
+#include <glm/glm.hpp>
+
+
+// Everything the user can tweak on a geometry. Whoever writes to the block bumps
+// the version, and the geometry only recomputes derived state when it changes.
+struct FurParameters {
+
+    // Skin material
+    glm::vec3 color        = glm::vec3(1.0f, 1.0f, 1.0f);
+    glm::vec3 ambient      = glm::vec3(0.3f, 0.3f, 0.3f);
+    glm::vec3 diffuse      = glm::vec3(0.8f, 0.8f, 0.8f);
+    glm::vec3 specular     = glm::vec3(1.0f, 1.0f, 1.0f);
+    float transparency     = 1.0f;
+    float specularity      = 25.0f;
+    float shinyness        = 0.3f;
+
+    // Fur
+    glm::vec3 furColor     = glm::vec3(0.71f, 0.55f, 0.34f);
+    float furLength        = 0.15f;
+    float furNoiseLengthVariation = 0.2f;
+    float furNoiseSampleScale     = 1.5f;
+    float furPatternScale  = 4.0f;
+    int noiseType          = 0;
+
+    // Fur dynamics, spring stiffness and damping of the strands
+    float furStiffness     = 80.0f;
+    float furDamping       = 8.0f;
+
+    unsigned int version   = 0;
+};
+
+
+// std140 mirrors of the uniform blocks in the shaders, only uploaded when the version changes
+
+struct MaterialBlock {
+    glm::vec3 color;
+    float     pad0;
+    glm::vec3 ambientColor;
+    float     pad1;
+    glm::vec3 diffuseColor;
+    float     pad2;
+    glm::vec3 specularColor;
+    float     transparency;
+    float     specularity;
+    float     shinyness;
+    int       skinLayer;        // Layer of the skin texture array
+    float     pad3;
+};
+
+struct FurBlock {
+    glm::vec3 furColor;
+    float     furLength;
+    float     furNoiseLengthVariation;
+    float     furNoiseSampleScale;
+    float     furPatternScale;
+    int       noiseType;
+    int       noiseLayer;       // Layers of the noise and hair map texture arrays
+    int       hairMapLayer;
+    float     heightMargin;     // How far above the fur the shells are skipped, HEIGHT_MARGIN in Geometry.cpp
+    float     pad;              // std140 rounds the block up to 48 bytes
+};
+
+// Bound as a whole, so the buffers must be at least as large as the blocks in the shaders
+static_assert(sizeof(MaterialBlock) % 16 == 0, "MaterialBlock must match its std140 size");
+static_assert(sizeof(FurBlock) % 16 == 0, "FurBlock must match its std140 size");
+
+#endif // FURPARAMETERS_H
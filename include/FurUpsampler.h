@@ -0,0 +1,87 @@
+/*
+ *	Draws the fur shells into a reduced resolution target and brings them back
+ *	with a depth aware (joint bilateral) upsample. The skins are drawn at full
+ *	resolution as usual, then once more depth only into a full resolution depth
+ *	texture, which is point sampled down to hide the fur behind them. When
+ *	compositing, each pixel mixes the four nearest fur texels, weighted by how
+ *	close their skin depth is to its own, so the fur doesn't bleed over edges.
+ */
+#ifndef FURUPSAMPLER_H
+#define FURUPSAMPLER_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "RenderState.h"
+#include "FullscreenPass.h"
+
+
+class FurUpsampler {
+
+public:
+
+    FurUpsampler();
+
+    ~FurUpsampler();
+
+    // Takes the composite program, without one the fur stays at full resolution
+    void initialize(GLuint);
+
+    // Binds the full resolution depth target and clears it, the skins go in next
+    void begin(RenderState &);
+
+    // Binds the fur target at the given fraction of the resolution, with the skin depth scaled down into it
+    void accumulate(RenderState &, float);
+
+    // Back to the framebuffer that was bound in begin(), and blends the upsampled fur over it
+    void composite(RenderState &, const glm::mat4 &);
+
+    bool isAvailable()                         { return compositeProgram != 0; }
+
+private:
+
+    // Functions
+
+    bool resize(int, int);
+
+
+    // Instance variables
+
+    // Full resolution size of the targets, and the framebuffer composite() returns to
+    FullscreenPass mPass;
+
+    // Size of the part of the fur target in use
+    int mFurWidth  = 0;
+
+    int mFurHeight = 0;
+
+    float mScale = 1.0f;
+
+
+    // Indices for the framebuffers, their attachments and the composite pass
+
+    GLuint depthFramebufferID = 0;
+
+    GLuint depthTextureID = 0;
+
+    // Allocated at full size, lower resolutions only use the lower left part, so changing the scale is free
+    GLuint furFramebufferID = 0;
+
+    GLuint furColorTextureID = 0;
+
+    GLuint furDepthTextureID = 0;
+
+    GLuint compositeProgram = 0;
+
+
+    // Uniform indices
+
+    GLint furScaleLoc;
+
+    GLint furSizeLoc;
+
+    GLint depthUnprojectLoc;
+};
+
+#endif // FURUPSAMPLER_H
@@ -0,0 +1,77 @@
+#ifndef GPUFURDYNAMICS_H
+#define GPUFURDYNAMICS_H
+
+#include <vector>
+
+#include <GL/glew.h>
+#include "utils/GLStats.h"
+
+#include "FurDynamics.h"
+#include "RenderState.h"
+
+
+// The same damped springs as FurDynamics, stepped on the GPU with transform feedback. Displacement
+// and velocity live in two pairs of buffers, each step reads one pair and writes the other, so
+// nothing is simulated or uploaded on the CPU.
+class GPUFurDynamics {
+
+public:
+
+    GPUFurDynamics();
+
+    ~GPUFurDynamics();
+
+    void   initialize(GLuint, GLuint, GLuint, const std::vector<float> &, unsigned int);
+
+    void   step(RenderState &, float, const glm::quat &, WindField &, const FurParameters &);
+
+    void   reset()                           { mForces.reset(); }
+
+    // The buffer the last step wrote to, what the shells should read
+    GLuint getDisplacementBuffer()           { return displacementBuffers[mCurrent]; }
+
+private:
+
+    // Instance variables
+
+    FurForces mForces;
+
+    unsigned int mVertexCount = 0;
+
+    // Index of the pair holding the latest state
+    unsigned int mCurrent = 0;
+
+
+    // Indices for shader stuff: the program, and per pair a vertex array reading from it
+
+    GLuint shaderProgram = 0;
+
+    GLuint vertexArrays[2] = { 0, 0 };
+
+    GLuint displacementBuffers[2] = { 0, 0 };
+
+    GLuint velocityBuffers[2] = { 0, 0 };
+
+    GLuint windWeightBuffer = 0;
+
+
+    // Uniform indices
+
+    GLint dtLoc;
+
+    GLint stiffnessLoc;
+
+    GLint dampingLoc;
+
+    GLint gravityLoc;
+
+    GLint toWorldLoc;
+
+    GLint windOriginLoc;
+
+    GLint windScaleLoc;
+
+    GLint inertiaLoc;
+};
+
+#endif // GPUFURDYNAMICS_H
@@ -5,9 +5,24 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <cstddef>
 
 #include "utils/ObjectLoader.h"
 #include "../include/Layer.h"
+#include "../include/FurParameters.h"
+#include "../include/FurDynamics.h"
+#include "../include/GPUFurDynamics.h"
+#include "../include/SilhouetteFins.h"
+#include "../include/FurHeightMap.h"
+#include "../include/FurInstance.h"
+#include "../include/MeshletCuller.h"
+#include "../include/RenderQueue.h"
+#include "../include/TextureArrayManager.h"
+#include "../include/utils/WorkerPool.h"
+#include "../include/utils/Frustum.h"
+#include "../include/utils/StreamBuffer.h"
+#include "../include/utils/MeshSimplifier.h"
+#include "../include/utils/GPUQuery.h"
 
 
 class Geometry {
@@ -23,139 +38,190 @@ public:
 
     ~Geometry();
 
-    void      initialize(glm::vec3);
+    void      initialize(glm::vec3, WorkerPool &, TextureArrayManager &);
 
-    void      render(std::vector<glm::mat4>, float, float, glm::vec3);
+    // Skin and shells are drawn separately, the render queue calls these for the packets from submit()
+    void      renderSkin(RenderState &, const FrameData &);
 
-    void      updateFur(float);
+    void      renderShells(RenderState &, const FrameData &);
+
+    // Adds the packets of the skin and the shells, the queue calls the two functions above
+    void      submit(RenderQueue &, const FrameData &);
+
+    void      updateFur(float, const FrameData &, RenderState &, WorkerPool &, StreamBuffer &, WindField &);
+
+    // Whether the bounds, grown by the fur, are in the object space frustum
+    bool      isVisible(const Frustum &);
+
+    // Copies of the mesh drawn along with it, none to draw it once without a transform
+    void      setInstances(const std::vector<FurInstance> &);
+
+    // Culls the instances against the object space frustum and groups the rest by distance, so that each
+    // group gets its own detail. Writes this frame's instance data to the stream, returns how many are drawn.
+    unsigned int cullInstances(const Frustum &, const FrameData &, StreamBuffer &);
+
+    unsigned int getInstanceCount()                { return mInstances.size(); }
+
+    unsigned int getInstancesDrawn()               { return mInstancesDrawn; }
+
+    // Finds this frame's silhouette edges for the fins, before the shells are rendered
+    void      updateFins(WorkerPool &, const FrameData &);
 
     GLuint    loadTexturePNG(const std::string, 
                              int &, 
                              int &
         );
 
-    glm::vec3 getColor()                           { return mMaterial.color; }
+    const FurParameters &getParameters()           { return mParameters; }
 
-    glm::vec3 getFurColor()                        { return mMaterial.furColor; }
+    void      setParameters(const FurParameters &);
 
-    glm::vec3 getAmbient()                         { return mMaterial.ambient; }
+    void      setNoiseType(int);
 
-    glm::vec3 getDiffuse()                         { return mMaterial.diffuse; }
+    bool      getShallRender()                     { return mShallRender; }
 
-    glm::vec3 getSpecular()                        { return mMaterial.specular; }
+    float     getDynamicsTime()                    { return mDynamics.getStepTime(); }
 
-    float     getSpecularity()                     { return mMaterial.specularity; }
+    unsigned int getVertexCount()                  { return mRenderVerts.size(); }
 
-    float     getTransparency()                    { return mMaterial.transparency; }
+    unsigned int getShellsDrawn()                  { return mShellsDrawn; }
 
-    float     getShinyness()                       { return mMaterial.shinyness; }
+    unsigned int getTrianglesDrawn()               { return mTrianglesDrawn; }
 
-    float     getFurPatternScale()                 { return mMaterial.furPatternScale; }
+    // Fins that came out of the geometry shader, from a few frames ago
+    unsigned int getFinsDrawn()                    { return mFinsDrawn; }
 
-    float     getFurLength()                       { return mFurLength; }
+    // Fraction of the triangles of the full mesh that the hair map leaves without fur
+    float     getBaldFraction()                    { return mBaldFraction; }
 
-    float     getFurNoiseLengthVariation()         { return mFurNoiseLengthVariation; }
+    void      setShallRender(bool r)               { mShallRender = r; }
 
-    float     getFurNoiseSampleScale()             { return mFurNoiseSampleScale; }
+    void      setShaderProgram(GLuint sp)          { shaderProgram = sp; }
 
-    bool      getShallRender()                     { return mShallRender; }
+    void      setFurShaderProgram(GLuint sp)       { furShaderProgram = sp; }
 
-    int       getNoiseType()                       { return mNoiseType; }
+    void      setDynamicsShaderProgram(GLuint sp)  { dynamicsShaderProgram = sp; }
 
-    void      setScreenCoordMovement(glm::vec2);
+    void      setTessellatedFurShaderProgram(GLuint sp) { tessellatedFurShaderProgram = sp; }
 
-    void      setCurrentTime(float t);
+    void      setFinShaderProgram(GLuint sp)       { finShaderProgram = sp; }
 
-    void      setShallRender(bool r)               { mShallRender = r; }
+    void      setCullShaderProgram(GLuint sp)      { cullShaderProgram = sp; }
 
-    void      setFurLength(float l)                { mFurLength = l; }
+private:
 
-    void      setColor(glm::vec3 c)                { mMaterial.color = c; }
+    // Functions
 
-    void      setAmbient(glm::vec3 a)              { mMaterial.ambient = a; }
+    bool loadMesh(const char *);
 
-    void      setDiffuse(glm::vec3 d)              { mMaterial.diffuse = d; }
+    void createFurLayers();
 
-    void      setSpecular(glm::vec3 s)             { mMaterial.specular = s; }
+    void generateNoiseTexture(TextureArrayManager &);
 
-    void      setFurColor(glm::vec3 f)             { mMaterial.furColor = f; }
+    void generateHairMap();
 
-    void      setSpecularity(float sp)             { mMaterial.specularity = sp; }
+    void generateFinTexture();
 
-    void      setTransparency(float tr)            { mMaterial.transparency = tr; }
+    void renderFins(RenderState &);
 
-    void      setShinyness(float sh)               { mMaterial.shinyness = sh; }
+    TextureLayer loadTexture(TextureArrayManager &, const std::string filename, int &width, int &height, std::vector<GLubyte> *red = NULL);
 
-    void      setFurPatternScale(float ps)         { mMaterial.furPatternScale = ps; }
+    void cullBaldTriangles(std::vector<unsigned char> &);
 
-    void      setFurNoiseLengthVariation(float lv) { mFurNoiseLengthVariation = lv; }
+    void buildMeshlets(const std::vector<unsigned char> &);
 
-    void      setFurNoiseSampleScale(float ss)     { mFurNoiseSampleScale = ss; }
+    // Height map value the fur has to reach for a shell, given the shells drawn with it
+    unsigned int shellHeight(const FrameData &, unsigned int, unsigned int);
 
-    void      setNoiseType(int nt)                 { mNoiseType = nt; }
+    void uploadInstances();
 
-    void      setShaderProgram(GLuint sp)          { shaderProgram = sp; }
+    void updateFieldBounds();
 
-    void      setFurShaderProgram(GLuint sp)       { furShaderProgram = sp; }
+    bool finsEnabled(const FrameData &);
 
-private:
+    void applyParameters();
 
-    // Functions
+    void setupFurProgram(GLuint, glm::vec3);
 
-    bool loadMesh(const char *);
+    float projectedScale(const FrameData &, const glm::mat4 &, glm::vec3, float, float);
 
-    void createFurLayers();
+    void bindInstances(GLuint, GLintptr);
 
-    void generateNoiseTexture();
+    // The visible instances grouped by batch, each batch from the given start on
+    void writeInstances(FurInstance *, const unsigned int *, float);
 
-    void generateHairMap();
+    unsigned int selectShellCount(const FrameData &, float);
 
-    GLuint loadTexture(const std::string filename, int &width, int &height);
-
-
-    // Structs
-
-    struct Material {
-        Material(const glm::vec3 & c = glm::vec3(1.0f, 1.0f, 1.0f),
-                 const glm::vec3 & f = glm::vec3(1.0f, 1.0f, 1.0f),
-                 const glm::vec3 & a = glm::vec3(0.3f, 0.3f, 0.3f),
-                 const glm::vec3 & d = glm::vec3(0.8f, 0.8f, 0.8f),
-                 const glm::vec3 & s = glm::vec3(1.0f, 1.0f, 1.0f),
-                 float t             = 1.0f,
-                 float sp            = 25.0f,
-                 float sh            = 0.3f,
-                 float ps            = 4.0f)
-            : color(c),
-              furColor(f),
-              ambient(a),
-              diffuse(d),
-              specular(s),
-              transparency(t),
-              specularity(sp),
-              shinyness(sh),
-              furPatternScale(ps) {}
-
-        glm::vec3 color;
-        glm::vec3 furColor;
-        glm::vec3 ambient;
-        glm::vec3 diffuse;
-        glm::vec3 specular;
-        float transparency;
-        float specularity;
-        float shinyness;
-        float furPatternScale;
-    } mMaterial;
+    unsigned int selectMeshLOD(const FrameData &, float, float);
 
 
     // Instance variables
 
     unsigned int mNumberOfLayers;
 
-    float mFurLength;
+    FurParameters mParameters;
+
+    // Shells drawn last frame, at most mNumberOfLayers
+    unsigned int mShellsDrawn = 0;
+
+    // Triangles drawn last frame, skin and shells
+    unsigned int mTrianglesDrawn = 0;
+
+    unsigned int mFinsDrawn = 0;
+
+    float mBaldFraction = 0.0f;
+
+    // Object space bounding box and sphere of the skin, for culling and to estimate the size on screen
+    glm::vec3 mBoundingLow;
+
+    glm::vec3 mBoundingHigh;
+
+    glm::vec3 mBoundingCenter;
+
+    float mBoundingRadius = 0.0f;
+
+    // The same around all the instances, in the space of the scene's model matrix
+    glm::vec3 mFieldLow;
+
+    glm::vec3 mFieldHigh;
+
+    glm::vec3 mFieldCenter;
+
+    float mFieldRadius = 0.0f;
+
+    // Largest scale of an instance transform, the fur and the mesh are at most this much larger on screen
+    float mInstanceScale = 1.0f;
 
-    float mFurNoiseLengthVariation = 0.2f;
+    // Visible instances at about the same distance, drawn with the detail of the nearest one of them.
+    // Contiguous in this frame's instance data, nearest first.
+    struct InstanceBatch {
+        unsigned int first;
+        unsigned int count;
+        float        scale;     // Projected scale of the nearest instance, see projectedScale()
+    };
 
-    float mFurNoiseSampleScale = 1.5f;
+    static const unsigned int INSTANCE_BATCHES = 6;
+
+    InstanceBatch mBatches[INSTANCE_BATCHES];
+
+    unsigned int mBatchCount = 0;
+
+    unsigned int mInstancesDrawn = 0;
+
+    // Where this frame's instance data is, and where the instance attributes of the vertex array read it from
+    GLuint mInstanceSource = 0;
+
+    GLintptr mInstanceSourceOffset = 0;
+
+    GLuint mBoundInstances = 0;
+
+    GLintptr mBoundInstancesOffset = 0;
+
+    // Set when the instances came from setInstances(), fins and meshlet culling need the mesh untransformed
+    bool mInstanced = false;
+
+    // Version of the parameter block that the layers and uniform blocks were last built from
+    unsigned int mAppliedVersion = UNINITIALIZED;
 
     int mTextureWidth;
 
@@ -169,7 +235,26 @@ private:
 
     bool mShallRender;
 
-    int mNoiseType;
+    FurDynamics mDynamics;
+
+    GPUFurDynamics mGPUDynamics;
+
+    // Silhouette edges of the finest level of detail
+    SilhouetteFins mFins;
+
+    // Triangles the fin geometry shader emits, it drops the fins seen face on
+    GPUQuery mFinQuery;
+
+    // Bound of the fur height over the surface, from the noise texture and the hair map
+    FurHeightMap mHeightMap;
+
+    // Writes the indirect draws of the shells, when the GL has compute shaders
+    MeshletCuller mCuller;
+
+    // Buffer and offset that vertex attribute 3 of the vertex array currently reads the displacement from
+    GLuint mBoundDisplacement = 0;
+
+    GLintptr mBoundDisplacementOffset = 0;
 
 
     // Indices for shader stuff: arrays, buffers and programs
@@ -182,46 +267,47 @@ private:
 
     GLuint normalBuffer;
 
+    GLuint displacementBuffer;
+
+    GLuint instanceBuffer = 0;
+
+    GLuint indexBuffer;
+
     GLuint shaderProgram;
 
     GLuint furShaderProgram;
 
-    GLuint skinTextureID;
-    
+    GLuint dynamicsShaderProgram = 0;
+
+    GLuint tessellatedFurShaderProgram = 0;
+
+    GLuint finShaderProgram = 0;
+
+    GLuint cullShaderProgram = 0;
+
     GLuint skinTextureLoc;
 
-    GLuint noiseTextureID;
+    GLuint finTextureID = 0;
 
-    GLuint hairMapID;
+    GLuint materialBuffer;
 
+    GLuint furBuffer;
 
-    // Uniform indices
+    // Layers of the shared texture arrays, the uniform blocks tell the shaders which
+    TextureLayer mSkinTexture;
 
-    GLint MVPLoc;
+    TextureLayer mNoiseTexture;
 
-    GLint MLoc;
+    TextureLayer mHairMap;
 
-    GLint VLoc;
-    
-    GLint lightPosLoc;
 
-    GLint cameraPosLoc;
-    
-    GLint colorLoc;
-    
-    GLint ambientLoc;
-    
-    GLint diffuseLoc;
-    
-    GLint specularLoc;
+    // Uniform indices
 
-    GLint transparencyLoc;
-    
-    GLint specularityLoc;
-    
-    GLint shinynessLoc;
+    GLint lightPosLoc;
 
-    GLint lightPowerLoc;
+    GLint shellAlphaExponentLoc;
+
+    GLint tessellatedShellAlphaExponentLoc;
 
 
     // Containers
@@ -232,8 +318,38 @@ private:
 
     std::vector<glm::vec3> mRenderNormals;
 
+    // Triangles of every level of detail, all into the same vertices
+    std::vector<unsigned int> mIndices;
+
+    // Finest first, the first one is the full mesh
+    std::vector<MeshLOD> mLODs;
+
+    // The triangles with fur at the start of each level, the shells only draw these
+    std::vector<MeshLOD> mFurLODs;
+
+    // Meshlets of the furry triangles of every level, highest first within a level
+    std::vector<Meshlet> mMeshlets;
+
+    // First meshlet of each level
+    std::vector<unsigned int> mLODMeshlets;
+
+    // Per level and height map value, how many triangles and meshlets reach at least that high.
+    // The meshlets are sorted by height, so these are the first ones of the level.
+    std::vector<unsigned int> mTrianglesAbove;
+
+    std::vector<unsigned int> mMeshletsAbove;
+
     std::vector<Layer *> mFurLayers;
 
+    // At least one, the default one has no transform
+    std::vector<FurInstance> mInstances;
+
+    // Longest axis of each instance transform
+    std::vector<float> mInstanceSizes;
+
+    // Projected scale of each instance this frame, 0 if it was culled
+    std::vector<float> mInstanceScales;
+
     std::vector<GLubyte> mTextureData;
 };
 
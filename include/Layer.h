@@ -1,12 +1,11 @@
 #ifndef LAYER_H
 #define LAYER_H
 
-#define TEXTURE_LOAD_ERROR 0
-
 #include <iostream>
 #include <vector>
 
 #include <GL/glew.h>
+#include "utils/GLStats.h"
 #include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
@@ -16,194 +15,73 @@
 #include "utils/Util.h"
 #include "utils/Shader.h"
 #include "utils/Simplexnoise1234.h"
+#include "RenderState.h"
+#include "MeshletCuller.h"
+#include "FrameData.h"
+#include "FurParameters.h"
+#include "utils/MeshSimplifier.h"
 
 
+// One fur shell. Everything shared between the shells of a geometry (fur parameters, frame data,
+// matrices, textures and the vertex array) is set up by the geometry, a layer only passes what differs per shell.
 class Layer {
 
 public:
 
-	Layer(std::vector<glm::vec3>, 
-          std::vector<glm::vec2>, 
-          std::vector<glm::vec3>, 
-          float, 
-          unsigned int, 
+	Layer(float, 
           unsigned int, 
-          glm::vec3 c = glm::vec3(0.71, 0.55, 0.34)
+          unsigned int
         );
 
 	~Layer();
 
-	void initialize(glm::vec3);
-
-	void render(std::vector<glm::mat4>, 
-                float, 
-                float, 
-                glm::vec3
-        );
-
-    glm::vec3 getColor()                     { return mMaterial.color; }
-
-    GLint getNoiseTextureLoc()               { return noiseTextureLoc; }
-
-    GLint getHairMapLoc()                    { return hairMapLoc; }
+	void initialize();
 
-    GLint getNoiseTextureID()                { return noiseTextureID; }
+	// Draws the given level of detail of the geometry's mesh, once per instance of the geometry
+	void render(RenderState &, const FrameData &, const MeshLOD &, GLsizei instances = 1);
 
-    GLint getHairMapID()                     { return hairMapID; }
+	// Draws commands [first, first + count) of the indirect buffer the geometry has bound
+	void renderIndirect(RenderState &, const FrameData &, unsigned int, unsigned int);
 
     void setOffset(float o)                  { mOffset = o; }
 
-    void setFurLength(float l)               { mFurLength = l; }
-
-    void setFurNoiseLengthVariation(float v) { mFurNoiseLengthVariation = v; }
-
-    void setFurNoiseSampleScale(float s)     { mFurNoiseSampleScale = s; }
-
-    void setColor(glm::vec3 c)               { mMaterial.color = c; }
-
-    void setScreenCoordMovement(glm::vec2 m) { mScreenCoordMovement = m; }
-
-    void setCurrentTime(float t)             { mCurrentTime = t; }
-
-    void setHairMapName(std::string s)       { mHairMapName = s; }
-
-    void setFurPatternScale(float ps)        { mFurPatternScale = ps; }
-
-    void setNoiseType(int nt)                { mNoiseType = nt; }
-
-    void setNoiseTextureID(GLuint ID)        { noiseTextureID = ID; }
-
-    void setHairMapID(GLuint t)              { hairMapID = t; }
-
     void setShaderProgram(GLuint sp)         { shaderProgram = sp; }
 
-    void setNoiseTextureLoc(GLint Loc)       { noiseTextureLoc = Loc; }
-
-    void setHairMapLoc(GLint Loc)            { hairMapLoc = Loc; }
-
-    void setNoiseTextureID(GLint ID)         { noiseTextureID = ID; }
-
-    void setHairMapID(GLint ID)              { hairMapID = ID; }
+    void setTessellatedShaderProgram(GLuint sp) { tessellatedShaderProgram = sp; }
 
 private:
 
-	// Structs
+	// Functions
 
-	struct Material {
-        Material(const glm::vec3 & c = glm::vec3(1.0f, 1.0f, 1.0f),
-                 const glm::vec3 & a = glm::vec3(0.3f, 0.3f, 0.3f),
-                 const glm::vec3 & d = glm::vec3(0.8f, 0.8f, 0.8f),
-                 float t             = 0.1f)
-            : color(c),
-              ambient(a),
-              diffuse(d),
-              transparency(t) {}
-
-        glm::vec3 color;
-        glm::vec3 ambient;
-        glm::vec3 diffuse;
-        float transparency;
-    } mMaterial;
+	// Sets the uniforms of this shell on the program of the path, and returns the primitive to draw
+	GLenum bindProgram(RenderState &, const FrameData &);
 
 
 	// Instance variables
 
 	float mOffset;
 
-    float mFurLength;
-
-    float mFurNoiseLengthVariation;
-
-    float mFurNoiseSampleScale;
-
-    float mCurrentTime = 0.0f;
-
-    float mFurPatternScale;
-
     unsigned int mNumberOfLayers;
 
     unsigned int mIndex;
 
-    int mNoiseType;
-
-    glm::mat4 mRotationMatrix   = glm::mat4(1.0);
 
-    glm::vec2 mScreenCoordMovement = glm::vec2(0.0f, 0.0f);
-
-    std::string mHairMapName;
-
-
-	// Indices for shader stuff: arrays, buffers and programs
-
-    GLuint vertexArrayID;
-
-    GLuint vertexBuffer;
-
-    GLuint uvBuffer;
-
-    GLuint normalBuffer;
-
-    GLuint noiseTextureID;
-
-    GLuint hairMapID;
-
-    GLuint noiseTextureLoc;
-
-    GLuint hairMapLoc;
+	// Indices for shader stuff: the program, the vertex array is shared with the geometry
 
     GLuint shaderProgram;
 
+    GLuint tessellatedShaderProgram = 0;
 
-    // Uniform indices
-
-    GLint MVPLoc;
-
-    GLint MLoc;
 
-    GLint VLoc;
-    
-    GLint lightPosLoc;
-
-    GLint cameraPosLoc;
-    
-    GLint colorLoc;
-    
-    GLint ambientLoc;
-    
-    GLint diffuseLoc;
-   
-    GLint transparencyLoc;
-
-    GLint lightPowerLoc;
+    // Uniform indices
 
     GLint offsetLoc;
 
-    GLint furLengthLoc;
-
-    GLint numberOfLayersLoc;
-
     GLint layerIndexLoc;
 
-    GLint furNoiseLengthVariationLoc;
-
-    GLint furNoiseSampleScaleLoc;
-
-    GLint currentTimeLoc;
-
-    GLint windVelocityLoc;
-
-    GLint furPatternScaleLoc;
-
-    GLint noiseTypeLoc;
-
-
-	// Containers
-
-	std::vector<glm::vec3> mRenderVerts;
-
-	std::vector<glm::vec2> mRenderUvs;
+    GLint tessellatedOffsetLoc;
 
-	std::vector<glm::vec3> mRenderNormals;
+    GLint tessellatedLayerIndexLoc;
 };
 
-#endif // LAYER_H
\ No newline at end of file
+#endif // LAYER_H
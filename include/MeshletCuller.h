@@ -0,0 +1,71 @@
+#ifndef MESHLETCULLER_H
+#define MESHLETCULLER_H
+
+#include <vector>
+
+#include <GL/glew.h>
+#include "utils/GLStats.h"
+
+#include "RenderState.h"
+#include "utils/Frustum.h"
+#include "utils/Meshlets.h"
+
+
+// Culls the meshlets of a mesh on the GPU every frame, against the frustum and by their normal
+// cones, and writes one indirect draw command per meshlet. Culled meshlets get no instances, so
+// the command buffer keeps the order of the meshlets and any range of it can be drawn with
+// glMultiDrawElementsIndirect. Needs GL 4.3, the geometry only uses it when there is a program.
+class MeshletCuller {
+
+public:
+
+    MeshletCuller();
+
+    ~MeshletCuller();
+
+    void   initialize(GLuint, const std::vector<Meshlet> &);
+
+    // Object space frustum and eye, and how far the fur can reach out of the surface
+    void   cull(RenderState &, const Frustum &, const glm::vec3 &, float);
+
+    // The commands go to the indirect buffer binding, command i draws meshlet i
+    void   bind();
+
+    bool   isAvailable()                     { return shaderProgram != 0 && commandBuffer != 0; }
+
+    // Bytes per command, to turn a meshlet index into an offset in the command buffer
+    static const unsigned int COMMAND_SIZE = 5 * sizeof(GLuint);
+
+private:
+
+    // Constants
+
+    static const unsigned int GROUP_SIZE = 64;
+
+
+    // Instance variables
+
+    unsigned int mMeshletCount = 0;
+
+
+    // Indices for shader stuff: the program and the buffers
+
+    GLuint shaderProgram = 0;
+
+    GLuint meshletBuffer = 0;
+
+    GLuint commandBuffer = 0;
+
+
+    // Uniform indices
+
+    GLint frustumPlanesLoc;
+
+    GLint eyeLoc;
+
+    GLint furReachLoc;
+
+    GLint meshletCountLoc;
+};
+
+#endif // MESHLETCULLER_H
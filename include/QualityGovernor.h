@@ -0,0 +1,77 @@
+#ifndef QUALITYGOVERNOR_H
+#define QUALITYGOVERNOR_H
+
+
+// What the fur may cost at one quality level
+struct QualitySettings {
+    float        shellFraction; // Cap on the shells drawn per geometry as a fraction of its shells, on top of the shell LOD
+    float        furResolution; // Scale of the fur render target, 1 is the full window
+    int          noiseDetail;   // 2 for all noise in the fur shader, 1 without length variation, 0 without the pattern either
+};
+
+
+// Steps the quality of the fur up and down to hold a frame time budget. The frame cost
+// is smoothed, and after every change the governor waits for it to settle. It only drops
+// quality when over budget and only raises it with clear headroom, so it doesn't oscillate.
+class QualityGovernor {
+
+public:
+
+    QualityGovernor();
+
+    ~QualityGovernor();
+
+    // Feed the cost of the last frame in milliseconds, CPU or GPU, whichever was longer
+    void update(float);
+
+    // Start over from full quality
+    void reset();
+
+    const QualitySettings &getSettings()     { return mSettings; }
+
+    // Only scale the fur resolution once there is a fur render target to scale
+    void setResolutionScaling(bool s)        { mResolutionScaling = s; apply(); }
+
+    bool  &getEnabled()                      { return mEnabled; }
+
+    float &getTargetTime()                   { return mTargetTime; }
+
+    float &getAverageTime()                  { return mAverageTime; }
+
+    int   &getLevel()                        { return mLevel; }
+
+    float &getShellFraction()                { return mSettings.shellFraction; }
+
+    float &getFurResolution()                { return mSettings.furResolution; }
+
+    int   &getNoiseDetail()                  { return mSettings.noiseDetail; }
+
+private:
+
+    // Functions
+
+    void apply();
+
+
+    // Instance variables
+
+    bool mEnabled = true;
+
+    bool mResolutionScaling = false;
+
+    // Frame time budget in milliseconds
+    float mTargetTime = 16.6f;
+
+    // Smoothed frame cost in milliseconds
+    float mAverageTime = 0.0f;
+
+    // 0 is full quality, higher levels are cheaper
+    int mLevel = 0;
+
+    // Frames since the level last changed
+    unsigned int mSettleFrames = 0;
+
+    QualitySettings mSettings;
+};
+
+#endif // QUALITYGOVERNOR_H
@@ -0,0 +1,83 @@
+/*
+ *	Draw packets of one frame, sorted before any of them is drawn. Every
+ *	shown geometry submits a packet for its skin and one for its shells, with
+ *	the program, texture and vertex array the draw binds and its distance to
+ *	the camera. The sort key puts the skins first, nearest first so that early
+ *	depth rejects what is behind, and then the fur grouped by program and
+ *	texture. Consecutive packets sharing state leave nothing for the render
+ *	state cache to change.
+ */
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "RenderState.h"
+#include "FrameData.h"
+#include "utils/FrameArena.h"
+
+
+class Geometry;
+
+// In the order they are drawn
+typedef enum { SKIN_PASS, FUR_PASS } RenderPass;
+
+
+class RenderQueue {
+
+public:
+
+    RenderQueue();
+
+    ~RenderQueue();
+
+    // Room for this many packets from the arena. Blended fur has to go far to near, then the depth
+    // decides before the state does.
+    void   begin(FrameArena &, unsigned int, bool);
+
+    // Pass, program, texture, vertex array, view depth and the geometry that draws it
+    void   submit(RenderPass, GLuint, GLuint, GLuint, float, Geometry *);
+
+    void   sort();
+
+    // Draws every packet of the pass, in the sorted order
+    void   execute(RenderState &, const FrameData &, RenderPass);
+
+private:
+
+    // Functions
+
+    static std::uint64_t depthBits(float, bool);
+
+
+    // Constants
+
+    static const unsigned int STATE_BITS = 12;
+
+    static const unsigned int DEPTH_BITS = 24;
+
+
+    // Instance variables
+
+    struct DrawPacket {
+        std::uint64_t key;
+        RenderPass    pass;
+        Geometry     *geometry;
+    };
+
+    DrawPacket *mPackets = nullptr;
+
+    // Packets for frames where the arena is full
+    std::vector<DrawPacket> mFallback;
+
+    unsigned int mCount = 0;
+
+    unsigned int mCapacity = 0;
+
+    bool mFurBackToFront = false;
+};
+
+#endif // RENDERQUEUE_H
@@ -0,0 +1,101 @@
+#ifndef RENDERSTATE_H
+#define RENDERSTATE_H
+
+#include <limits>
+#include <string>
+
+#include "utils/GLStats.h"
+#include "utils/Util.h"
+
+#define MAX_TEXTURE_UNITS 16
+#define MAX_UNIFORM_BUFFER_BINDINGS 8
+
+
+// Shadows the GL state that the render paths touch and drops calls that wouldn't change anything.
+// Everything that draws in Scene, Geometry and Layer goes through this instead of calling GL directly.
+class RenderState {
+
+public:
+
+    RenderState();
+
+    ~RenderState();
+
+    void invalidate();
+
+    // Forgets the texture bindings and the active unit only, after code that binds textures directly
+    void invalidateTextures();
+
+    void useProgram(GLuint);
+
+    void bindVertexArray(GLuint);
+
+    void bindTexture(GLuint, GLenum, GLuint);
+
+    void bindUniformBuffer(GLuint, GLuint);
+
+    void bindUniformBufferRange(GLuint, GLuint, GLintptr, GLsizeiptr);
+
+    void enable(GLenum);
+
+    void disable(GLenum);
+
+    void setEnabled(GLenum c, bool e)     { if(e) enable(c); else disable(c); }
+
+    void blendFunc(GLenum, GLenum);
+
+    void blendFuncSeparate(GLenum, GLenum, GLenum, GLenum);
+
+    void depthMask(GLboolean);
+
+    // All channels of all draw buffers at once
+    void colorMask(GLboolean);
+
+private:
+
+    // Functions
+
+    int &capability(GLenum);
+
+
+    // Constants
+
+    static const int UNKNOWN = -1;
+
+    static const int CAPABILITY_COUNT = 8;
+
+
+    // Shadowed state, UNINITIALIZED/UNKNOWN until it has been set through us
+
+    GLuint mProgram;
+
+    GLuint mVertexArray;
+
+    GLuint mActiveUnit;
+
+    GLuint mTextures[MAX_TEXTURE_UNITS];
+
+    GLenum mTextureTargets[MAX_TEXTURE_UNITS];
+
+    GLuint mUniformBuffers[MAX_UNIFORM_BUFFER_BINDINGS];
+
+    GLintptr mUniformOffsets[MAX_UNIFORM_BUFFER_BINDINGS];   // UNKNOWN for whole buffer bindings
+
+    GLenum mCapabilities[CAPABILITY_COUNT];
+
+    int mCapabilityStates[CAPABILITY_COUNT];
+
+    GLenum mBlendSource;
+
+    GLenum mBlendDestination;
+
+    GLenum mBlendSourceAlpha;
+
+    GLenum mBlendDestinationAlpha;
+
+    int mDepthMask;
+
+    int mColorMask;
+};
+
+#endif // RENDERSTATE_H
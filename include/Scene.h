@@ -1,9 +1,24 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <chrono>
 
 #include "../include/Geometry.h"
 #include "../include/Camera.h"
+#include "../include/RenderState.h"
+#include "../include/RenderQueue.h"
+#include "../include/TextureArrayManager.h"
+#include "../include/FrameData.h"
+#include "../include/utils/FrameArena.h"
+#include "../include/utils/WorkerPool.h"
+#include "../include/utils/StreamBuffer.h"
+#include "../include/WindField.h"
+#include "../include/WeightedOIT.h"
+#include "../include/FurUpsampler.h"
+#include "../include/TemporalAccumulator.h"
+#include "../include/QualityGovernor.h"
+#include "../include/utils/GPUTimer.h"
+#include "../include/utils/GPUQuery.h"
 
 
 class Scene {
@@ -36,27 +51,207 @@ public:
 
     float &getWindVelocity()	 			      		 { return mWindVelocity; }
 
-    void   setCurrentTime(float t);
+    float &getDynamicsTime()	 			      		 { return mDynamicsTime; }
+
+    int   &getDynamicsMode()	 			      		 { return mDynamicsMode; }
+
+    bool  &getShellLOD()	 			      		     { return mShellLOD; }
+
+    unsigned int &getShellsDrawn()	 			      	 { return mShellsDrawn; }
+
+    bool  &getMeshLOD()	 			      		         { return mMeshLOD; }
+
+    unsigned int &getTrianglesDrawn()	 			     { return mTrianglesDrawn; }
+
+    float &getBaldFraction()	 			      		 { return mBaldFraction; }
+
+    // Shown geometries whose bounds were outside the view last frame
+    unsigned int &getGeometriesCulled()	 			     { return mGeometriesCulled; }
+
+    // Instances of the geometries drawn last frame
+    unsigned int &getInstancesDrawn()	 			     { return mInstancesDrawn; }
+
+    QualityGovernor &getGovernor()	 			      	 { return mGovernor; }
+
+    void   setCurrentTime(float t) 				  		 { mFrame.currentTime = t; }
 
     void   addShaderPair(std::string vs, std::string fs) { mShaderPrograms.push_back(std::make_pair(vs, fs)); }
 
+    void   setDynamicsShader(std::string vs) 			 { mDynamicsShader = vs; }
+
+    // Vertex, control and evaluation shaders of the tessellated shells, the fragment shader is the fur one
+    void   setTessellationShaders(std::string vs, std::string tcs, std::string tes) { mTessellationShaders[0] = vs; mTessellationShaders[1] = tcs; mTessellationShaders[2] = tes; }
+
+    bool   hasTessellation() 			                 { return mTessellationAvailable; }
+
+    // Full screen pass that composites the weighted OIT targets
+    void   setCompositeShaders(std::string vs, std::string fs) { mCompositeShaders = std::make_pair(vs, fs); }
+
+    // Full screen pass that upsamples the reduced resolution fur
+    void   setUpsampleShaders(std::string vs, std::string fs)  { mUpsampleShaders = std::make_pair(vs, fs); }
+
+    // 1, 2 or 4, the fur is drawn at that fraction of the resolution when blended
+    int   &getFurDownsample()	 			      		 { return mFurDownsample; }
+
+    // Resolve and copy passes of the temporal accumulation, both full screen
+    void   setTemporalShaders(std::string vs, std::string resolve, std::string copy) { mTemporalShaders[0] = vs; mTemporalShaders[1] = resolve; mTemporalShaders[2] = copy; }
+
+    bool  &getTemporalShells()	 			      		 { return mTemporalShells; }
+
+    // Vertex, geometry and fragment shader of the silhouette fins
+    void   setFinShaders(std::string vs, std::string gs, std::string fs) { mFinShaders[0] = vs; mFinShaders[1] = gs; mFinShaders[2] = fs; }
+
+    bool  &getFins()	 			      		         { return mFins; }
+
+    unsigned int &getFinsDrawn()	 			      	 { return mFinsDrawn; }
+
+    // Compute shader that culls the shell meshlets and writes their indirect draws
+    void   setCullShader(std::string cs) 			     { mCullShader = cs; }
+
+    bool   hasMeshletCulling() 			                 { return mMeshletCullingAvailable; }
+
+    bool  &getMeshletCulling()	 			      		 { return mMeshletCulling; }
+
+    int   &getFurPath()	 			      		         { return mFurPath; }
+
+    int   &getShellBlending()	 			      		 { return mShellBlending; }
+
+    // Samples that passed the depth test per sample of the viewport, from a few frames ago
+    float &getOverdraw()	 			      		     { return mOverdraw; }
+
+    // Queries the samples per pixel of the bound framebuffer, after binding another one to render into
+    void   updateTargetSamples();
+
 private:
 
+	// Functions
+
+	void   beginStreamFrame();
+
+
 	// Instance varialbes
 
 	Camera * mCamera = nullptr;
 
+	RenderState mRenderState;
+
+	FrameData mFrame;
+
+	FrameArena mFrameArena;
+
+	// Skin and fur packets of the shown geometries, in the arena and sorted once per frame
+	RenderQueue mRenderQueue;
+
+	// Skin, noise and hair map textures of all geometries, as layers of shared arrays
+	TextureArrayManager mTextureArrays;
+
+	WorkerPool mWorkers;
+
+	// Transient GPU data for the frame, opened by update() and fenced at the end of render()
+	StreamBuffer mStream;
+
+	bool mStreamFrameOpen = false;
+
+	// Cost of the frame from beginStreamFrame() to the end of render(), on the CPU and the GPU
+	std::chrono::steady_clock::time_point mFrameStart;
+
+	GPUTimer mGPUTimer;
+
+	// Counts the samples that pass the depth test while the geometries are drawn
+	GPUQuery mSampleCounter;
+
+	float mOverdraw = 0.0f;
+
+	// Samples per pixel of what render() draws into, only changes with the framebuffer
+	int mTargetSamples = 1;
+
+	QualityGovernor mGovernor;
+
+	WindField mWindField;
+
 	float mWindVelocity = 1.0;
 
+	// Milliseconds spent in the fur dynamics during the last update
+	float mDynamicsTime = 0.0f;
+
+	int mDynamicsMode = CPU_DYNAMICS;
+
+	bool mShellLOD = true;
+
+	bool mMeshLOD = true;
+
+	// Fur shells and triangles drawn over all geometries during the last render
+	unsigned int mShellsDrawn = 0;
+
+	unsigned int mTrianglesDrawn = 0;
+
+	// Triangles without fur in the hair maps of the shown meshes, on average
+	float mBaldFraction = 0.0f;
+
+	unsigned int mGeometriesCulled = 0;
+
+	unsigned int mInstancesDrawn = 0;
+
+	std::string mDynamicsShader;
+
+	std::string mTessellationShaders[3];
+
+	bool mTessellationAvailable = false;
+
+	int mFurPath = VERTEX_SHELLS;
+
+	int mShellBlending = BLENDED_SHELLS;
+
+	// Targets for WEIGHTED_OIT_SHELLS, the shells of all geometries go in there in any order
+	WeightedOIT mOIT;
+
+	std::pair<std::string, std::string> mCompositeShaders;
+
+	// Reduced resolution fur for BLENDED_SHELLS, the governor may scale it down further
+	FurUpsampler mFurUpsampler;
+
+	std::pair<std::string, std::string> mUpsampleShaders;
+
+	int mFurDownsample = 1;
+
+	// Jitters the shells every frame and accumulates the frames, for the look of more shells than are drawn
+	TemporalAccumulator mTemporal;
+
+	std::string mTemporalShaders[3];
+
+	bool mTemporalShells = false;
+
+	unsigned int mTemporalFrame = 0;
+
+	glm::mat4 mPreviousMVP;
+
+	// Fins on the silhouettes, to fill the gaps between the shells at grazing angles
+	std::string mFinShaders[3];
+
+	bool mFins = false;
+
+	unsigned int mFinsDrawn = 0;
+
+	// Frustum and normal cone culling of the shell meshlets on the GPU, when the GL has compute shaders
+	std::string mCullShader;
+
+	bool mMeshletCullingAvailable = false;
+
+	bool mMeshletCulling = false;
+
 
 	// Containers
 
 	std::vector<Geometry *> mGeometries;
 
-	std::vector<glm::mat4> mMatrices;
+	// Render list for frames where the arena is full
+	std::vector<Geometry *> mRenderListFallback;
 
 	std::vector<std::pair<std::string, std::string> > mShaderPrograms;
 
+	// Every program loaded in initialize(), shared by the geometries and the passes and deleted with the scene
+	std::vector<GLuint> mProgramIDs;
+
 
 	// Structs
 
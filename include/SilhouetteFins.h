@@ -0,0 +1,134 @@
+#ifndef SILHOUETTEFINS_H
+#define SILHOUETTEFINS_H
+
+#include <vector>
+
+#include <GL/glew.h>
+#include "utils/GLStats.h"
+
+#include <glm/glm.hpp>
+
+#include "utils/WorkerPool.h"
+
+
+// Silhouette edges of a mesh, as an index buffer of lines that a geometry shader extrudes into fins.
+// The edge adjacency is built once. Every frame the faces are classified as front or back facing,
+// and an edge between one of each is on the silhouette. The silhouette hardly moves between frames,
+// so usually only the faces around last frame's silhouette are tested again, and only the changed
+// part of the index buffer is uploaded. A full pass runs when the view jumps, and now and then to
+// pick up silhouettes that appear away from the old ones.
+class SilhouetteFins {
+
+public:
+
+    SilhouetteFins();
+
+    ~SilhouetteFins();
+
+    // Triangles [first, first + count) of the indices, into the given positions
+    void initialize(const std::vector<glm::vec3> &, const std::vector<unsigned int> &, unsigned int, unsigned int);
+
+    // Finds the silhouette seen from an object space eye position and uploads what changed
+    void update(WorkerPool &, const glm::vec3 &);
+
+    // The next update tests every face
+    void reset()                                      { mFramesToFullUpdate = 0; }
+
+    // Two indices per fin, for GL_LINES
+    GLuint getIndexBuffer()                           { return indexBuffer; }
+
+    unsigned int getFinCount()                        { return static_cast<unsigned int>(mFins.size()); }
+
+private:
+
+    // Functions
+
+    static void classifyJob(unsigned int, unsigned int, void *);
+
+    void classify(unsigned int, unsigned int);
+
+    bool facing(unsigned int);
+
+    void fullUpdate(WorkerPool &);
+
+    void incrementalUpdate();
+
+    void testEdge(unsigned int);
+
+    void addFin(unsigned int);
+
+    void removeFin(unsigned int);
+
+    void upload();
+
+
+    // Constants
+
+    static const unsigned int SIMD_WIDTH = 4;
+
+    static const unsigned int FACES_PER_JOB = 4096;
+
+    static const unsigned int NO_FACE = 0xffffffffu;
+
+    static const unsigned int NO_EDGE = 0xffffffffu;
+
+    static const unsigned int NO_SLOT = 0xffffffffu;
+
+
+    // Instance variables
+
+    unsigned int mFaceCount = 0;
+
+    // Center of the bounding box, the view direction is measured from here
+    glm::vec3 mCenter;
+
+    // Eye of the last update, the view direction from it decides between a full and an incremental pass
+    glm::vec3 mEye;
+
+    unsigned int mFramesToFullUpdate = 0;
+
+    // Everything from this slot on has to be uploaded
+    unsigned int mDirtySlot = 0;
+
+    // Stamp of the current update, to test every face and edge once
+    unsigned int mStamp = 0;
+
+    GLuint indexBuffer = 0;
+
+
+    // Containers
+
+    // Edge between exactly two faces, with its vertices as the first face has them
+    struct Edge {
+        unsigned int vertices[2];
+        unsigned int faces[2];
+    };
+
+    std::vector<Edge> mEdges;
+
+    // Three edges per face, NO_EDGE for the ones on a border or shared by more than two faces
+    std::vector<unsigned int> mFaceEdges;
+
+    // Face planes, n . p - d, one array per component and padded to a multiple of SIMD_WIDTH
+    std::vector<float> mPlaneX, mPlaneY, mPlaneZ, mPlaneD;
+
+    // 1 where the face is towards the eye
+    std::vector<unsigned char> mFacing;
+
+    std::vector<unsigned int> mFaceStamp;
+
+    std::vector<unsigned int> mEdgeStamp;
+
+    // The silhouette edge in each slot of the index buffer, and the slot of each edge
+    std::vector<unsigned int> mFins;
+
+    std::vector<unsigned int> mSlots;
+
+    // Copy of the index buffer, two vertices per slot
+    std::vector<GLuint> mFinIndices;
+
+    // Faces to test again in an incremental pass
+    std::vector<unsigned int> mCandidates;
+};
+
+#endif // SILHOUETTEFINS_H
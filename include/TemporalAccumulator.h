@@ -0,0 +1,103 @@
+/*
+ *	Accumulates frames over time. The scene is drawn into an offscreen target,
+ *	then every pixel is reprojected into the previous frame with the depth and
+ *	the matrices of both frames, and blended with the history found there. The
+ *	history is clamped to the colors around the pixel in the current frame, so
+ *	that it can't drag in what has moved away or was uncovered. Whatever
+ *	changes from frame to frame on purpose, like jittered shells, averages out.
+ *
+ *	The scene target has as many samples as the framebuffer it stands in for,
+ *	so alpha to coverage and MSAA still work. It is resolved before the
+ *	reprojection, which only needs one color and depth per pixel.
+ */
+#ifndef TEMPORALACCUMULATOR_H
+#define TEMPORALACCUMULATOR_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "RenderState.h"
+#include "FullscreenPass.h"
+
+
+class TemporalAccumulator {
+
+public:
+
+    TemporalAccumulator();
+
+    ~TemporalAccumulator();
+
+    // Takes the resolve and copy programs, without both the accumulation is unavailable
+    void initialize(GLuint, GLuint);
+
+    // Binds the scene target, sized like the current viewport with the given samples per pixel, and clears it
+    void begin(RenderState &, int);
+
+    // Blends the frame into the history with the current and previous model view projection
+    // matrices, and shows the result in the framebuffer that was bound in begin()
+    void resolve(RenderState &, const glm::mat4 &, const glm::mat4 &);
+
+    // Drops the history, the next frame starts over
+    void invalidate()                          { mHistoryValid = false; }
+
+    bool isAvailable()                         { return resolveProgram != 0 && copyProgram != 0; }
+
+    // Weight of the current frame in the history
+    static const float BLEND_FACTOR;
+
+private:
+
+    // Functions
+
+    bool resize(int, int, int);
+
+
+    // Instance variables
+
+    // Size of the targets, and the framebuffer resolve() shows the result in
+    FullscreenPass mPass;
+
+    int mSamples = 1;
+
+    // History that was written last, the other one is written next
+    unsigned int mCurrentHistory = 0;
+
+    bool mHistoryValid = false;
+
+
+    // Indices for the framebuffers, their attachments and the passes
+
+    GLuint sceneFramebufferID = 0;
+
+    GLuint colorTextureID = 0;
+
+    GLuint depthTextureID = 0;
+
+    // Only with more than one sample, drawn to and then resolved into the textures above
+    GLuint multisampleFramebufferID = 0;
+
+    GLuint colorRenderbufferID = 0;
+
+    GLuint depthRenderbufferID = 0;
+
+    GLuint historyFramebufferIDs[2];
+
+    GLuint historyTextureIDs[2];
+
+    GLuint resolveProgram = 0;
+
+    GLuint copyProgram = 0;
+
+
+    // Uniform indices
+
+    GLint reprojectionLoc;
+
+    GLint blendFactorLoc;
+
+    GLint historyValidLoc;
+};
+
+#endif // TEMPORALACCUMULATOR_H
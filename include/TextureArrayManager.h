@@ -0,0 +1,74 @@
+/*
+ *	Packs the textures of all geometries into GL_TEXTURE_2D_ARRAYs, one per
+ *	size, format and filtering. A texture is a layer of one of them, so
+ *	meshes whose textures share an array bind the same texture object, and
+ *	the render state cache skips the bind between their draws. The shaders
+ *	get the layer through the uniform blocks of the geometry.
+ *
+ *	Layers are handed out as the textures are added, the arrays only get
+ *	their storage in build(), once it is known how many layers each needs.
+ */
+#ifndef TEXTUREARRAYMANAGER_H
+#define TEXTUREARRAYMANAGER_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <GL/glew.h>
+#include "utils/GLStats.h"
+
+
+// Where a texture ended up
+struct TextureLayer {
+    GLuint texture = 0;     // A GL_TEXTURE_2D_ARRAY, 0 if the texture couldn't be added
+    GLint  layer   = 0;
+};
+
+
+class TextureArrayManager {
+
+public:
+
+    TextureArrayManager();
+
+    ~TextureArrayManager();
+
+    // Internal format, width, height, format and type of the pixels, the pixels, and the min and mag filters.
+    // Textures added under the same name share a layer, an empty name never does.
+    TextureLayer add(GLenum, int, int, GLenum, GLenum, const void *, GLenum, GLenum, const std::string &name = "");
+
+    // Creates the storage of every array and uploads the layers, the copies of the pixels are dropped after
+    void build();
+
+private:
+
+    // Functions
+
+    static unsigned int bytesPerTexel(GLenum, GLenum);
+
+
+    // Containers
+
+    struct Array {
+        GLenum internalFormat;
+        GLenum format;
+        GLenum type;
+        int    width;
+        int    height;
+        GLenum minFilter;
+        GLenum magFilter;
+        GLuint texture;
+        bool   built;
+
+        // Pixels of the layers until build(), then only their number is needed
+        std::vector<std::vector<unsigned char> > layers;
+        unsigned int layerCount;
+    };
+
+    std::vector<Array> mArrays;
+
+    std::map<std::string, TextureLayer> mNamed;
+};
+
+#endif // TEXTUREARRAYMANAGER_H
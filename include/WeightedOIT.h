@@ -0,0 +1,69 @@
+/*
+ *	Weighted blended order-independent transparency (McGuire and Bavoil 2013).
+ *	Transparent surfaces add their premultiplied color and alpha, weighted by
+ *	depth, into an accumulation target, and the blending multiplies their
+ *	coverage into a revealage term. A full screen pass then composites the
+ *	average color over what was in the framebuffer. Draw order doesn't matter.
+ *
+ *	GL 3.3 only has one blend function for all draw buffers, so the revealage
+ *	lives in the alpha of the accumulation target (RGB added, alpha multiplied)
+ *	and the summed weights get a target of their own.
+ */
+#ifndef WEIGHTEDOIT_H
+#define WEIGHTEDOIT_H
+
+#include <GL/glew.h>
+
+#include "RenderState.h"
+#include "FullscreenPass.h"
+
+
+class WeightedOIT {
+
+public:
+
+    WeightedOIT();
+
+    ~WeightedOIT();
+
+    // Takes the composite program, without one the pass is unavailable
+    void initialize(GLuint);
+
+    // Binds the targets, sized like the current viewport, and clears them. The opaque depth goes in next.
+    void begin(RenderState &);
+
+    // Sets up the blending for the transparent surfaces, depth tested against the opaque ones but not written
+    void accumulate(RenderState &);
+
+    // Back to the framebuffer that was bound in begin(), and blends the transparent surfaces over it
+    void composite(RenderState &);
+
+    bool isAvailable()                         { return compositeProgram != 0; }
+
+private:
+
+    // Functions
+
+    bool resize(int, int);
+
+
+    // Instance variables
+
+    // Size of the targets, and the framebuffer composite() returns to
+    FullscreenPass mPass;
+
+
+    // Indices for the framebuffer, its attachments and the composite pass
+
+    GLuint framebufferID = 0;
+
+    GLuint accumulationTextureID = 0;
+
+    GLuint weightTextureID = 0;
+
+    GLuint depthTextureID = 0;
+
+    GLuint compositeProgram = 0;
+};
+
+#endif // WEIGHTEDOIT_H
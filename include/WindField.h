@@ -0,0 +1,97 @@
+#ifndef WINDFIELD_H
+#define WINDFIELD_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+#include "utils/GLStats.h"
+
+#include <glm/glm.hpp>
+
+
+// Low resolution wind volume around the scene: a gusting base wind plus divergence free curl
+// noise turbulence. A worker thread solves the next field while the current one is sampled,
+// the GPU reads it as a 3D texture and the CPU dynamics trilinearly like the texture unit would.
+// The cost only depends on the resolution, not on the meshes.
+class WindField {
+
+public:
+
+    WindField();
+
+    ~WindField();
+
+    void initialize(float, float);
+
+    // Publishes the field the worker finished, uploads it, and asks for the one at the given time
+    void update(float, float);
+
+    // World space wind at a world space position, matches what texture() gives in the shaders
+    glm::vec3 sample(const glm::vec3 &) const;
+
+    GLuint getTexture()                      { return textureID; }
+
+    // Texture coordinate = (position - origin) * scale
+    glm::vec3 getOrigin()                    { return glm::vec3(ORIGIN); }
+
+    float getScale()                         { return 1.0f / EXTENT; }
+
+    static const int RESOLUTION = 32;
+
+private:
+
+    // Functions
+
+    void workerLoop();
+
+    void solve(float, float, std::vector<float> &);
+
+
+    // Constants
+
+    static const int POTENTIAL_RESOLUTION = RESOLUTION + 2;
+
+    static const float ORIGIN;
+
+    static const float EXTENT;
+
+
+    // Worker state, guarded by the mutex
+
+    float mRequestTime = 0.0f;
+
+    float mRequestVelocity = 0.0f;
+
+    bool mRequested = false;
+
+    bool mReady = false;
+
+    bool mQuit = false;
+
+    std::mutex mMutex;
+
+    std::condition_variable mWake;
+
+    std::thread mThread;
+
+
+    // Indices for the texture
+
+    GLuint textureID = 0;
+
+
+    // Containers
+
+    // Vector potential of the turbulence, one array per component, with a border cell for the differences
+    std::vector<float> mPotentialX, mPotentialY, mPotentialZ;
+
+    // Interleaved RGB velocities, the front is sampled and uploaded, the worker writes the back
+    std::vector<float> mFront;
+
+    std::vector<float> mBack;
+};
+
+#endif // WINDFIELD_H
@@ -0,0 +1,26 @@
+/*
+ *	Per frame heap allocation counters. Build with -DFUR_ALLOC_STATS
+ *	(make ALLOC_STATS=1) to replace the global operator new/delete with
+ *	counting versions, otherwise the counters stay at zero.
+ */
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+
+struct AllocCounters {
+    unsigned int allocations = 0;
+    unsigned int bytes       = 0;
+};
+
+
+namespace AllocStats {
+
+    // Counters of the last completed frame, the address is stable so the tweak bar can point at it
+    const AllocCounters &lastFrame();
+
+    void endFrame();
+
+    bool enabled();
+}
+
+#endif // ALLOCSTATS_H
@@ -0,0 +1,60 @@
+/*
+ *	Linear allocator for data that only lives for one frame. Memory is
+ *	reserved once up front, allocating bumps a pointer and reset() at the
+ *	start of the next frame hands everything back at once.
+ */
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+class FrameArena {
+
+public:
+
+    FrameArena(std::size_t capacity = 1 << 20)
+        : mBuffer(capacity) {}
+
+    void *allocate(std::size_t bytes, std::size_t alignment = 16) {
+
+        std::uintptr_t base    = reinterpret_cast<std::uintptr_t>(&mBuffer[0]);
+        std::uintptr_t aligned = (base + mUsed + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1);
+        std::size_t    end     = static_cast<std::size_t>(aligned - base) + bytes;
+
+        // Running out means the capacity is too small, which is a bug rather than something to recover from
+        if(end > mBuffer.size())
+            return nullptr;
+
+        mUsed = end;
+
+        if(mUsed > mPeak)
+            mPeak = mUsed;
+
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    // Only for trivially destructible types, nothing is ever destroyed
+    template <typename T>
+    T *allocate(std::size_t count)          { return static_cast<T *>(allocate(count * sizeof(T), alignof(T))); }
+
+    void reset()                            { mUsed = 0; }
+
+    std::size_t getUsed() const             { return mUsed; }
+
+    std::size_t getPeak() const             { return mPeak; }
+
+    std::size_t getCapacity() const         { return mBuffer.size(); }
+
+private:
+
+    std::vector<unsigned char> mBuffer;
+
+    std::size_t mUsed = 0;
+
+    std::size_t mPeak = 0;
+};
+
+#endif // FRAMEARENA_H
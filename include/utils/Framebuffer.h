@@ -0,0 +1,75 @@
+/*
+ *	Offscreen render target with one color attachment and an optional depth texture.
+ *	With samples it renders to multisampled renderbuffers instead, and the color
+ *	is resolved into the texture on resolve() or readPixels().
+ */
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GLStats.h"
+
+
+class Framebuffer {
+
+public:
+
+    Framebuffer();
+
+    ~Framebuffer();
+
+    bool   initialize(int, int, GLenum colorFormat = GL_RGBA8, bool depth = true, int samples = 0);
+
+    void   bind();
+
+    void   unbind();
+
+    // Averages the samples into the color texture, nothing to do without multisampling
+    void   resolve();
+
+    void   readPixels(std::vector<GLubyte> &);
+
+    GLuint getFramebufferID()                { return framebufferID; }
+
+    GLuint getColorTexture()                 { return colorTextureID; }
+
+    GLuint getDepthTexture()                 { return depthTextureID; }
+
+    int    getWidth()                        { return mWidth; }
+
+    int    getHeight()                       { return mHeight; }
+
+    int    getSamples()                      { return mSamples; }
+
+private:
+
+    // Instance variables
+
+    int mWidth  = 0;
+
+    int mHeight = 0;
+
+    int mSamples = 0;
+
+
+    // Indices for the framebuffer and its attachments
+
+    GLuint framebufferID  = 0;
+
+    GLuint colorTextureID = 0;
+
+    GLuint depthTextureID = 0;
+
+    // Only with multisampling, rendered to and then resolved into the textures above
+
+    GLuint multisampleFramebufferID = 0;
+
+    GLuint colorRenderbufferID = 0;
+
+    GLuint depthRenderbufferID = 0;
+};
+
+#endif // FRAMEBUFFER_H
@@ -0,0 +1,38 @@
+/*
+ *	The six planes of a view frustum, extracted from a projection matrix times
+ *	whatever comes before it (Gribb and Hartmann). With the full MVP the planes
+ *	are in object space, so bounds can be tested without transforming them.
+ */
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+
+class Frustum {
+
+public:
+
+    Frustum();
+
+    Frustum(const glm::mat4 &);
+
+    // False only if the sphere is entirely outside of one of the planes
+    bool intersectsSphere(const glm::vec3 &, float) const;
+
+    // Same for an axis aligned box given by its lowest and highest corner
+    bool intersectsBox(const glm::vec3 &, const glm::vec3 &) const;
+
+    // Left, right, bottom, top, near, far. Normalized, xyz points inwards and w is the distance term.
+    const glm::vec4 &getPlane(unsigned int i) const      { return mPlanes[i]; }
+
+    static const unsigned int PLANES = 6;
+
+private:
+
+    // Containers
+
+    glm::vec4 mPlanes[PLANES];
+};
+
+#endif // FRUSTUM_H
@@ -0,0 +1,182 @@
+/*
+ *	Per frame counters for the GL calls we make. Build with -DFUR_GL_STATS
+ *	(make GL_STATS=1) to route the counted calls through the wrappers below,
+ *	otherwise the counters stay at zero and the GL functions are untouched.
+ *	Include this right after GL/glew.h.
+ */
+#ifndef GLSTATS_H
+#define GLSTATS_H
+
+#include <GL/glew.h>
+
+
+struct GLCounters {
+    unsigned int drawCalls      = 0;
+    unsigned int stateChanges   = 0;
+    unsigned int uniformUpdates = 0;
+    unsigned int textureBinds   = 0;
+    unsigned int bytesUploaded  = 0;
+};
+
+
+namespace GLStats {
+
+    // Counters of the frame currently being recorded
+    GLCounters &current();
+
+    // Counters of the last completed frame, the address is stable so the tweak bar can point at it
+    const GLCounters &lastFrame();
+
+    void endFrame();
+
+    bool enabled();
+
+    unsigned int pixelSize(GLenum format, GLenum type);
+
+#ifdef FUR_GL_STATS
+
+    inline void upload(unsigned int bytes)                                                            { current().bytesUploaded += bytes; }
+
+    // Draw calls
+    inline void drawArrays(GLenum m, GLint f, GLsizei c)                                              { current().drawCalls++; glDrawArrays(m, f, c); }
+    inline void drawElements(GLenum m, GLsizei c, GLenum t, const void *i)                            { current().drawCalls++; glDrawElements(m, c, t, i); }
+    inline void drawArraysInstanced(GLenum m, GLint f, GLsizei c, GLsizei n)                          { current().drawCalls++; glDrawArraysInstanced(m, f, c, n); }
+    inline void drawElementsInstanced(GLenum m, GLsizei c, GLenum t, const void *i, GLsizei n)        { current().drawCalls++; glDrawElementsInstanced(m, c, t, i, n); }
+    inline void multiDrawElementsIndirect(GLenum m, GLenum t, const void *i, GLsizei n, GLsizei s)    { current().drawCalls++; glMultiDrawElementsIndirect(m, t, i, n, s); }
+
+    // State changes
+    inline void useProgram(GLuint p)                                                                  { current().stateChanges++; glUseProgram(p); }
+    inline void bindVertexArray(GLuint a)                                                             { current().stateChanges++; glBindVertexArray(a); }
+    inline void bindBuffer(GLenum t, GLuint b)                                                        { current().stateChanges++; glBindBuffer(t, b); }
+    inline void bindBufferBase(GLenum t, GLuint i, GLuint b)                                          { current().stateChanges++; glBindBufferBase(t, i, b); }
+    inline void bindBufferRange(GLenum t, GLuint i, GLuint b, GLintptr o, GLsizeiptr s)               { current().stateChanges++; glBindBufferRange(t, i, b, o, s); }
+    inline void bindFramebuffer(GLenum t, GLuint f)                                                   { current().stateChanges++; glBindFramebuffer(t, f); }
+    inline void enable(GLenum c)                                                                      { current().stateChanges++; glEnable(c); }
+    inline void disable(GLenum c)                                                                     { current().stateChanges++; glDisable(c); }
+    inline void blendFunc(GLenum s, GLenum d)                                                         { current().stateChanges++; glBlendFunc(s, d); }
+    inline void blendFuncSeparate(GLenum s, GLenum d, GLenum sa, GLenum da)                           { current().stateChanges++; glBlendFuncSeparate(s, d, sa, da); }
+    inline void depthMask(GLboolean f)                                                                { current().stateChanges++; glDepthMask(f); }
+    inline void viewport(GLint x, GLint y, GLsizei w, GLsizei h)                                      { current().stateChanges++; glViewport(x, y, w, h); }
+    inline void activeTexture(GLenum t)                                                               { current().stateChanges++; glActiveTexture(t); }
+    inline void enableVertexAttribArray(GLuint i)                                                     { current().stateChanges++; glEnableVertexAttribArray(i); }
+    inline void disableVertexAttribArray(GLuint i)                                                    { current().stateChanges++; glDisableVertexAttribArray(i); }
+    inline void vertexAttribPointer(GLuint i, GLint s, GLenum t, GLboolean n, GLsizei st, const void *p) { current().stateChanges++; glVertexAttribPointer(i, s, t, n, st, p); }
+    inline void vertexAttribDivisor(GLuint i, GLuint d)                                               { current().stateChanges++; glVertexAttribDivisor(i, d); }
+
+    // Texture binds
+    inline void bindTexture(GLenum t, GLuint x)                                                       { current().textureBinds++; glBindTexture(t, x); }
+    inline void bindSampler(GLuint u, GLuint s)                                                       { current().textureBinds++; glBindSampler(u, s); }
+
+    // Uniform updates
+    inline void uniform1i(GLint l, GLint a)                                                           { current().uniformUpdates++; glUniform1i(l, a); }
+    inline void uniform1f(GLint l, GLfloat a)                                                         { current().uniformUpdates++; glUniform1f(l, a); }
+    inline void uniform2f(GLint l, GLfloat a, GLfloat b)                                              { current().uniformUpdates++; glUniform2f(l, a, b); }
+    inline void uniform3f(GLint l, GLfloat a, GLfloat b, GLfloat c)                                   { current().uniformUpdates++; glUniform3f(l, a, b, c); }
+    inline void uniform4f(GLint l, GLfloat a, GLfloat b, GLfloat c, GLfloat d)                        { current().uniformUpdates++; glUniform4f(l, a, b, c, d); }
+    inline void uniform4fv(GLint l, GLsizei n, const GLfloat *v)                                      { current().uniformUpdates++; glUniform4fv(l, n, v); }
+    inline void uniformMatrix3fv(GLint l, GLsizei n, GLboolean t, const GLfloat *v)                   { current().uniformUpdates++; glUniformMatrix3fv(l, n, t, v); }
+    inline void uniformMatrix4fv(GLint l, GLsizei n, GLboolean t, const GLfloat *v)                   { current().uniformUpdates++; glUniformMatrix4fv(l, n, t, v); }
+
+    // Uploads, only calls that actually carry data count
+    inline void bufferData(GLenum t, GLsizeiptr s, const void *d, GLenum u)                           { if(d) upload(s); glBufferData(t, s, d, u); }
+    inline void bufferSubData(GLenum t, GLintptr o, GLsizeiptr s, const void *d)                      { upload(s); glBufferSubData(t, o, s, d); }
+    inline void texImage2D(GLenum t, GLint l, GLint i, GLsizei w, GLsizei h, GLint b, GLenum f, GLenum y, const void *d)
+                                                                                                      { if(d) upload(w * h * pixelSize(f, y)); glTexImage2D(t, l, i, w, h, b, f, y, d); }
+    inline void texSubImage2D(GLenum t, GLint l, GLint x, GLint y, GLsizei w, GLsizei h, GLenum f, GLenum p, const void *d)
+                                                                                                      { upload(w * h * pixelSize(f, p)); glTexSubImage2D(t, l, x, y, w, h, f, p, d); }
+    inline void texImage3D(GLenum t, GLint l, GLint i, GLsizei w, GLsizei h, GLsizei z, GLint b, GLenum f, GLenum y, const void *d)
+                                                                                                      { if(d) upload(w * h * z * pixelSize(f, y)); glTexImage3D(t, l, i, w, h, z, b, f, y, d); }
+    inline void texSubImage3D(GLenum t, GLint l, GLint x, GLint y, GLint z, GLsizei w, GLsizei h, GLsizei d, GLenum f, GLenum p, const void *v)
+                                                                                                      { upload(w * h * d * pixelSize(f, p)); glTexSubImage3D(t, l, x, y, z, w, h, d, f, p, v); }
+
+#else
+
+    inline void upload(unsigned int)                                                                  { }
+
+#endif
+}
+
+
+#ifdef FUR_GL_STATS
+
+#undef glDrawArrays
+#undef glDrawElements
+#undef glDrawArraysInstanced
+#undef glDrawElementsInstanced
+#undef glMultiDrawElementsIndirect
+#undef glUseProgram
+#undef glBindVertexArray
+#undef glBindBuffer
+#undef glBindBufferBase
+#undef glBindBufferRange
+#undef glBindFramebuffer
+#undef glEnable
+#undef glDisable
+#undef glBlendFunc
+#undef glBlendFuncSeparate
+#undef glDepthMask
+#undef glViewport
+#undef glActiveTexture
+#undef glEnableVertexAttribArray
+#undef glDisableVertexAttribArray
+#undef glVertexAttribPointer
+#undef glVertexAttribDivisor
+#undef glBindTexture
+#undef glBindSampler
+#undef glUniform1i
+#undef glUniform1f
+#undef glUniform2f
+#undef glUniform3f
+#undef glUniform4f
+#undef glUniform4fv
+#undef glUniformMatrix3fv
+#undef glUniformMatrix4fv
+#undef glBufferData
+#undef glBufferSubData
+#undef glTexImage2D
+#undef glTexSubImage2D
+#undef glTexImage3D
+#undef glTexSubImage3D
+
+#define glDrawArrays                GLStats::drawArrays
+#define glDrawElements              GLStats::drawElements
+#define glDrawArraysInstanced       GLStats::drawArraysInstanced
+#define glDrawElementsInstanced     GLStats::drawElementsInstanced
+#define glMultiDrawElementsIndirect GLStats::multiDrawElementsIndirect
+#define glUseProgram                GLStats::useProgram
+#define glBindVertexArray           GLStats::bindVertexArray
+#define glBindBuffer                GLStats::bindBuffer
+#define glBindBufferBase            GLStats::bindBufferBase
+#define glBindBufferRange           GLStats::bindBufferRange
+#define glBindFramebuffer           GLStats::bindFramebuffer
+#define glEnable                    GLStats::enable
+#define glDisable                   GLStats::disable
+#define glBlendFunc                 GLStats::blendFunc
+#define glBlendFuncSeparate         GLStats::blendFuncSeparate
+#define glDepthMask                 GLStats::depthMask
+#define glViewport                  GLStats::viewport
+#define glActiveTexture             GLStats::activeTexture
+#define glEnableVertexAttribArray   GLStats::enableVertexAttribArray
+#define glDisableVertexAttribArray  GLStats::disableVertexAttribArray
+#define glVertexAttribPointer       GLStats::vertexAttribPointer
+#define glVertexAttribDivisor       GLStats::vertexAttribDivisor
+#define glBindTexture               GLStats::bindTexture
+#define glBindSampler               GLStats::bindSampler
+#define glUniform1i                 GLStats::uniform1i
+#define glUniform1f                 GLStats::uniform1f
+#define glUniform2f                 GLStats::uniform2f
+#define glUniform3f                 GLStats::uniform3f
+#define glUniform4f                 GLStats::uniform4f
+#define glUniform4fv                GLStats::uniform4fv
+#define glUniformMatrix3fv          GLStats::uniformMatrix3fv
+#define glUniformMatrix4fv          GLStats::uniformMatrix4fv
+#define glBufferData                GLStats::bufferData
+#define glBufferSubData             GLStats::bufferSubData
+#define glTexImage2D                GLStats::texImage2D
+#define glTexSubImage2D             GLStats::texSubImage2D
+#define glTexImage3D                GLStats::texImage3D
+#define glTexSubImage3D             GLStats::texSubImage3D
+
+#endif // FUR_GL_STATS
+
+#endif // GLSTATS_H
@@ -0,0 +1,61 @@
+/*
+ *	Measures a span of GL commands with one kind of query (GL_TIME_ELAPSED,
+ *	GL_SAMPLES_PASSED, ...). The queries are kept in a small ring and only read
+ *	back once the GPU has finished them, so measuring never stalls the pipeline:
+ *	the result reported is from a few frames ago.
+ */
+#ifndef GPUQUERY_H
+#define GPUQUERY_H
+
+#include <GL/glew.h>
+
+
+class GPUQuery {
+
+public:
+
+    explicit GPUQuery(GLenum);
+
+    ~GPUQuery();
+
+    void     initialize();
+
+    // Spans can't nest, GL only allows one active query per target
+    void     begin();
+
+    void     end();
+
+    // Result of the latest span that has finished on the GPU, 0 until there is one
+    GLuint64 getResult()                        { return mResult; }
+
+private:
+
+    // Functions
+
+    void collect(unsigned int, bool);
+
+
+    // Constants
+
+    static const unsigned int QUERIES = 4;
+
+
+    // Instance variables
+
+    GLenum mTarget;
+
+    GLuint64 mResult = 0;
+
+    unsigned int mCurrent = 0;
+
+    bool mRunning = false;
+
+    bool mPending[QUERIES];
+
+
+    // Indices for the queries
+
+    GLuint queryIDs[QUERIES];
+};
+
+#endif // GPUQUERY_H
@@ -0,0 +1,21 @@
+/*
+ *	Measures how long the GPU spends on a span of commands with GL_TIME_ELAPSED
+ *	queries, without stalling: the time reported is from a few frames ago.
+ */
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include "GPUQuery.h"
+
+
+class GPUTimer : public GPUQuery {
+
+public:
+
+    GPUTimer() : GPUQuery(GL_TIME_ELAPSED) {}
+
+    // Milliseconds of the latest span that has finished on the GPU, 0 until there is one
+    float getTime()                            { return static_cast<float>(getResult()) / 1000000.0f; }
+};
+
+#endif // GPUTIMER_H
@@ -0,0 +1,44 @@
+/*
+ *	Turns the triangle soup from the obj loader into an indexed mesh, and builds
+ *	coarser versions of it with quadric error metric edge collapses (Garland and
+ *	Heckbert). Every collapse moves a vertex onto one of its neighbours, so all
+ *	levels index the same vertex buffer and keep the original UVs and normals.
+ *	Corners that differ in UV or normal at the same position (seams) only ever
+ *	collapse along the seam, so textures don't tear, and mesh borders stay put.
+ */
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+// One level of detail, a range in the shared index buffer
+struct MeshLOD {
+    unsigned int first     = 0;     // First index
+    unsigned int count     = 0;     // Number of indices, three per triangle
+};
+
+
+// Merges the corners with identical position, UV and normal. The attributes are replaced by
+// the unique vertices, and the indices of the triangles into them are returned.
+void weldMesh(
+    std::vector<glm::vec3> & vertices,
+    std::vector<glm::vec2> & uvs,
+    std::vector<glm::vec3> & normals,
+    std::vector<unsigned int> & indices
+);
+
+// Appends ever coarser copies of the triangles in indices to it, each with about ratio times the
+// triangles of the one before, until minTriangles is reached or the mesh can't be simplified further.
+// The levels are returned finest first, the first one is the mesh as it came in.
+void buildLODChain(
+    const std::vector<glm::vec3> & vertices,
+    std::vector<unsigned int> & indices,
+    std::vector<MeshLOD> & lods,
+    float ratio,
+    unsigned int minTriangles
+);
+
+#endif // MESHSIMPLIFIER_H
@@ -0,0 +1,36 @@
+/*
+ *	Cuts a triangle list into meshlets, small groups of nearby triangles with
+ *	bounds that are cheap to cull: a sphere around them and a cone around their
+ *	normals. The triangles are ordered along a Morton curve of their centers
+ *	first, so that consecutive ones are close together.
+ */
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+// Same layout as the std430 struct in the culling shader
+struct Meshlet {
+    glm::vec4    sphere;            // Center and radius
+    glm::vec4    cone;              // Mean normal, and the smallest cosine of a triangle normal to it
+    unsigned int firstIndex = 0;    // Range in the index buffer, three per triangle
+    unsigned int count      = 0;
+    unsigned int height     = 0;    // Free for the user, not read by the shader
+    unsigned int pad        = 0;
+};
+
+
+// Reorders the triangles (indices of triangles, not of vertices) and appends the meshlets they make,
+// with at most maxTriangles each. The range of a meshlet is relative to the start of the list.
+void buildMeshlets(
+    const std::vector<glm::vec3> & vertices,
+    const std::vector<unsigned int> & indices,
+    std::vector<unsigned int> & triangles,
+    std::vector<Meshlet> & meshlets,
+    unsigned int maxTriangles
+);
+
+#endif // MESHLETS_H
@@ -0,0 +1,39 @@
+/*
+ *	Helpers for the golden image regression mode: PNG io, perceptual image
+ *	comparison and the stored frame time baseline.
+ */
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GLStats.h"
+
+
+struct ImageDiff {
+    unsigned int mismatchedPixels = 0;
+    unsigned int totalPixels      = 0;
+    float        maxDelta         = 0.0f;
+
+    float mismatchFraction() const { return totalPixels ? static_cast<float>(mismatchedPixels) / totalPixels : 1.0f; }
+};
+
+// Write and read tightly packed, bottom-up RGBA8 images, i.e. the layout glReadPixels gives us
+bool writePNG(const std::string &, int, int, const std::vector<GLubyte> &);
+
+bool readPNG(const std::string &, int &, int &, std::vector<GLubyte> &);
+
+// Compare two images in YIQ space, a pixel is mismatched when its perceptual
+// delta is above the threshold (0 = exact, 1 = anything goes)
+ImageDiff compareImages(const std::vector<GLubyte> &, const std::vector<GLubyte> &, int, int, float);
+
+// Frame time baseline, one "<scene name> <milliseconds>" entry per line
+bool loadTimings(const std::string &, std::map<std::string, double> &);
+
+bool saveTimings(const std::string &, const std::map<std::string, double> &);
+
+#endif // REGRESSION_H
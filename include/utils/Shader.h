@@ -1,6 +1,20 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+// Vertex and fragment program. Returns 0 if it doesn't compile or link.
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
 
+// Program with tessellation control and evaluation stages, needs GL 4.0. Returns 0 if it doesn't compile or link.
+GLuint LoadShaders(const char * vertex_file_path, const char * control_file_path, const char * evaluation_file_path, const char * fragment_file_path);
+
+// Program with a geometry shader stage. Returns 0 if it doesn't compile or link.
+GLuint LoadShaders(const char * vertex_file_path, const char * geometry_file_path, const char * fragment_file_path);
+
+// Compute program, needs GL 4.3. Returns 0 if it doesn't compile or link.
+GLuint LoadComputeShader(const char * compute_file_path);
+
+// Vertex shader only program whose outputs are captured with transform feedback, one buffer per varying.
+// Returns 0 if it doesn't compile or link.
+GLuint LoadTransformFeedbackShader(const char * vertex_file_path, const char * const * varyings, int varying_count);
+
 #endif
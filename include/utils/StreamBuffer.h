@@ -0,0 +1,91 @@
+/*
+ *	Ring buffer for data that is written by the CPU once per frame and read by
+ *	the GPU in the same frame: uniform blocks, simulated displacement and the like.
+ *	The buffer is split into one region per frame in flight, a fence per region
+ *	keeps us from overwriting data the GPU hasn't consumed yet.
+ *
+ *	With ARB_buffer_storage the whole buffer is mapped once, persistent and
+ *	coherent, and allocations just hand out pointers into it. On plain GL 3.3
+ *	every allocation maps its range unsynchronized and commit() unmaps it,
+ *	which is safe for the same reason: the fences already did the waiting.
+ *	The driver may throw away what was written through such a mapping, then
+ *	commit() says so and the data has to go up again with upload().
+ */
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <GL/glew.h>
+
+#include "GLStats.h"
+
+
+struct StreamAllocation {
+    void      *data   = nullptr;    // Where to write, null if the frame's region is full
+    GLuint     buffer = 0;
+    GLintptr   offset = 0;
+    GLsizeiptr size   = 0;
+};
+
+
+class StreamBuffer {
+
+public:
+
+    StreamBuffer();
+
+    ~StreamBuffer();
+
+    // Bytes per frame, the buffer holds FRAMES_IN_FLIGHT times that
+    bool             initialize(GLsizeiptr);
+
+    // Waits until the GPU is done with the region we're about to reuse
+    void             beginFrame();
+
+    // Fences everything allocated since beginFrame() and moves on to the next region
+    void             endFrame();
+
+    StreamAllocation allocate(GLsizeiptr, GLsizeiptr alignment = 16);
+
+    // The data written to an allocation is only visible to the GPU after this. False if it was lost.
+    bool             commit(const StreamAllocation &);
+
+    // Copies the whole allocation from the CPU, for when the data written to it was lost
+    void             upload(const StreamAllocation &, const void *);
+
+    GLuint           getBuffer()                { return bufferID; }
+
+    GLsizeiptr       getUniformAlignment()      { return mUniformAlignment; }
+
+    bool             isPersistent()             { return mPersistent; }
+
+    static const unsigned int FRAMES_IN_FLIGHT = 3;
+
+private:
+
+    // Instance variables
+
+    GLsizeiptr mRegionSize = 0;
+
+    GLsizeiptr mUsed = 0;
+
+    GLsizeiptr mUniformAlignment = 256;
+
+    unsigned int mRegion = 0;
+
+    bool mPersistent = false;
+
+    bool mOverflowReported = false;
+
+    bool mLossReported = false;
+
+    GLubyte *mMapping = nullptr;
+
+    GLsync mFences[FRAMES_IN_FLIGHT];
+
+
+    // Indices for the buffer
+
+    GLuint bufferID = 0;
+};
+
+#endif // STREAMBUFFER_H
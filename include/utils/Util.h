@@ -17,6 +17,20 @@
 #define I_PHONG		0
 #define I_FUR		1
 
+// Binding points for the uniform blocks
+#define UBO_MATERIAL	0
+#define UBO_FUR		1
+#define UBO_FRAME	2
+
+// Texture unit the wind field is bound to in the dynamics pass
+#define WIND_TEXTURE_UNIT	3
+
+// Texture unit of the strand texture on the fins
+#define FIN_TEXTURE_UNIT	4
+
+// Texture unit of the fur height bound in the shell passes
+#define MAX_HEIGHT_TEXTURE_UNIT	5
+
 #include <glm/vec3.hpp>
 
 // Overloaded operators from glm
@@ -45,12 +59,26 @@ const std::string PATH_OBJ = "assets/";
 const std::string PATH_TEX = "assets/textures/";
 const std::string FILE_NAME_OBJ = ".obj";
 const std::string FILE_NAME_PNG = ".png";
+const std::string PATH_GOLDEN = "assets/golden/";
+const std::string FILE_NAME_TIMINGS = "timings.txt";
 
 const static unsigned int UNINITIALIZED = (std::numeric_limits<unsigned int>::max)();
 
 const int WIDTH = 1024;
 const int HEIGHT = 768;
 
+// Samples per pixel of the window, alpha to coverage needs some to dither with
+const int MSAA_SAMPLES = 4;
+
+// Most instances of a geometry, the stream buffer has room for their per frame data
+const int MAX_FIELD_SIZE = 5000;
+
 typedef enum { SIMPLEX, WORLEY } NoiseType;
 
+typedef enum { CPU_DYNAMICS, GPU_DYNAMICS } DynamicsMode;
+
+typedef enum { VERTEX_SHELLS, TESSELLATED_SHELLS } FurPath;
+
+typedef enum { BLENDED_SHELLS, ALPHA_TO_COVERAGE_SHELLS, WEIGHTED_OIT_SHELLS } ShellBlending;
+
 #endif // UTIL_H
\ No newline at end of file
@@ -0,0 +1,74 @@
+/*
+ *	A fixed set of worker threads for splitting per frame loops. The threads
+ *	are started once, parallelFor() hands out chunks of an index range and
+ *	returns when all of them are done. The calling thread takes chunks too.
+ */
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class WorkerPool {
+
+public:
+
+    // A plain function and a context pointer, so that dispatching never allocates
+    typedef void (*Job)(unsigned int begin, unsigned int end, void *context);
+
+    // 0 threads means one less than the hardware has, the caller is the last one
+    WorkerPool(unsigned int threads = 0);
+
+    ~WorkerPool();
+
+    void parallelFor(unsigned int count, unsigned int grain, Job job, void *context);
+
+    unsigned int getThreadCount()            { return static_cast<unsigned int>(mThreads.size()) + 1; }
+
+private:
+
+    // Functions
+
+    void workerLoop();
+
+    bool runChunk();
+
+
+    // Instance variables
+
+    Job mJob = nullptr;
+
+    void *mContext = nullptr;
+
+    unsigned int mCount = 0;
+
+    unsigned int mGrain = 1;
+
+    std::atomic<unsigned int> mNext;
+
+    unsigned int mBusy = 0;
+
+    unsigned int mGeneration = 0;
+
+    bool mQuit = false;
+
+
+    // Synchronization
+
+    std::mutex mMutex;
+
+    std::condition_variable mWake;
+
+    std::condition_variable mDone;
+
+
+    // Containers
+
+    std::vector<std::thread> mThreads;
+};
+
+#endif // WORKERPOOL_H
@@ -0,0 +1,11 @@
+#version 330 core
+
+uniform sampler2D colorSampler;
+
+out vec4 fragmentColor;
+
+// Pixel for pixel, the source has the size of the viewport
+void main() {
+
+    fragmentColor = texelFetch(colorSampler, ivec2(gl_FragCoord.xy), 0);
+}
@@ -0,0 +1,74 @@
+#version 330 core
+
+uniform vec3      ambientColor;
+uniform vec3      diffuseColor;
+uniform sampler2DArray hairMapSampler;
+uniform sampler2D finSampler;
+
+// Written once per frame, shared by all programs
+layout(std140) uniform Frame {
+    mat4  MVP;
+    mat4  M;
+    mat4  V;
+    vec3  cameraPosition;
+    float lightPower;
+    int   noiseDetail;
+    int   shellBlending;
+    float shellJitter;
+};
+
+// Only updated when the fur is changed in the GUI, shared with the geometry shader
+layout(std140) uniform FurParameters {
+    vec3  color;
+    float furLength;
+    float furNoiseLengthVariation;
+    float furNoiseSampleScale;
+    float furPatternScale;
+    int   noiseType;
+    int   noiseLayer;
+    int   hairMapLayer;
+    float heightMargin;
+};
+
+in vec2  finUV;
+in vec2  UV;
+in vec3  normal;
+in vec3  lightDirectionCameraSpace;
+in float finOpacity;
+
+layout(location = 0) out vec4 fragmentColor;
+
+// Only drawn to in the weighted OIT pass
+layout(location = 1) out float accumulatedWeight;
+
+// Value of shellBlending for the weighted OIT pass, as in Util.h
+const int WEIGHTED_OIT_SHELLS = 2;
+
+
+void main() {
+
+    // For diffuse shading
+    vec3 n         = normalize(normal);
+    vec3 l         = normalize(lightDirectionCameraSpace);
+    float cosTheta = clamp(dot(n, l), 0, 1);
+
+    // Same shading as the shells, brighter towards the tips
+    fragmentColor.rgb = ambientColor * color
+                      + diffuseColor * color * lightPower * cosTheta * ( 2.5 * finUV.y );
+
+    // Strands seen from the side, only where the hair map has fur
+    float strand = texture(finSampler, finUV).r;
+    float hair   = texture(hairMapSampler, vec3(UV, hairMapLayer)).r;
+
+    fragmentColor.a = strand * hair * finOpacity;
+
+    // Weighted like the shells, the fins go into the same OIT targets
+    if(shellBlending == WEIGHTED_OIT_SHELLS) {
+
+        float alpha  = fragmentColor.a;
+        float weight = alpha * clamp(3e3 * pow(1.0 - gl_FragCoord.z, 3.0), 1e-2, 3e3);
+
+        fragmentColor     = vec4(fragmentColor.rgb * weight, alpha);
+        accumulatedWeight = weight;
+    }
+}
@@ -0,0 +1,88 @@
+#version 330 core
+
+// One silhouette edge in, a fin standing on it out
+layout(lines) in;
+layout(triangle_strip, max_vertices = 4) out;
+
+in vec3 geometryPosition[];
+in vec2 geometryUV[];
+in vec3 geometryNormal[];
+in vec3 geometryDisplacement[];
+
+uniform vec3 lightPosition;
+
+// Written once per frame, shared by all programs
+layout(std140) uniform Frame {
+    mat4  MVP;
+    mat4  M;
+    mat4  V;
+    vec3  cameraPosition;
+    float lightPower;
+    int   noiseDetail;
+    int   shellBlending;
+    float shellJitter;
+};
+
+// Only updated when the fur is changed in the GUI, shared with the fragment shader
+layout(std140) uniform FurParameters {
+    vec3  color;
+    float furLength;
+    float furNoiseLengthVariation;
+    float furNoiseSampleScale;
+    float furPatternScale;
+    int   noiseType;
+    int   noiseLayer;
+    int   hairMapLayer;
+    float heightMargin;
+};
+
+out vec2  finUV;
+out vec2  UV;
+out vec3  normal;
+out vec3  lightDirectionCameraSpace;
+out float finOpacity;
+
+// The fin texture repeats once per this many fur lengths along the edge
+const float FIN_TEXTURE_LENGTHS = 2.0;
+
+
+void main() {
+
+    mat4 MV = V * M;
+
+    // Fins are only worth seeing edge on, they fade out as the surface turns towards the camera
+    vec3 center         = 0.5 * (geometryPosition[0] + geometryPosition[1]);
+    vec3 edgeNormal     = normalize(geometryNormal[0] + geometryNormal[1]);
+    vec3 viewDirection  = normalize(-vec3(MV * vec4(center, 1.0)));
+    vec3 normalCamera   = normalize(mat3(MV) * edgeNormal);
+    float opacity       = 1.0 - smoothstep(0.0, 0.5, abs(dot(viewDirection, normalCamera)));
+
+    if(opacity <= 0.0)
+        return;
+
+    float u = length(geometryPosition[1] - geometryPosition[0]) / (furLength * FIN_TEXTURE_LENGTHS);
+
+    vec3 lightPostionCameraSpace = vec3(V * vec4(lightPosition, 1.0));
+
+    for(int i = 0; i < 2; i++) {
+
+        vec3 viewDirectionCameraSpace = cameraPosition - vec3(MV * vec4(geometryPosition[i], 1.0));
+
+        // Root on the skin, tip out along the normal and bent like the outermost shell
+        for(int j = 0; j < 2; j++) {
+
+            vec3 position = geometryPosition[i] + float(j) * (geometryNormal[i] * furLength + geometryDisplacement[i] * furLength);
+
+            gl_Position               = MVP * vec4(position, 1.0);
+            finUV                     = vec2(float(i) * u, float(j));
+            UV                        = geometryUV[i];
+            normal                    = vec3(transpose(inverse(MV)) * vec4(geometryNormal[i], 1.0));
+            lightDirectionCameraSpace = lightPostionCameraSpace + viewDirectionCameraSpace;
+            finOpacity                = opacity;
+
+            EmitVertex();
+        }
+    }
+
+    EndPrimitive();
+}
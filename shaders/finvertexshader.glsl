@@ -0,0 +1,22 @@
+#version 330 core
+
+// Input, the two ends of a silhouette edge
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec2 uvCoordinate;
+layout(location = 2) in vec3 vertexNormal;
+layout(location = 3) in vec3 vertexDisplacement;
+
+out vec3 geometryPosition;
+out vec2 geometryUV;
+out vec3 geometryNormal;
+out vec3 geometryDisplacement;
+
+
+void main() {
+
+    // The geometry shader builds the fin from both ends of the edge
+    geometryPosition     = vertexPosition;
+    geometryUV           = uvCoordinate;
+    geometryNormal       = normalize(vertexNormal);
+    geometryDisplacement = vertexDisplacement;
+}
@@ -0,0 +1,51 @@
+#version 330 core
+
+// Input, the rest pose and last step's state of the fur tip
+layout(location = 0) in vec3  vertexPosition;
+layout(location = 2) in vec3  vertexNormal;
+layout(location = 3) in vec3  vertexDisplacement;
+layout(location = 4) in vec3  vertexVelocity;
+layout(location = 5) in float windWeight;
+
+uniform float dt;
+uniform float stiffness;
+uniform float damping;
+uniform float maxDisplacement;
+uniform vec3  gravity;
+uniform mat3  inertia;
+
+// Wind volume in world space, texture coordinate = (position - windOrigin) * windScale
+uniform sampler3D windFieldSampler;
+uniform mat3      toWorld;
+uniform vec3      windOrigin;
+uniform float     windScale;
+
+// Captured with transform feedback into the other pair of buffers
+out vec3 displacement;
+out vec3 velocity;
+
+
+// Same damped spring as the CPU dynamics in FurDynamics.cpp, one vertex per invocation
+void main() {
+
+    // Inertia, the tip lags behind the rotation of the root
+    vec3 d = vertexDisplacement - inertia * vertexPosition;
+
+    // Wind at this vertex, brought back to object space
+    vec3 windWorld = texture(windFieldSampler, (toWorld * vertexPosition - windOrigin) * windScale).xyz;
+    vec3 wind      = transpose(toWorld) * windWorld * windWeight;
+
+    // a = gravity + wind - k d - c v
+    vec3 a = gravity + wind - stiffness * d - damping * vertexVelocity;
+
+    // Semi-implicit Euler
+    velocity = vertexVelocity + a * dt;
+    d       += velocity * dt;
+
+    // Don't bend into the skin
+    vec3 n = normalize(vertexNormal);
+    d -= min(dot(d, n), 0.0) * n;
+
+    // And not further than the strand reaches
+    displacement = d * min(1.0, maxDisplacement / sqrt(dot(d, d) + 1e-12));
+}
@@ -1,29 +1,57 @@
 #version 330 core
 
-uniform vec3      cameraPosition;
-uniform vec3      color;
 uniform vec3      ambientColor;
 uniform vec3      diffuseColor;
 uniform vec3      lightPosition;
 uniform float     transparency;
-uniform float     lightPower;
 uniform float     layerOffset;
-uniform float     furLength;
 uniform int       numberOfLayers;
 uniform int       layerIndex;
-uniform int       noiseType;
-uniform float     furNoiseLengthVariation;
-uniform float     furNoiseSampleScale;
-uniform sampler2D textureSampler;
-uniform sampler2D hairMapSampler;
+uniform float     shellAlphaExponent;   // Number of shells divided by the number drawn, 1 without LOD
+uniform sampler2DArray textureSampler;    // Layer noiseLayer of the noise array
+uniform sampler2DArray hairMapSampler;    // Layer hairMapLayer of the hair map array
+uniform sampler2D maxHeightSampler;    // Highest noise value the fur can have around a texel, 0 where there is none
+
+// Written once per frame, shared by all programs
+layout(std140) uniform Frame {
+    mat4  MVP;
+    mat4  M;
+    mat4  V;
+    vec3  cameraPosition;
+    float lightPower;
+    int   noiseDetail;
+    int   shellBlending;
+    float shellJitter;
+};
+
+// Only updated when the fur is changed in the GUI, shared with the vertex shader
+layout(std140) uniform FurParameters {
+    vec3  color;
+    float furLength;
+    float furNoiseLengthVariation;
+    float furNoiseSampleScale;
+    float furPatternScale;
+    int   noiseType;
+    int   noiseLayer;
+    int   hairMapLayer;
+    float heightMargin;         // From Geometry.cpp, which skips whole shells with the same margin
+};
 
 in vec3 normal;
 in vec3 vertexPositionModelSpace;
 in vec3 lightDirectionCameraSpace;
 in vec2 UV;
 in vec3 UV3D;
+flat in vec3 furTint;
+
+layout(location = 0) out vec4 fragmentColor;
+
+// Only drawn to in the weighted OIT pass
+layout(location = 1) out float accumulatedWeight;
+
+// Value of shellBlending for the weighted OIT pass, as in Util.h
+const int WEIGHTED_OIT_SHELLS = 2;
 
-out vec4 fragmentColor;
 
 
 // Description : Array and textureless GLSL 2D/3D/4D simplex 
@@ -299,48 +327,68 @@ float aastep(float threshold, float value) {
 
 void main() {
 
+    // Height of this shell in layers, jittered down like the vertices in the temporal mode
+    float layer = max(float(layerIndex) - shellJitter * shellAlphaExponent, 0.0);
+
+    // Nothing around here reaches this shell, not even with the longest length noise, so skip all the noise
+    float maxHeight = texture(maxHeightSampler, UV).r;
+
+    if(maxHeight == 0.0 || maxHeight < 0.2 + 0.8 * layer / float(numberOfLayers) - furNoiseLengthVariation - heightMargin)
+        discard;
+
     // For diffuse shading
     vec3 n         = normalize(normal);
     vec3 l         = normalize(lightDirectionCameraSpace);
     float cosTheta = clamp(dot(n, l), 0, 1);
 
-    // The worley noise pattern on the fur
-    vec2  worleySample   = cellular(UV3D * 0.2);
-    float worleyColor    = worleySample.y - worleySample.x;
-    float darkSpotWorley = smoothstep(0.95, 0.8, worleyColor * 10.0);
-    worleyColor = darkSpotWorley;
-
-    // The simplex noise pattern for the fur
-    float simplexSample = snoise(UV3D * 0.2);
-    float simplexColor  = smoothstep(0.3, 0.1, simplexSample);
-
     // Depending on the GUI input, pick the according noise function (simplex or worley),
     // This hack is not the most awesome thing I've ever created, but atleast it's faster than
     // evaluating both noise functions and the then pick the correct color.
-    vec2  noiseSample = (noiseType == 0) ? vec2(snoise(UV3D * 0.2), 0.0) : cellular(UV3D * 0.2);
-    float noiseColor  = (noiseType == 0) ? (noiseSample.x - noiseSample.y) : (noiseSample.y - noiseSample.x);
-    noiseColor        = (noiseType == 0) ? smoothstep(0.3, 0.1, noiseColor) : smoothstep(0.95, 0.8, noiseColor * 10.0);
+    // At its cheapest levels the quality governor leaves the pattern out.
+    float noiseColor = 1.0;
+
+    if(noiseDetail > 0) {
+        vec2 noiseSample = (noiseType == 0) ? vec2(snoise(UV3D * 0.2), 0.0) : cellular(UV3D * 0.2);
+        noiseColor       = (noiseType == 0) ? (noiseSample.x - noiseSample.y) : (noiseSample.y - noiseSample.x);
+        noiseColor       = (noiseType == 0) ? smoothstep(0.3, 0.1, noiseColor) : smoothstep(0.95, 0.8, noiseColor * 10.0);
+    }
 
     // Apply shading, the diffuse term is determined by the index of the current shell
-    fragmentColor.rgb = ambientColor * color
-                      + diffuseColor * color * lightPower * cosTheta * ( 2.5 * float(layerIndex) / float(numberOfLayers) );
+    vec3 furColor = color * furTint;
+
+    fragmentColor.rgb = ambientColor * furColor
+                      + diffuseColor * furColor * lightPower * cosTheta * ( 2.5 * layer / float(numberOfLayers) );
 
     // Apply the worley noise color
     fragmentColor.rgb *= (noiseColor * 0.8) + 0.2;
 
     // Get value from fur noise texture
-    float furSample = texture(textureSampler, UV).r;
+    float furSample = texture(textureSampler, vec3(UV, noiseLayer)).r;
 
     // Get value from hair map texture, detrmines if there should be fur or not
-    vec3 heightSample = texture(hairMapSampler, UV).rgb;
+    vec3 heightSample = texture(hairMapSampler, vec3(UV, hairMapLayer)).rgb;
 
     // Vary the fur length with some simplex noise
-    float furLengthNoise = snoise(vertexPositionModelSpace * furNoiseSampleScale);
+    float furLengthNoise = (noiseDetail > 1) ? snoise(vertexPositionModelSpace * furNoiseSampleScale) : 0.0;
 
     // This where everything comes together, the noise texture is thresholded depending on a lot of factors
-    furSample = aastep(0.2 + (float(layerIndex) / float(numberOfLayers) * 0.8) + (furLengthNoise * furNoiseLengthVariation), furSample);
+    furSample = aastep(0.2 + (layer / float(numberOfLayers) * 0.8) + (furLengthNoise * furNoiseLengthVariation), furSample);
 
     // Finaly apply the thresholded noise texture to the alpha channel of the fragment, 
     // this will create a surface that looks like fur.
-    fragmentColor.a = heightSample.x * furSample * (1.0 - (float(layerIndex) / float(numberOfLayers)));
+    fragmentColor.a = heightSample.x * furSample * (1.0 - (layer / float(numberOfLayers)));
+
+    // When only some of the shells are drawn, each one stands in for several: 1 - (1 - a)^n
+    fragmentColor.a = 1.0 - pow(1.0 - fragmentColor.a, shellAlphaExponent);
+
+    // Weighted OIT, nearer fragments weigh more (McGuire and Bavoil, equation 9). The blending sums
+    // the weighted premultiplied color and turns the alpha into the revealage.
+    if(shellBlending == WEIGHTED_OIT_SHELLS) {
+
+        float alpha  = fragmentColor.a;
+        float weight = alpha * clamp(3e3 * pow(1.0 - gl_FragCoord.z, 3.0), 1e-2, 3e3);
+
+        fragmentColor     = vec4(fragmentColor.rgb * weight, alpha);
+        accumulatedWeight = weight;
+    }
 }
\ No newline at end of file
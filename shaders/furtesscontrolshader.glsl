@@ -0,0 +1,117 @@
+#version 400 core
+
+// One triangle in, one triangle out, the evaluation shader does the subdivision
+layout(vertices = 3) out;
+
+in vec3 controlPosition[];
+in vec2 controlUV[];
+in vec3 controlNormal[];
+in vec3 controlDisplacement[];
+in mat4 controlTransform[];
+in vec4 controlTintSeed[];
+
+out vec3 evaluationPosition[];
+out vec2 evaluationUV[];
+out vec3 evaluationNormal[];
+out vec3 evaluationDisplacement[];
+
+// The same for the whole patch, it's one instance
+patch out mat4 patchTransform;
+patch out vec4 patchTintSeed;
+
+// Inner control points of the cubic PN triangle, the corners are the vertex positions
+patch out vec3 b210;
+patch out vec3 b120;
+patch out vec3 b021;
+patch out vec3 b012;
+patch out vec3 b102;
+patch out vec3 b201;
+patch out vec3 b111;
+
+uniform vec2  viewportSize;
+uniform float tessEdgePixels;    // Wanted length of a tessellated edge on screen
+uniform float maxTessLevel;
+
+// Written once per frame, shared by all programs
+layout(std140) uniform Frame {
+    mat4  MVP;
+    mat4  M;
+    mat4  V;
+    vec3  cameraPosition;
+    float lightPower;
+    int   noiseDetail;
+    int   shellBlending;
+    float shellJitter;
+};
+
+// Edges whose ends disagree this much about the normal get up to this many times the subdivision
+const float CURVATURE_GAIN = 4.0;
+
+
+vec2 toScreen(vec3 position) {
+
+    vec4 clip = MVP * controlTransform[0] * vec4(position, 1.0);
+
+    return (clip.xy / max(clip.w, 0.0001)) * 0.5 * viewportSize;
+}
+
+
+// Subdivision of the edge from a to b, from its length on screen and how much the surface bends along it
+float edgeLevel(int a, int b) {
+
+    vec4 clipA = MVP * controlTransform[0] * vec4(controlPosition[a], 1.0);
+    vec4 clipB = MVP * controlTransform[0] * vec4(controlPosition[b], 1.0);
+
+    // Behind the camera, nothing to refine
+    if(clipA.w <= 0.0 && clipB.w <= 0.0)
+        return 1.0;
+
+    float pixels    = length(toScreen(controlPosition[a]) - toScreen(controlPosition[b]));
+    float curvature = 1.0 + CURVATURE_GAIN * (1.0 - dot(controlNormal[a], controlNormal[b]));
+
+    return clamp(pixels / tessEdgePixels * curvature, 1.0, maxTessLevel);
+}
+
+
+// Control point a third along the edge from i to j, projected onto the tangent plane at i
+vec3 edgePoint(int i, int j) {
+
+    vec3 pi = controlPosition[i];
+    vec3 pj = controlPosition[j];
+
+    return (2.0 * pi + pj - dot(pj - pi, controlNormal[i]) * controlNormal[i]) / 3.0;
+}
+
+
+void main() {
+
+    evaluationPosition[gl_InvocationID]     = controlPosition[gl_InvocationID];
+    evaluationUV[gl_InvocationID]           = controlUV[gl_InvocationID];
+    evaluationNormal[gl_InvocationID]       = controlNormal[gl_InvocationID];
+    evaluationDisplacement[gl_InvocationID] = controlDisplacement[gl_InvocationID];
+
+    if(gl_InvocationID != 0)
+        return;
+
+    patchTransform = controlTransform[0];
+    patchTintSeed  = controlTintSeed[0];
+
+    b210 = edgePoint(0, 1);
+    b120 = edgePoint(1, 0);
+    b021 = edgePoint(1, 2);
+    b012 = edgePoint(2, 1);
+    b102 = edgePoint(2, 0);
+    b201 = edgePoint(0, 2);
+
+    vec3 edgeCenter   = (b210 + b120 + b021 + b012 + b102 + b201) / 6.0;
+    vec3 vertexCenter = (controlPosition[0] + controlPosition[1] + controlPosition[2]) / 3.0;
+
+    b111 = edgeCenter + (edgeCenter - vertexCenter) * 0.5;
+
+    // Outer level i belongs to the edge across from vertex i
+    gl_TessLevelOuter[0] = edgeLevel(1, 2);
+    gl_TessLevelOuter[1] = edgeLevel(2, 0);
+    gl_TessLevelOuter[2] = edgeLevel(0, 1);
+
+    gl_TessLevelInner[0] = max(gl_TessLevelOuter[0], max(gl_TessLevelOuter[1], gl_TessLevelOuter[2]));
+}
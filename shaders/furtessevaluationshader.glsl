@@ -0,0 +1,118 @@
+#version 400 core
+
+// Curved PN triangles, the shell extrusion of furvertexshader.glsl happens on the refined surface
+layout(triangles, equal_spacing, ccw) in;
+
+in vec3 evaluationPosition[];
+in vec2 evaluationUV[];
+in vec3 evaluationNormal[];
+in vec3 evaluationDisplacement[];
+
+patch in vec3 b210;
+patch in vec3 b120;
+patch in vec3 b021;
+patch in vec3 b012;
+patch in vec3 b102;
+patch in vec3 b201;
+patch in vec3 b111;
+
+patch in mat4 patchTransform;
+patch in vec4 patchTintSeed;
+
+uniform vec3  lightPosition;
+uniform float layerOffset;
+uniform int   numberOfLayers;
+uniform float shellAlphaExponent;
+
+// Written once per frame, shared by all programs
+layout(std140) uniform Frame {
+    mat4  MVP;
+    mat4  M;
+    mat4  V;
+    vec3  cameraPosition;
+    float lightPower;
+    int   noiseDetail;
+    int   shellBlending;
+    float shellJitter;
+};
+
+// Only updated when the fur is changed in the GUI, shared with the fragment shader
+layout(std140) uniform FurParameters {
+    vec3  color;
+    float furLength;
+    float furNoiseLengthVariation;
+    float furNoiseSampleScale;
+    float furPatternScale;
+    int   noiseType;
+    int   noiseLayer;
+    int   hairMapLayer;
+    float heightMargin;
+};
+
+// The same outputs as furvertexshader.glsl, so that the fur fragment shader is shared
+out vec3 normal;
+out vec3 vertexPositionModelSpace;
+out vec3 lightDirectionCameraSpace;
+out vec2 UV;
+out vec3 UV3D;
+flat out vec3 furTint;
+
+// As in furvertexshader.glsl
+const vec3 SEED_OFFSET = vec3(12.9898, 78.233, 37.719);
+
+
+void main() {
+
+    float u = gl_TessCoord.x;
+    float v = gl_TessCoord.y;
+    float w = gl_TessCoord.z;
+
+    // Cubic Bezier triangle through the corners
+    vec3 vertexPosition = evaluationPosition[0] * u * u * u
+                        + evaluationPosition[1] * v * v * v
+                        + evaluationPosition[2] * w * w * w
+                        + b210 * 3.0 * u * u * v
+                        + b120 * 3.0 * u * v * v
+                        + b201 * 3.0 * u * u * w
+                        + b021 * 3.0 * v * v * w
+                        + b102 * 3.0 * u * w * w
+                        + b012 * 3.0 * v * w * w
+                        + b111 * 6.0 * u * v * w;
+
+    // The rest is interpolated linearly
+    vec3 vertexNormal       = normalize(evaluationNormal[0] * u + evaluationNormal[1] * v + evaluationNormal[2] * w);
+    vec3 vertexDisplacement = evaluationDisplacement[0] * u + evaluationDisplacement[1] * v + evaluationDisplacement[2] * w;
+
+    vec3 noisePosition = vertexPosition + patchTintSeed.w * SEED_OFFSET;
+
+    vertexPositionModelSpace = noisePosition;
+
+    furTint = patchTintSeed.rgb;
+
+    UV = evaluationUV[0] * u + evaluationUV[1] * v + evaluationUV[2] * w;
+
+    // Jittered down in the temporal mode, as in furvertexshader.glsl
+    float offset = layerOffset - shellJitter * shellAlphaExponent * furLength / float(numberOfLayers);
+
+    // Shells bend quadratically towards the displacement from the dynamics, so that the roots stay put
+    float height = offset / furLength;
+    vec3 bend    = vertexDisplacement * offset * height;
+
+    // Move the vertex out along the normal and bend it
+    vec3 surfaceAdvection = vertexPosition + vertexNormal * offset + bend;
+
+    gl_Position = MVP * patchTransform * vec4(surfaceAdvection, 1.0);
+
+    // This is used to evaluate the worley noise function
+    UV3D = noisePosition * furPatternScale;
+
+    // Compute some directions and postions for the diffuse shading
+    mat4 MV = V * M * patchTransform;
+
+    vec3 vertexPositionCameraSpace = vec3(MV * vec4(vertexPosition, 1.0));
+    vec3 viewDirectionCameraSpace  = cameraPosition - vertexPositionCameraSpace;
+    vec3 lightPostionCameraSpace   = vec3(V * vec4(lightPosition, 1.0));
+    lightDirectionCameraSpace      = lightPostionCameraSpace + viewDirectionCameraSpace;
+
+    normal = vec3(transpose(inverse(MV)) * vec4(vertexNormal, 1.0));
+}
@@ -0,0 +1,30 @@
+#version 400 core
+
+// Input, the coarse patches of the tessellated shell path
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec2 uvCoordinate;
+layout(location = 2) in vec3 vertexNormal;
+layout(location = 3) in vec3 vertexDisplacement;
+
+// Per instance, see FurInstance.h
+layout(location = 4) in mat4 instanceTransform;
+layout(location = 8) in vec4 instanceTintSeed;
+
+out vec3 controlPosition;
+out vec2 controlUV;
+out vec3 controlNormal;
+out vec3 controlDisplacement;
+out mat4 controlTransform;
+out vec4 controlTintSeed;
+
+
+void main() {
+
+    // Everything happens per patch in the control and evaluation shaders
+    controlPosition     = vertexPosition;
+    controlUV           = uvCoordinate;
+    controlNormal       = normalize(vertexNormal);
+    controlDisplacement = vertexDisplacement;
+    controlTransform    = instanceTransform;
+    controlTintSeed     = instanceTintSeed;
+}
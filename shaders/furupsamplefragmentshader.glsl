@@ -0,0 +1,49 @@
+#version 330 core
+
+uniform sampler2D furColorSampler;  // Premultiplied fur, only the lower left furSize texels are used
+uniform sampler2D furDepthSampler;  // Skin depth at the fur resolution
+uniform sampler2D depthSampler;     // Skin depth at full resolution
+uniform float     furScale;         // Fur resolution divided by the full resolution
+uniform ivec2     furSize;
+uniform vec2      depthUnproject;   // Projection matrix [2][2] and [3][2]
+
+out vec4 fragmentColor;
+
+// Relative depth difference at which a fur texel only counts half as much
+const float DEPTH_TOLERANCE = 0.01;
+
+
+float viewDistance(float depth) {
+
+    return depthUnproject.y / (depth * 2.0 - 1.0 + depthUnproject.x);
+}
+
+
+void main() {
+
+    float distance = viewDistance(texelFetch(depthSampler, ivec2(gl_FragCoord.xy), 0).r);
+
+    // Where this pixel lands in the fur target, texel centers are at + 0.5
+    vec2  position = gl_FragCoord.xy * furScale - 0.5;
+    ivec2 base     = ivec2(floor(position));
+    vec2  f        = position - vec2(base);
+
+    vec4  color  = vec4(0.0);
+    float weight = 0.0;
+
+    // Bilinear weights of the four nearest fur texels, turned down where their skin is at another depth
+    for(int i = 0; i < 4; i++) {
+
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel  = clamp(base + offset, ivec2(0), furSize - 1);
+
+        float bilinear   = mix(1.0 - f.x, f.x, float(offset.x)) * mix(1.0 - f.y, f.y, float(offset.y));
+        float difference = abs(viewDistance(texelFetch(furDepthSampler, texel, 0).r) - distance) / distance;
+        float w          = bilinear / (1.0 + difference / DEPTH_TOLERANCE);
+
+        color  += texelFetch(furColorSampler, texel, 0) * w;
+        weight += w;
+    }
+
+    fragmentColor = color / max(weight, 1e-5);
+}
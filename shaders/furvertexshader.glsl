@@ -4,136 +4,94 @@
 layout(location = 0) in vec3 vertexPosition;
 layout(location = 1) in vec2 uvCoordinate;
 layout(location = 2) in vec3 vertexNormal;
+layout(location = 3) in vec3 vertexDisplacement;
+
+// Per instance, see FurInstance.h. Identity, white and 0 for a geometry without instances.
+layout(location = 4) in mat4 instanceTransform;
+layout(location = 8) in vec4 instanceTintSeed;
 
-uniform mat4  MVP;
-uniform mat4  M;
-uniform mat4  V;
 uniform vec3  lightPosition;
-uniform vec3  cameraPosition;
 uniform float layerOffset;
-uniform float currentTime;
-uniform float windVelocity;
-uniform float furPatternScale;
 uniform int   numberOfLayers;
 uniform int   layerIndex;
-uniform sampler2D hairMapSampler;
+uniform float shellAlphaExponent;   // Number of shells divided by the number drawn
+uniform sampler2DArray hairMapSampler;
+
+// Written once per frame, shared by all programs
+layout(std140) uniform Frame {
+    mat4  MVP;
+    mat4  M;
+    mat4  V;
+    vec3  cameraPosition;
+    float lightPower;
+    int   noiseDetail;
+    int   shellBlending;
+    float shellJitter;
+};
+
+// Only updated when the fur is changed in the GUI, shared with the fragment shader
+layout(std140) uniform FurParameters {
+    vec3  color;
+    float furLength;
+    float furNoiseLengthVariation;
+    float furNoiseSampleScale;
+    float furPatternScale;
+    int   noiseType;
+    int   noiseLayer;
+    int   hairMapLayer;
+    float heightMargin;
+};
 
 out vec3 normal;
 out vec3 vertexPositionModelSpace;
 out vec3 lightDirectionCameraSpace;
 out vec2 UV;
 out vec3 UV3D;
+flat out vec3 furTint;
 
-
-// Description : Array and textureless GLSL 2D simplex noise function.
-//      Author : Ian McEwan, Ashima Arts.
-//  Maintainer : ijm
-//     Lastmod : 20110822 (ijm)
-//     License : Copyright (C) 2011 Ashima Arts. All rights reserved.
-//               Distributed under the MIT License. See LICENSE file.
-//               https://github.com/ashima/webgl-noise
-
-vec3 mod289(vec3 x) {
-    return x - floor(x * (1.0 / 289.0)) * 289.0;
-}
-
-
-vec2 mod289(vec2 x) {
-    return x - floor(x * (1.0 / 289.0)) * 289.0;
-}
-
-
-vec3 permute(vec3 x) {
-    return mod289(((x*34.0)+1.0)*x);
-}
-
-
-float snoise(vec2 v) {
-    
-    const vec4 C = vec4(0.211324865405187,  // (3.0-sqrt(3.0))/6.0
-                      0.366025403784439,  // 0.5*(sqrt(3.0)-1.0)
-                     -0.577350269189626,  // -1.0 + 2.0 * C.x
-                      0.024390243902439); // 1.0 / 41.0
-    // First corner
-    vec2 i  = floor(v + dot(v, C.yy) );
-    vec2 x0 = v -   i + dot(i, C.xx);
-
-    // Other corners
-    vec2 i1;
-    //i1.x = step( x0.y, x0.x ); // x0.x > x0.y ? 1.0 : 0.0
-    //i1.y = 1.0 - i1.x;
-    i1 = (x0.x > x0.y) ? vec2(1.0, 0.0) : vec2(0.0, 1.0);
-    // x0 = x0 - 0.0 + 0.0 * C.xx ;
-    // x1 = x0 - i1 + 1.0 * C.xx ;
-    // x2 = x0 - 1.0 + 2.0 * C.xx ;
-    vec4 x12 = x0.xyxy + C.xxzz;
-    x12.xy -= i1;
-
-    // Permutations
-    i = mod289(i); // Avoid truncation effects in permutation
-    vec3 p = permute( permute( i.y + vec3(0.0, i1.y, 1.0 ))
-        + i.x + vec3(0.0, i1.x, 1.0 ));
-
-    vec3 m = max(0.5 - vec3(dot(x0,x0), dot(x12.xy,x12.xy), dot(x12.zw,x12.zw)), 0.0);
-    m = m*m ;
-    m = m*m ;
-
-    // Gradients: 41 points uniformly over a line, mapped onto a diamond.
-    // The ring size 17*17 = 289 is close to a multiple of 41 (41*7 = 287)
-
-    vec3 x = 2.0 * fract(p * C.www) - 1.0;
-    vec3 h = abs(x) - 0.5;
-    vec3 ox = floor(x + 0.5);
-    vec3 a0 = x - ox;
-
-    // Normalise gradients implicitly by scaling m
-    // Approximation of: m *= inversesqrt( a0*a0 + h*h );
-    m *= 1.79284291400159 - 0.85373472095314 * ( a0*a0 + h*h );
-
-    // Compute final noise value at P
-    vec3 g;
-    g.x  = a0.x  * x0.x  + h.x  * x0.y;
-    g.yz = a0.yz * x12.xz + h.yz * x12.yw;
-    return 130.0 * dot(m, g);
-}
+// Turns the seed of an instance into an offset of the noise, far enough apart that the patterns don't repeat
+const vec3 SEED_OFFSET = vec3(12.9898, 78.233, 37.719);
 
 
 void main() {
 
     // This is used in the fragment shader to evaluate the noise function that varies the length of the fur.
-    vertexPositionModelSpace = vertexPosition;
+    // Every instance gets its own part of the noise.
+    vec3 noisePosition = vertexPosition + instanceTintSeed.w * SEED_OFFSET;
+
+    vertexPositionModelSpace = noisePosition;
+
+    furTint = instanceTintSeed.rgb;
 
     // Get UV coordinate, since we need this to sample from the texture in the fragment shader
     UV = uvCoordinate;
 
-    // Forces that makes the fur move
-    vec3 gravity       = vec3(0.0, -9.82, 0.0);
-    vec3 windDirection = vec3(0.0, 0.0, 0.0);
-    windDirection.x    = sin(currentTime * 3.0 + cos(snoise(vec2(currentTime, currentTime * 0.2)) * 0.5)) * 8.0 * windVelocity;
-    windDirection.y    = cos(currentTime * 2.0 + sin(snoise(vec2(currentTime * 0.05, currentTime)) * 0.5)) * 8.0 * windVelocity;
+    // The temporal mode moves every shell down by a fraction of the spacing between the drawn ones,
+    // another fraction each frame, so that the accumulated frames fill in the heights in between
+    float offset = layerOffset - shellJitter * shellAlphaExponent * furLength / float(numberOfLayers);
 
-    // How much should we allow the shell to be displaced?
-    float displacementFactor = pow(0.5 * (float(layerIndex) / float(numberOfLayers)), 3.0) * layerOffset;
-    vec3 displacement = windDirection * displacementFactor;
+    // The displacement is where the fur tip has been pushed by the dynamics, in fur lengths.
+    // Shells bend quadratically towards it, so that the roots stay put.
+    float height = offset / furLength;
+    vec3 bend    = vertexDisplacement * offset * height;
 
-    // Determine how much the vertex should be moved in the normal direction
-    vec3 surfaceAdvection = vec3(vec4(vertexPosition, 1.0)) + vertexNormal * layerOffset;
+    // Move the vertex out along the normal and bend it
+    vec3 surfaceAdvection = vertexPosition + vertexNormal * offset + bend;
 
-    // Apply transforms to the vertex
-    gl_Position    = (MVP) * vec4(surfaceAdvection, 1.0);
-    gl_Position.xyz += gravity * displacementFactor;
-    gl_Position.x += windDirection.x * displacementFactor;
-    gl_Position.y += windDirection.y * displacementFactor;
+    // Apply transforms to the vertex, the instance places the mesh first
+    gl_Position = MVP * instanceTransform * vec4(surfaceAdvection, 1.0);
 
     // This is used to evaluate the worley noise function
-    UV3D = vertexPosition * furPatternScale;
+    UV3D = noisePosition * furPatternScale;
 
     // Compute some directions and postions for the diffuse shading
-    vec3 vertexPositionCameraSpace = vec3(V * M * vec4(vertexPosition, 1.0));
+    mat4 MV = V * M * instanceTransform;
+
+    vec3 vertexPositionCameraSpace = vec3(MV * vec4(vertexPosition, 1.0));
     vec3 viewDirectionCameraSpace  = cameraPosition - vertexPositionCameraSpace;
     vec3 lightPostionCameraSpace   = vec3(V * vec4(lightPosition, 1.0));
     lightDirectionCameraSpace      = lightPostionCameraSpace + viewDirectionCameraSpace;
 
     // Transform the normal to world space
-    normal = vec3(transpose(inverse(V * M)) * vec4(vertexNormal, 1.0));
+    normal = vec3(transpose(inverse(MV)) * vec4(vertexNormal, 1.0));
 }
\ No newline at end of file
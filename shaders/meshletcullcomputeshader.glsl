@@ -0,0 +1,77 @@
+#version 430 core
+
+// One invocation per meshlet, as GROUP_SIZE in MeshletCuller.h
+layout(local_size_x = 64) in;
+
+// As in Meshlets.h
+struct Meshlet {
+    vec4 sphere;        // Center and radius
+    vec4 cone;          // Mean normal, and the smallest cosine of a triangle normal to it
+    uint firstIndex;
+    uint count;
+    uint height;
+    uint pad;
+};
+
+// The layout glMultiDrawElementsIndirect reads
+struct Command {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    uint baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+
+layout(std430, binding = 1) writeonly buffer Commands {
+    Command commands[];
+};
+
+uniform vec4  frustumPlanes[6];    // Object space, pointing inwards
+uniform vec3  eye;                 // Object space
+uniform float furReach;            // How far the outermost shell can be from the skin, bent or not
+uniform uint  meshletCount;
+
+// The shells are displaced along the vertex normals and bent by the dynamics, so their triangles can
+// face a little further round than the skin's
+const float CONE_MARGIN = 0.2;
+
+const float HALF_PI = 1.5707963;
+
+
+void main() {
+
+    uint i = gl_GlobalInvocationID.x;
+
+    if(i >= meshletCount)
+        return;
+
+    Meshlet meshlet = meshlets[i];
+
+    // Every shell of the meshlet is within the sphere grown by the fur
+    vec3  center  = meshlet.sphere.xyz;
+    float radius  = meshlet.sphere.w + furReach;
+    bool  visible = true;
+
+    for(int p = 0; p < 6; p++)
+        visible = visible && dot(frustumPlanes[p].xyz, center) + frustumPlanes[p].w >= -radius;
+
+    // Back facing when every normal in the cone points away from the eye, wherever in the sphere the triangle is
+    float angle = acos(clamp(meshlet.cone.w, -1.0, 1.0)) + CONE_MARGIN;
+
+    if(angle < HALF_PI) {
+
+        vec3 toCenter = center - eye;
+
+        visible = visible && dot(toCenter, meshlet.cone.xyz) < sin(angle) * length(toCenter) + radius;
+    }
+
+    commands[i].count         = meshlet.count;
+    commands[i].instanceCount = visible ? 1u : 0u;
+    commands[i].firstIndex    = meshlet.firstIndex;
+    commands[i].baseVertex    = 0u;
+    commands[i].baseInstance  = 0u;
+}
@@ -0,0 +1,23 @@
+#version 330 core
+
+uniform sampler2D accumulationSampler;  // Summed weighted premultiplied color, revealage in alpha
+uniform sampler2D weightSampler;        // Summed weighted alpha
+
+out vec4 fragmentColor;
+
+void main() {
+
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+    vec4  accumulation = texelFetch(accumulationSampler, pixel, 0);
+    float revealage    = accumulation.a;
+
+    // Nothing transparent in front of this pixel, leave the background alone
+    if(revealage >= 1.0)
+        discard;
+
+    float weight = texelFetch(weightSampler, pixel, 0).r;
+
+    // Weighted average color of the transparent surfaces, blended in by how much they cover
+    fragmentColor = vec4(accumulation.rgb / max(weight, 1e-5), revealage);
+}
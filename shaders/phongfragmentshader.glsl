@@ -1,15 +1,30 @@
 #version 330 core
 
-uniform vec3  	  cameraPosition;
-uniform vec3  	  color;
-uniform vec3  	  ambientColor;
-uniform vec3  	  diffuseColor;
-uniform vec3  	  specularColor;
-uniform float 	  transparency;
-uniform float 	  specularity;
-uniform float 	  shinyness;
-uniform float 	  lightPower;
-uniform sampler2D skinTextureSampler;
+uniform sampler2DArray skinTextureSampler;
+
+// Written once per frame, shared by all programs
+layout(std140) uniform Frame {
+	mat4  MVP;
+	mat4  M;
+	mat4  V;
+	vec3  cameraPosition;
+	float lightPower;
+	int   noiseDetail;
+	int   shellBlending;
+	float shellJitter;
+};
+
+// Only updated when the material is changed in the GUI
+layout(std140) uniform Material {
+	vec3  color;
+	vec3  ambientColor;
+	vec3  diffuseColor;
+	vec3  specularColor;
+	float transparency;
+	float specularity;
+	float shinyness;
+	int   skinLayer;
+};
 
 in vec3 normal;
 in vec3 lightDirectionCameraSpace;
@@ -29,7 +44,7 @@ void main() {
 	float cosAlpha = clamp(dot(E, R), 0, 1);
 
 	// Get color sample from our texture, this is the skin color
-	vec3 textureColor = texture(skinTextureSampler, UV).rgb;
+	vec3 textureColor = texture(skinTextureSampler, vec3(UV, skinLayer)).rgb;
 
 	// Apply shading and color to our fragment
 	fragmentColor.rgb = ambientColor  * textureColor
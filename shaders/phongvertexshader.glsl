@@ -5,11 +5,22 @@ layout(location = 0) in vec3 vertexPosition;
 layout(location = 1) in vec2 uvCoordinate;
 layout(location = 2) in vec3 vertexNormal;
 
-uniform mat4 MVP;
-uniform mat4 M;
-uniform mat4 V;
+// Per instance, see FurInstance.h
+layout(location = 4) in mat4 instanceTransform;
+
 uniform vec3 lightPosition;
-uniform vec3 cameraPosition;
+
+// Written once per frame, shared by all programs
+layout(std140) uniform Frame {
+	mat4  MVP;
+	mat4  M;
+	mat4  V;
+	vec3  cameraPosition;
+	float lightPower;
+	int   noiseDetail;
+	int   shellBlending;
+	float shellJitter;
+};
 
 out vec3 normal;
 out vec3 lightDirectionCameraSpace;
@@ -18,14 +29,16 @@ out vec2 UV;
 
 void main() {
 
-	// Apply MVP matrix to vertex position
-	gl_Position = MVP * vec4(vertexPosition, 1.0);
+	// Apply MVP matrix to vertex position, the instance places the mesh first
+	gl_Position = MVP * instanceTransform * vec4(vertexPosition, 1.0);
+
+	mat4 MV = V * M * instanceTransform;
 
 	// Set UV coordinate, which will be passed to the fragment shader
 	UV = uvCoordinate;
 
 	// Compute view direction, will be used in the phong shading model
-	vec3 vertexPositionCameraSpace = vec3(V * M * vec4(vertexPosition, 1.0));
+	vec3 vertexPositionCameraSpace = vec3(MV * vec4(vertexPosition, 1.0));
 	viewDirectionCameraSpace = cameraPosition - vertexPositionCameraSpace;
 
 	// Compute light directino, will also be used in the phong model
@@ -33,5 +46,5 @@ void main() {
 	lightDirectionCameraSpace = lightPostionCameraSpace + viewDirectionCameraSpace;
 
 	// Transform normal
-	normal = vec3(transpose(inverse(V * M)) * vec4(vertexNormal, 1.0));
+	normal = vec3(transpose(inverse(MV)) * vec4(vertexNormal, 1.0));
 }
\ No newline at end of file
@@ -0,0 +1,51 @@
+#version 330 core
+
+uniform sampler2D colorSampler;     // This frame
+uniform sampler2D depthSampler;     // Depth of this frame
+uniform sampler2D historySampler;   // Accumulated frames up to the last one
+uniform mat4      reprojection;     // Clip space of this frame to clip space of the last one
+uniform float     blendFactor;      // Weight of this frame
+uniform bool      historyValid;     // False on the first frame and after a reset or resize
+
+out vec4 fragmentColor;
+
+
+void main() {
+
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 size  = textureSize(colorSampler, 0);
+
+    vec4 current = texelFetch(colorSampler, pixel, 0);
+
+    // The history texture holds garbage then, possibly NaNs that even a zero weight would let through
+    if(!historyValid) {
+        fragmentColor = current;
+        return;
+    }
+
+    // Where this pixel was in the last frame
+    vec3 ndc      = vec3(gl_FragCoord.xy / vec2(size), texelFetch(depthSampler, pixel, 0).r) * 2.0 - 1.0;
+    vec4 previous = reprojection * vec4(ndc, 1.0);
+    vec2 uv       = previous.xy / previous.w * 0.5 + 0.5;
+
+    // The history may only be as dark or bright as the neighbourhood in this frame
+    vec4 low  = current;
+    vec4 high = current;
+
+    for(int y = -1; y <= 1; y++) {
+        for(int x = -1; x <= 1; x++) {
+
+            vec4 neighbour = texelFetch(colorSampler, clamp(pixel + ivec2(x, y), ivec2(0), size - 1), 0);
+
+            low  = min(low,  neighbour);
+            high = max(high, neighbour);
+        }
+    }
+
+    vec4 history = clamp(texture(historySampler, uv), low, high);
+
+    // Nothing to go on where the pixel came from outside the view
+    bool outside = any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)));
+
+    fragmentColor = outside ? current : mix(history, current, blendFactor);
+}
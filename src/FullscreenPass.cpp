@@ -0,0 +1,53 @@
+#include "../include/FullscreenPass.h"
+
+
+FullscreenPass::FullscreenPass() {
+
+    for(int i = 0; i < 4; i++)
+        mPreviousViewport[i] = 0;
+}
+
+
+FullscreenPass::~FullscreenPass() {
+
+    glDeleteVertexArrays(1, &vertexArrayID);
+}
+
+
+void FullscreenPass::initialize(int width, int height) {
+
+    mWidth  = width;
+    mHeight = height;
+
+    glGenVertexArrays(1, &vertexArrayID);
+}
+
+
+bool FullscreenPass::begin() {
+
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &mPreviousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, mPreviousViewport);
+
+    if(mPreviousViewport[2] == mWidth && mPreviousViewport[3] == mHeight)
+        return false;
+
+    mWidth  = mPreviousViewport[2];
+    mHeight = mPreviousViewport[3];
+
+    return true;
+}
+
+
+void FullscreenPass::end() {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mPreviousFramebuffer);
+    glViewport(mPreviousViewport[0], mPreviousViewport[1], mPreviousViewport[2], mPreviousViewport[3]);
+}
+
+
+void FullscreenPass::draw(RenderState &state) {
+
+    state.bindVertexArray(vertexArrayID);
+
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "../include/FurDynamics.h"
+#include "../include/utils/Simplexnoise1234.h"
+
+// SSE is everywhere on x86, other targets take the scalar path
+#if defined(__SSE__) || defined(_M_X64)
+#define FUR_SIMD
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+    const float GRAVITY = 9.82f;
+
+    // Longer steps than this are clamped, a stall shouldn't make the springs explode
+    const float MAX_TIME_STEP = 1.0f / 30.0f;
+}
+
+
+const float FurDynamics::MAX_DISPLACEMENT = 0.8f;
+
+
+FurDynamics::FurDynamics() {
+
+}
+
+
+FurDynamics::~FurDynamics() {
+
+}
+
+
+void FurDynamics::initialize(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &normals) {
+
+    mVertexCount = static_cast<unsigned int>(positions.size());
+
+    unsigned int padded = (mVertexCount + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+
+    // Padding stays zero, which is a vertex that never moves
+    std::vector<float> * arrays[] = {
+        &mPositionX, &mPositionY, &mPositionZ,
+        &mNormalX, &mNormalY, &mNormalZ,
+        &mDisplacementX, &mDisplacementY, &mDisplacementZ,
+        &mVelocityX, &mVelocityY, &mVelocityZ,
+        &mWindWeight,
+        &mWindX, &mWindY, &mWindZ
+    };
+
+    for(unsigned int i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++)
+        arrays[i]->assign(padded, 0.0f);
+
+    for(unsigned int i = 0; i < mVertexCount; i++) {
+
+        glm::vec3 n = glm::normalize(normals[i]);
+
+        mPositionX[i] = positions[i].x;
+        mPositionY[i] = positions[i].y;
+        mPositionZ[i] = positions[i].z;
+
+        mNormalX[i] = n.x;
+        mNormalY[i] = n.y;
+        mNormalZ[i] = n.z;
+
+        // Some strands catch more wind than others
+        mWindWeight[i] = 1.0f + 0.5f * snoise3(positions[i].x * 2.0f, positions[i].y * 2.0f, positions[i].z * 2.0f);
+    }
+
+    mDisplacement.assign(mVertexCount, glm::vec3(0.0f));
+
+    mForces.reset();
+}
+
+
+void FurForces::update(float step, const glm::quat &orientation, float furLength) {
+
+    glm::mat3 rotation = glm::mat3_cast(orientation);
+    glm::mat3 toObject = glm::transpose(rotation);
+
+    dt = std::min(step, MAX_TIME_STEP);
+
+    // A root at p moved from R' p to R p since the last step, while the tip wants to stay where it was
+    // in world space. In object space that leaves the tip behind by (I - R^T R') p.
+    inertia = glm::mat3(0.0f);
+
+    if(mHasPrevious && dt > 0.0f)
+        inertia = (glm::mat3(1.0f) - toObject * mPreviousRotation) * (1.0f / furLength);
+
+    mPreviousRotation = rotation;
+    mHasPrevious = true;
+
+    gravity = toObject * glm::vec3(0.0f, -GRAVITY, 0.0f);
+    toWorld = rotation;
+}
+
+
+void FurDynamics::step(WorkerPool &workers, float dt, const glm::quat &orientation, const WindField &windField, const FurParameters &parameters, glm::vec3 *output) {
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    mForces.update(dt, orientation, parameters.furLength);
+
+    if(mVertexCount == 0) {
+        mStepTime = 0.0f;
+        return;
+    }
+
+    // A zero step still runs, the output has to be written every frame
+    mOutput    = output ? output : &mDisplacement[0];
+    mWindField = &windField;
+
+    mConstants.dt              = mForces.dt;
+    mConstants.stiffness       = parameters.furStiffness;
+    mConstants.damping         = parameters.furDamping;
+    mConstants.maxDisplacement = MAX_DISPLACEMENT;
+
+    for(unsigned int i = 0; i < 3; i++) {
+        mConstants.force[i] = mForces.gravity[i];
+
+        // Row major, glm is column major
+        for(unsigned int j = 0; j < 3; j++)
+            mConstants.inertia[i * 3 + j] = mForces.inertia[j][i];
+    }
+
+    // Jobs work on whole SIMD blocks
+    unsigned int blocks = static_cast<unsigned int>(mPositionX.size()) / SIMD_WIDTH;
+
+    workers.parallelFor(blocks, VERTICES_PER_JOB / SIMD_WIDTH, integrateJob, this);
+
+    mStepTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+
+void FurDynamics::integrateJob(unsigned int begin, unsigned int end, void *context) {
+
+    static_cast<FurDynamics *>(context)->integrate(begin * SIMD_WIDTH, end * SIMD_WIDTH);
+}
+
+
+void FurDynamics::integrate(unsigned int begin, unsigned int end) {
+
+    const StepConstants &c = mConstants;
+
+    float *px = &mPositionX[0],     *py = &mPositionY[0],     *pz = &mPositionZ[0];
+    float *nx = &mNormalX[0],       *ny = &mNormalY[0],       *nz = &mNormalZ[0];
+    float *dx = &mDisplacementX[0], *dy = &mDisplacementY[0], *dz = &mDisplacementZ[0];
+    float *vx = &mVelocityX[0],     *vy = &mVelocityY[0],     *vz = &mVelocityZ[0];
+    float *w  = &mWindWeight[0];
+    float *wx = &mWindX[0],         *wy = &mWindY[0],         *wz = &mWindZ[0];
+
+    // Look up the wind at the vertices of this range first, the field is in world space
+    const glm::mat3 &toWorld  = mForces.toWorld;
+    const glm::mat3  toObject = glm::transpose(toWorld);
+
+    for(unsigned int i = begin; i < std::min(end, mVertexCount); i++) {
+
+        glm::vec3 wind = toObject * mWindField->sample(toWorld * glm::vec3(px[i], py[i], pz[i])) * w[i];
+
+        wx[i] = wind.x;
+        wy[i] = wind.y;
+        wz[i] = wind.z;
+    }
+
+#ifdef FUR_SIMD
+
+    const __m128 dt        = _mm_set1_ps(c.dt);
+    const __m128 stiffness = _mm_set1_ps(c.stiffness);
+    const __m128 damping   = _mm_set1_ps(c.damping);
+    const __m128 maxLength = _mm_set1_ps(c.maxDisplacement);
+    const __m128 zero      = _mm_setzero_ps();
+    const __m128 one       = _mm_set1_ps(1.0f);
+    const __m128 epsilon   = _mm_set1_ps(1e-12f);
+
+    const __m128 fx = _mm_set1_ps(c.force[0]), fy = _mm_set1_ps(c.force[1]), fz = _mm_set1_ps(c.force[2]);
+
+    __m128 m[9];
+    for(unsigned int j = 0; j < 9; j++)
+        m[j] = _mm_set1_ps(c.inertia[j]);
+
+    for(unsigned int i = begin; i < end; i += SIMD_WIDTH) {
+
+        __m128 x  = _mm_loadu_ps(px + i), y  = _mm_loadu_ps(py + i), z  = _mm_loadu_ps(pz + i);
+        __m128 ddx = _mm_loadu_ps(dx + i), ddy = _mm_loadu_ps(dy + i), ddz = _mm_loadu_ps(dz + i);
+        __m128 vvx = _mm_loadu_ps(vx + i), vvy = _mm_loadu_ps(vy + i), vvz = _mm_loadu_ps(vz + i);
+        __m128 windX = _mm_loadu_ps(wx + i), windY = _mm_loadu_ps(wy + i), windZ = _mm_loadu_ps(wz + i);
+
+        // Inertia, the tip lags behind the rotation of the root
+        ddx = _mm_sub_ps(ddx, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x), _mm_mul_ps(m[1], y)), _mm_mul_ps(m[2], z)));
+        ddy = _mm_sub_ps(ddy, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[3], x), _mm_mul_ps(m[4], y)), _mm_mul_ps(m[5], z)));
+        ddz = _mm_sub_ps(ddz, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[6], x), _mm_mul_ps(m[7], y)), _mm_mul_ps(m[8], z)));
+
+        // a = gravity + wind - k d - c v
+        __m128 ax = _mm_sub_ps(_mm_add_ps(fx, windX), _mm_add_ps(_mm_mul_ps(stiffness, ddx), _mm_mul_ps(damping, vvx)));
+        __m128 ay = _mm_sub_ps(_mm_add_ps(fy, windY), _mm_add_ps(_mm_mul_ps(stiffness, ddy), _mm_mul_ps(damping, vvy)));
+        __m128 az = _mm_sub_ps(_mm_add_ps(fz, windZ), _mm_add_ps(_mm_mul_ps(stiffness, ddz), _mm_mul_ps(damping, vvz)));
+
+        // Semi-implicit Euler
+        vvx = _mm_add_ps(vvx, _mm_mul_ps(ax, dt));
+        vvy = _mm_add_ps(vvy, _mm_mul_ps(ay, dt));
+        vvz = _mm_add_ps(vvz, _mm_mul_ps(az, dt));
+
+        ddx = _mm_add_ps(ddx, _mm_mul_ps(vvx, dt));
+        ddy = _mm_add_ps(ddy, _mm_mul_ps(vvy, dt));
+        ddz = _mm_add_ps(ddz, _mm_mul_ps(vvz, dt));
+
+        // Don't bend into the skin
+        __m128 nnx = _mm_loadu_ps(nx + i), nny = _mm_loadu_ps(ny + i), nnz = _mm_loadu_ps(nz + i);
+        __m128 inward = _mm_min_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ddx, nnx), _mm_mul_ps(ddy, nny)), _mm_mul_ps(ddz, nnz)), zero);
+
+        ddx = _mm_sub_ps(ddx, _mm_mul_ps(inward, nnx));
+        ddy = _mm_sub_ps(ddy, _mm_mul_ps(inward, nny));
+        ddz = _mm_sub_ps(ddz, _mm_mul_ps(inward, nnz));
+
+        // And not further than the strand reaches
+        __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ddx, ddx), _mm_mul_ps(ddy, ddy)), _mm_mul_ps(ddz, ddz));
+        __m128 scale   = _mm_min_ps(one, _mm_div_ps(maxLength, _mm_sqrt_ps(_mm_add_ps(length2, epsilon))));
+
+        _mm_storeu_ps(dx + i, _mm_mul_ps(ddx, scale));
+        _mm_storeu_ps(dy + i, _mm_mul_ps(ddy, scale));
+        _mm_storeu_ps(dz + i, _mm_mul_ps(ddz, scale));
+
+        _mm_storeu_ps(vx + i, vvx);
+        _mm_storeu_ps(vy + i, vvy);
+        _mm_storeu_ps(vz + i, vvz);
+    }
+
+#else
+
+    for(unsigned int i = begin; i < end; i++) {
+
+        float x = px[i], y = py[i], z = pz[i];
+
+        float ddx = dx[i] - (c.inertia[0] * x + c.inertia[1] * y + c.inertia[2] * z);
+        float ddy = dy[i] - (c.inertia[3] * x + c.inertia[4] * y + c.inertia[5] * z);
+        float ddz = dz[i] - (c.inertia[6] * x + c.inertia[7] * y + c.inertia[8] * z);
+
+        float ax = c.force[0] + wx[i] - c.stiffness * ddx - c.damping * vx[i];
+        float ay = c.force[1] + wy[i] - c.stiffness * ddy - c.damping * vy[i];
+        float az = c.force[2] + wz[i] - c.stiffness * ddz - c.damping * vz[i];
+
+        vx[i] += ax * c.dt;
+        vy[i] += ay * c.dt;
+        vz[i] += az * c.dt;
+
+        ddx += vx[i] * c.dt;
+        ddy += vy[i] * c.dt;
+        ddz += vz[i] * c.dt;
+
+        float inward = std::min(ddx * nx[i] + ddy * ny[i] + ddz * nz[i], 0.0f);
+
+        ddx -= inward * nx[i];
+        ddy -= inward * ny[i];
+        ddz -= inward * nz[i];
+
+        float scale = std::min(1.0f, c.maxDisplacement / std::sqrt(ddx * ddx + ddy * ddy + ddz * ddz + 1e-12f));
+
+        dx[i] = ddx * scale;
+        dy[i] = ddy * scale;
+        dz[i] = ddz * scale;
+    }
+
+#endif
+
+    // Interleave this job's range for the upload
+    end = std::min(end, mVertexCount);
+
+    for(unsigned int i = begin; i < end; i++)
+        mOutput[i] = glm::vec3(dx[i], dy[i], dz[i]);
+}
+
+
+const std::vector<glm::vec3> &FurDynamics::gatherDisplacement() {
+
+    for(unsigned int i = 0; i < mVertexCount; i++)
+        mDisplacement[i] = glm::vec3(mDisplacementX[i], mDisplacementY[i], mDisplacementZ[i]);
+
+    return mDisplacement;
+}
@@ -0,0 +1,246 @@
+#include <algorithm>
+
+#include "../include/FurHeightMap.h"
+
+namespace {
+
+    // A texel counts for a triangle when its center is this close to it, in texels of the level
+    // looked at. Covers the texels the footprint only touches, and what linear filtering blends in.
+    const float FOOTPRINT_MARGIN = 2.0f;
+
+    // Triangles are rasterized on the finest level where their footprint is at most this many texels wide
+    const float FOOTPRINT_TEXELS = 16.0f;
+
+    // Everything the jobs that build the finest level read, and the texels they write
+    struct BuildContext {
+        const GLubyte *noise;
+        int            width;
+        int            height;
+        const GLubyte *hair;
+        int            hairWidth;
+        int            hairHeight;
+        GLubyte       *texels;
+    };
+
+    struct ClassifyContext {
+        const void         *map;
+        const glm::vec2    *uvs;
+        const unsigned int *indices;
+        unsigned char      *heights;
+    };
+
+
+    // Wraps like GL_REPEAT
+    int wrap(int i, int size) {
+
+        return ((i % size) + size) % size;
+    }
+}
+
+
+FurHeightMap::FurHeightMap() {
+
+}
+
+
+FurHeightMap::~FurHeightMap() {
+
+    glDeleteTextures(1, &textureID);
+}
+
+
+void FurHeightMap::initialize(WorkerPool &workers, const std::vector<GLubyte> &noise, int width, int height,
+                              const std::vector<GLubyte> &hairMap, int hairWidth, int hairHeight) {
+
+    mLevels.clear();
+
+    if(noise.empty() || width <= 0 || height <= 0)
+        return;
+
+    // The finest level matches the noise texture, the hair map is looked up over the same area
+    Level finest;
+    finest.width  = width;
+    finest.height = height;
+    finest.texels.assign(width * height, 0);
+
+    BuildContext context = {
+        &noise[0], width, height,
+        hairMap.empty() ? NULL : &hairMap[0], hairWidth, hairHeight,
+        &finest.texels[0]
+    };
+
+    workers.parallelFor(height, ROWS_PER_JOB, buildJob, &context);
+
+    mLevels.push_back(finest);
+
+    // Each coarser level keeps the largest of the texels it overlaps, with odd sizes that can be three in a row
+    while(mLevels.back().width > 1 || mLevels.back().height > 1) {
+
+        const Level &fine = mLevels.back();
+
+        Level coarse;
+        coarse.width  = std::max(fine.width / 2, 1);
+        coarse.height = std::max(fine.height / 2, 1);
+        coarse.texels.assign(coarse.width * coarse.height, 0);
+
+        for(int y = 0; y < coarse.height; y++) {
+            for(int x = 0; x < coarse.width; x++) {
+
+                int x0 = x * fine.width / coarse.width,   x1 = ((x + 1) * fine.width + coarse.width - 1) / coarse.width;
+                int y0 = y * fine.height / coarse.height, y1 = ((y + 1) * fine.height + coarse.height - 1) / coarse.height;
+
+                GLubyte &texel = coarse.texels[y * coarse.width + x];
+
+                for(int fy = y0; fy < y1; fy++) {
+                    for(int fx = x0; fx < x1; fx++)
+                        texel = std::max(texel, fine.texels[fy * fine.width + fx]);
+                }
+            }
+        }
+
+        mLevels.push_back(coarse);
+    }
+
+    // Nearest lookups, filtering would let the bound drop below the largest texel
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for(unsigned int l = 0; l < mLevels.size(); l++)
+        glTexImage2D(GL_TEXTURE_2D, l, GL_R8, mLevels[l].width, mLevels[l].height, 0, GL_RED, GL_UNSIGNED_BYTE, &mLevels[l].texels[0]);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(mLevels.size()) - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+void FurHeightMap::buildJob(unsigned int begin, unsigned int end, void *data) {
+
+    const BuildContext &context = *static_cast<BuildContext *>(data);
+
+    for(int y = static_cast<int>(begin); y < static_cast<int>(end); y++) {
+        for(int x = 0; x < context.width; x++) {
+
+            // Linear filtering anywhere in this texel reads its neighbours as well. The noise texture
+            // is BGRA, and the shader reads red.
+            GLubyte noise = 0;
+
+            for(int dy = -1; dy <= 1; dy++) {
+                for(int dx = -1; dx <= 1; dx++) {
+                    int i = wrap(y + dy, context.height) * context.width + wrap(x + dx, context.width);
+                    noise = std::max(noise, context.noise[i * 4 + 2]);
+                }
+            }
+
+            // The hair map texels under this one, plus a border for the filtering
+            bool hair = context.hair == NULL;
+
+            int x0 = x * context.hairWidth / context.width - 1,       x1 = (x + 1) * context.hairWidth / context.width + 1;
+            int y0 = y * context.hairHeight / context.height - 1,     y1 = (y + 1) * context.hairHeight / context.height + 1;
+
+            for(int hy = y0; hy <= y1 && !hair; hy++) {
+                for(int hx = x0; hx <= x1 && !hair; hx++)
+                    hair = context.hair[wrap(hy, context.hairHeight) * context.hairWidth + wrap(hx, context.hairWidth)] > 0;
+            }
+
+            // Fur with no noise still counts as fur, 0 is kept for the bald texels
+            context.texels[y * context.width + x] = hair ? std::max<GLubyte>(noise, 1) : 0;
+        }
+    }
+}
+
+
+void FurHeightMap::classify(WorkerPool &workers, const std::vector<glm::vec2> &uvs, const std::vector<unsigned int> &indices, std::vector<unsigned char> &heights) const {
+
+    unsigned int triangles = static_cast<unsigned int>(indices.size()) / 3;
+
+    heights.assign(triangles, 255);
+
+    if(mLevels.empty() || triangles == 0)
+        return;
+
+    ClassifyContext context = { this, &uvs[0], &indices[0], &heights[0] };
+
+    workers.parallelFor(triangles, TRIANGLES_PER_JOB, classifyJob, &context);
+}
+
+
+void FurHeightMap::classifyJob(unsigned int begin, unsigned int end, void *data) {
+
+    const ClassifyContext &context = *static_cast<ClassifyContext *>(data);
+    const FurHeightMap &map = *static_cast<const FurHeightMap *>(context.map);
+
+    for(unsigned int i = begin; i < end; i++) {
+
+        const unsigned int *t = &context.indices[i * 3];
+
+        context.heights[i] = map.footprintMax(context.uvs[t[0]], context.uvs[t[1]], context.uvs[t[2]]);
+    }
+}
+
+
+unsigned char FurHeightMap::footprintMax(const glm::vec2 &uv0, const glm::vec2 &uv1, const glm::vec2 &uv2) const {
+
+    glm::vec2 low  = glm::min(glm::min(uv0, uv1), uv2);
+    glm::vec2 high = glm::max(glm::max(uv0, uv1), uv2);
+
+    // The finest level where the footprint is small, coarser texels hold the largest value below them
+    unsigned int l = 0;
+
+    glm::vec2 extent = (high - low) * glm::vec2(static_cast<float>(mLevels[0].width), static_cast<float>(mLevels[0].height));
+
+    while(std::max(extent.x, extent.y) > FOOTPRINT_TEXELS && l + 1 < mLevels.size()) {
+        extent *= 0.5f;
+        l++;
+    }
+
+    const Level &level = mLevels[l];
+
+    glm::vec2 size(static_cast<float>(level.width), static_cast<float>(level.height));
+    glm::vec2 p[3] = { uv0 * size, uv1 * size, uv2 * size };
+
+    glm::vec2 first = glm::floor(low  * size - FOOTPRINT_MARGIN);
+    glm::vec2 last  = glm::floor(high * size + FOOTPRINT_MARGIN);
+
+    // Footprints that wrap around the texture more than once take the largest value of the whole level
+    if(last.x - first.x > 2.0f * size.x || last.y - first.y > 2.0f * size.y)
+        return mLevels.back().texels[0];
+
+    // Inward edge normals, scaled to give distances in texels. A triangle without area covers its box.
+    float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+
+    glm::vec2 normals[3];
+
+    for(int e = 0; e < 3; e++) {
+
+        glm::vec2 edge = p[(e + 1) % 3] - p[e];
+        float length   = glm::length(edge);
+
+        normals[e] = (area == 0.0f || length == 0.0f) ? glm::vec2(0.0f) : glm::vec2(-edge.y, edge.x) * ((area > 0.0f ? 1.0f : -1.0f) / length);
+    }
+
+    GLubyte result = 0;
+
+    for(int y = static_cast<int>(first.y); y <= static_cast<int>(last.y); y++) {
+        for(int x = static_cast<int>(first.x); x <= static_cast<int>(last.x); x++) {
+
+            glm::vec2 center(x + 0.5f, y + 0.5f);
+
+            bool inside = true;
+
+            for(int e = 0; e < 3 && inside; e++)
+                inside = glm::dot(center - p[e], normals[e]) >= -FOOTPRINT_MARGIN;
+
+            if(inside)
+                result = std::max(result, level.texels[wrap(y, level.height) * level.width + wrap(x, level.width)]);
+
+            if(result == 255)
+                return result;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "../include/FurUpsampler.h"
+
+namespace {
+
+    // Texture units of the composite pass
+    const GLuint FUR_COLOR_UNIT = 0;
+    const GLuint FUR_DEPTH_UNIT = 1;
+    const GLuint DEPTH_UNIT     = 2;
+}
+
+
+FurUpsampler::FurUpsampler() {
+
+}
+
+
+FurUpsampler::~FurUpsampler() {
+
+    glDeleteTextures(1, &depthTextureID);
+    glDeleteTextures(1, &furColorTextureID);
+    glDeleteTextures(1, &furDepthTextureID);
+    glDeleteFramebuffers(1, &depthFramebufferID);
+    glDeleteFramebuffers(1, &furFramebufferID);
+}
+
+
+void FurUpsampler::initialize(GLuint program) {
+
+    compositeProgram = program;
+
+    if(!compositeProgram)
+        return;
+
+    glUseProgram(compositeProgram);
+    glUniform1i(glGetUniformLocation(compositeProgram, "furColorSampler"), FUR_COLOR_UNIT);
+    glUniform1i(glGetUniformLocation(compositeProgram, "furDepthSampler"), FUR_DEPTH_UNIT);
+    glUniform1i(glGetUniformLocation(compositeProgram, "depthSampler"),    DEPTH_UNIT);
+
+    furScaleLoc       = glGetUniformLocation(compositeProgram, "furScale");
+    furSizeLoc        = glGetUniformLocation(compositeProgram, "furSize");
+    depthUnprojectLoc = glGetUniformLocation(compositeProgram, "depthUnproject");
+
+    mPass.initialize(WIDTH, HEIGHT);
+
+    glGenFramebuffers(1, &depthFramebufferID);
+    glGenFramebuffers(1, &furFramebufferID);
+    glGenTextures(1, &depthTextureID);
+    glGenTextures(1, &furColorTextureID);
+    glGenTextures(1, &furDepthTextureID);
+
+    if(!resize(WIDTH, HEIGHT))
+        compositeProgram = 0;
+}
+
+
+void FurUpsampler::begin(RenderState &state) {
+
+    // The skin depth is compared with the depth of each composited pixel, so it is at full resolution.
+    // The fur target is as large, lower resolutions use a corner of it. Resizing binds the textures
+    // directly, so the cache forgets its bindings.
+    if(mPass.begin()) {
+        resize(mPass.getWidth(), mPass.getHeight());
+        state.invalidateTextures();
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, depthFramebufferID);
+    glViewport(0, 0, mPass.getWidth(), mPass.getHeight());
+
+    state.depthMask(GL_TRUE);
+
+    const GLfloat depth = 1.0f;
+    glClearBufferfv(GL_DEPTH, 0, &depth);
+}
+
+
+void FurUpsampler::accumulate(RenderState &state, float scale) {
+
+    mScale     = scale;
+    mFurWidth  = std::max(static_cast<int>(mPass.getWidth()  * scale), 1);
+    mFurHeight = std::max(static_cast<int>(mPass.getHeight() * scale), 1);
+
+    // Point sampled, a depth blit can't filter. Averaged depths would hide fur that should show.
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, depthFramebufferID);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, furFramebufferID);
+    glBlitFramebuffer(0, 0, mPass.getWidth(), mPass.getHeight(), 0, 0, mFurWidth, mFurHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, furFramebufferID);
+    glViewport(0, 0, mFurWidth, mFurHeight);
+
+    state.colorMask(GL_TRUE);
+
+    const GLfloat transparent[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, transparent);
+
+    // The shells only test against the skins, the upsample compares skin depths
+    state.depthMask(GL_FALSE);
+    state.enable(GL_DEPTH_TEST);
+    state.enable(GL_BLEND);
+
+    // Over a transparent target: the color comes out premultiplied and the alpha is the coverage
+    state.blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+
+void FurUpsampler::composite(RenderState &state, const glm::mat4 &projection) {
+
+    mPass.end();
+
+    state.depthMask(GL_TRUE);
+    state.disable(GL_DEPTH_TEST);
+    state.disable(GL_CULL_FACE);
+    state.enable(GL_BLEND);
+    state.blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    state.useProgram(compositeProgram);
+    state.bindTexture(FUR_COLOR_UNIT, GL_TEXTURE_2D, furColorTextureID);
+    state.bindTexture(FUR_DEPTH_UNIT, GL_TEXTURE_2D, furDepthTextureID);
+    state.bindTexture(DEPTH_UNIT,     GL_TEXTURE_2D, depthTextureID);
+
+    // Depth to view distance: distance = P[3][2] / (ndc + P[2][2])
+    glUniform1f(furScaleLoc, mScale);
+    glUniform2i(furSizeLoc, mFurWidth, mFurHeight);
+    glUniform2f(depthUnprojectLoc, projection[2][2], projection[3][2]);
+
+    mPass.draw(state);
+
+    // The fur came out premultiplied, only the composite blends with GL_ONE. Everything drawn after it,
+    // the tweak bar included, expects straight alpha and the depth test on.
+    state.enable(GL_DEPTH_TEST);
+    state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+
+bool FurUpsampler::resize(int width, int height) {
+
+    glBindTexture(GL_TEXTURE_2D, depthTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindTexture(GL_TEXTURE_2D, furColorTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindTexture(GL_TEXTURE_2D, furDepthTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Depth only, nothing to draw or read in color
+    glBindFramebuffer(GL_FRAMEBUFFER, depthFramebufferID);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextureID, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    GLenum depthStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, furFramebufferID);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, furColorTextureID, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_TEXTURE_2D, furDepthTextureID, 0);
+
+    GLenum furStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if(depthStatus != GL_FRAMEBUFFER_COMPLETE || furStatus != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Fur framebuffers incomplete, status: 0x%x 0x%x\n", depthStatus, furStatus);
+        return false;
+    }
+
+    return true;
+}
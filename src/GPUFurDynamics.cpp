@@ -0,0 +1,132 @@
+#include "../include/GPUFurDynamics.h"
+
+GPUFurDynamics::GPUFurDynamics() {
+
+}
+
+
+GPUFurDynamics::~GPUFurDynamics() {
+
+    glDeleteBuffers(2, displacementBuffers);
+    glDeleteBuffers(2, velocityBuffers);
+    glDeleteBuffers(1, &windWeightBuffer);
+    glDeleteVertexArrays(2, vertexArrays);
+}
+
+
+void GPUFurDynamics::initialize(GLuint program, GLuint vertexBuffer, GLuint normalBuffer, const std::vector<float> &windWeights, unsigned int vertexCount) {
+
+    shaderProgram = program;
+    mVertexCount  = vertexCount;
+
+    if(!shaderProgram || mVertexCount == 0)
+        return;
+
+    // Bind shader variables (uniforms) to indices
+    dtLoc        = glGetUniformLocation(shaderProgram, "dt");
+    stiffnessLoc = glGetUniformLocation(shaderProgram, "stiffness");
+    dampingLoc   = glGetUniformLocation(shaderProgram, "damping");
+    gravityLoc   = glGetUniformLocation(shaderProgram, "gravity");
+    toWorldLoc    = glGetUniformLocation(shaderProgram, "toWorld");
+    windOriginLoc = glGetUniformLocation(shaderProgram, "windOrigin");
+    windScaleLoc  = glGetUniformLocation(shaderProgram, "windScale");
+    inertiaLoc   = glGetUniformLocation(shaderProgram, "inertia");
+
+    glUseProgram(shaderProgram);
+    glUniform1f(glGetUniformLocation(shaderProgram, "maxDisplacement"), FurDynamics::MAX_DISPLACEMENT);
+    glUniform1i(glGetUniformLocation(shaderProgram, "windFieldSampler"), WIND_TEXTURE_UNIT);
+
+    // Both pairs start at rest
+    std::vector<glm::vec3> rest(mVertexCount, glm::vec3(0.0f));
+
+    glGenBuffers(2, displacementBuffers);
+    glGenBuffers(2, velocityBuffers);
+
+    for(unsigned int i = 0; i < 2; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, displacementBuffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, mVertexCount * sizeof(glm::vec3), &rest[0], GL_DYNAMIC_COPY);
+
+        glBindBuffer(GL_ARRAY_BUFFER, velocityBuffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, mVertexCount * sizeof(glm::vec3), &rest[0], GL_DYNAMIC_COPY);
+    }
+
+    glGenBuffers(1, &windWeightBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, windWeightBuffer);
+    glBufferData(GL_ARRAY_BUFFER, mVertexCount * sizeof(float), &windWeights[0], GL_STATIC_DRAW);
+
+    // One vertex array per pair, with the rest pose shared with the geometry
+    glGenVertexArrays(2, vertexArrays);
+
+    for(unsigned int i = 0; i < 2; i++) {
+
+        glBindVertexArray(vertexArrays[i]);
+
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void*>(0));
+
+        glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void*>(0));
+
+        glBindBuffer(GL_ARRAY_BUFFER, displacementBuffers[i]);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void*>(0));
+
+        glBindBuffer(GL_ARRAY_BUFFER, velocityBuffers[i]);
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void*>(0));
+
+        glBindBuffer(GL_ARRAY_BUFFER, windWeightBuffer);
+        glEnableVertexAttribArray(5);
+        glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void*>(0));
+    }
+
+    glBindVertexArray(0);
+}
+
+
+void GPUFurDynamics::step(RenderState &state, float dt, const glm::quat &orientation, WindField &windField, const FurParameters &parameters) {
+
+    mForces.update(dt, orientation, parameters.furLength);
+
+    if(mForces.dt <= 0.0f || !shaderProgram || mVertexCount == 0)
+        return;
+
+    unsigned int next = 1 - mCurrent;
+
+    state.useProgram(shaderProgram);
+
+    glUniform1f(       dtLoc,        mForces.dt);
+    glUniform1f(       stiffnessLoc, parameters.furStiffness);
+    glUniform1f(       dampingLoc,   parameters.furDamping);
+    glUniform3f(       gravityLoc,   mForces.gravity[0], mForces.gravity[1], mForces.gravity[2]);
+    glUniformMatrix3fv(inertiaLoc,   1,                  GL_FALSE,           &mForces.inertia[0][0]);
+    glUniformMatrix3fv(toWorldLoc,   1,                  GL_FALSE,           &mForces.toWorld[0][0]);
+
+    glm::vec3 origin = windField.getOrigin();
+
+    glUniform3f(       windOriginLoc, origin[0], origin[1], origin[2]);
+    glUniform1f(       windScaleLoc,  windField.getScale());
+
+    state.bindTexture(WIND_TEXTURE_UNIT, GL_TEXTURE_3D, windField.getTexture());
+
+    // Read the current pair, capture into the other one, nothing gets rasterized
+    state.bindVertexArray(vertexArrays[mCurrent]);
+    state.enable(GL_RASTERIZER_DISCARD);
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, displacementBuffers[next]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, velocityBuffers[next]);
+
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, mVertexCount);
+    glEndTransformFeedback();
+
+    // The buffers are read as vertex attributes next, they can't stay bound for capture
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, 0);
+
+    state.disable(GL_RASTERIZER_DISCARD);
+
+    mCurrent = next;
+}
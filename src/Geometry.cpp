@@ -1,9 +1,74 @@
+#include <limits>
+
 #include "../include/Geometry.h"
 
+namespace {
+
+    // Shell LOD: one shell per pixel of projected fur length, and never fewer than MIN_SHELLS.
+    // Shells closer together than a pixel add nothing but cost.
+    const float PIXELS_PER_SHELL = 1.0f;
+
+    // The gaps between the shells show most at grazing angles, which the fins cover when they are on
+    const float PIXELS_PER_SHELL_WITH_FINS = 1.5f;
+
+    const unsigned int MIN_SHELLS = 2;
+
+    // Mesh LOD: each level has half the triangles of the one before, down to MIN_LOD_TRIANGLES.
+    // A level is good enough once it has a triangle per PIXELS_PER_TRIANGLE of the object on screen.
+    const float LOD_RATIO = 0.5f;
+
+    const unsigned int MIN_LOD_TRIANGLES = 64;
+
+    const float PIXELS_PER_TRIANGLE = 4.0f;
+
+    // The outer half of the shells is mostly transparent, it only needs this fraction of the triangles
+    const float OUTER_SHELL_DETAIL = 0.5f;
+
+    // Tessellated shells start from this level of detail, and refine edges down to TESS_EDGE_PIXELS on screen
+    const unsigned int TESSELLATION_BASE_LOD = 2;
+
+    const float TESS_EDGE_PIXELS = 8.0f;
+
+    const float MAX_TESS_LEVEL = 16.0f;
+
+    // Side view of the strands on the fins, one strand per column
+    const int FIN_TEXTURE_WIDTH  = 128;
+
+    const int FIN_TEXTURE_HEIGHT = 64;
+
+    const float FIN_STRAND_DENSITY = 0.6f;
+
+    // The antialiased threshold in the fur shader reaches below the height by a fraction of the noise
+    // gradient. Shells are only skipped this far above the height, the shader gets it in the fur block.
+    const float HEIGHT_MARGIN = 0.1f;
+
+    // Values of the height map, 0 is no fur
+    const unsigned int HEIGHT_VALUES = 256;
+
+    // Triangles per meshlet, small enough to cull well and large enough to keep the draw commands few
+    const unsigned int MESHLET_TRIANGLES = 64;
+
+    // Instances are grouped by halving projected scale, starting from where the shells stop getting fewer.
+    // A group draws with the detail of its nearest instance, so at most twice the shells the others need.
+    const float INSTANCE_BATCH_RATIO = 2.0f;
+
+    unsigned int instanceBatch(float scale, float fullScale, unsigned int batches) {
+
+        unsigned int b = 0;
+
+        for(float limit = fullScale / INSTANCE_BATCH_RATIO; scale < limit && b < batches - 1; limit /= INSTANCE_BATCH_RATIO)
+            b++;
+
+        return b;
+    }
+}
+
+
 Geometry::Geometry(std::vector<std::string> S, glm::vec3 c, unsigned int n, float l, bool r)
-    : mNumberOfLayers(n), mFurLength(l), mShallRender(r) {
+    : mNumberOfLayers(n), mShallRender(r), mFinQuery(GL_PRIMITIVES_GENERATED) {
 
-    mMaterial.color = c;
+    mParameters.color     = c;
+    mParameters.furLength = l;
 
     mTextureName = S[I_TEXTURE];
     mHairMapName = S[I_HAIRMAP];
@@ -20,7 +85,12 @@ Geometry::~Geometry() {
     glDeleteBuffers(1, &vertexBuffer);
     glDeleteBuffers(1, &uvBuffer);
     glDeleteBuffers(1, &normalBuffer);
-    glDeleteProgram(shaderProgram);
+    glDeleteBuffers(1, &displacementBuffer);
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteBuffers(1, &materialBuffer);
+    glDeleteBuffers(1, &furBuffer);
+    glDeleteTextures(1, &finTextureID);
     glDeleteVertexArrays(1, &vertexArrayID);
 
     for(unsigned int i = 0; i < mFurLayers.size(); i++) {
@@ -32,46 +102,85 @@ Geometry::~Geometry() {
 }
 
 
-void Geometry::initialize(glm::vec3 lightPosition) {
+void Geometry::initialize(glm::vec3 lightPosition, WorkerPool &workers, TextureArrayManager &textures) {
 
-    // Generate fur noise texture
-    generateNoiseTexture();
+    // Generate fur noise texture, the textures all go into layers of the shared arrays
+    generateNoiseTexture(textures);
 
     // Generate skin texture
     std::string skinTexturename = PATH_TEX + mTextureName + FILE_NAME_PNG;
     int skinTextureHeight, skinTextureWidth;
-    skinTextureID = loadTexture(skinTexturename, skinTextureWidth, skinTextureHeight);
+    mSkinTexture = loadTexture(textures, skinTexturename, skinTextureWidth, skinTextureHeight);
 
     std::string hairMapTexturename = PATH_TEX + mHairMapName + FILE_NAME_PNG;
     int hairMapHeight, hairMapWidth;
-    hairMapID = loadTexture(hairMapTexturename, hairMapWidth, hairMapHeight);
+    std::vector<GLubyte> hairMap;
+    mHairMap = loadTexture(textures, hairMapTexturename, hairMapWidth, hairMapHeight, &hairMap);
+
+    // How high the fur can get anywhere, the meshlets are sorted by it before the indices go to the GPU
+    mHeightMap.initialize(workers, mTextureData, mTextureWidth, mTextureHeight, hairMap, hairMapWidth, hairMapHeight);
+
+    // Largest value under every triangle of every level at once, the levels share the vertices and their UVs
+    std::vector<unsigned char> heights;
+    mHeightMap.classify(workers, mRenderUvs, mIndices, heights);
+
+    // The bald triangles go to the end of each level, the fur before them is cut into meshlets
+    cullBaldTriangles(heights);
+
+    buildMeshlets(heights);
+
+    // Without a culling program the shells draw the same meshlet order as plain ranges
+    mCuller.initialize(cullShaderProgram, mMeshlets);
 
     // Then create fur layers since they use the render data from the geometry
     createFurLayers();
 
-    mMaterial.furColor = mFurLayers.front()->getColor();
-
     glGenVertexArrays(1, &vertexArrayID);
     glBindVertexArray(vertexArrayID);
 
 
-    // Bind shader variables (uniforms) to indices
-    MVPLoc          = glGetUniformLocation(shaderProgram, "MVP");
-    MLoc            = glGetUniformLocation(shaderProgram, "M");
-    VLoc            = glGetUniformLocation(shaderProgram, "V");
+    // Bind shader variables (uniforms) to indices, per frame data comes from the Frame block the scene binds
     lightPosLoc     = glGetUniformLocation(shaderProgram, "lightPosition");
-    cameraPosLoc    = glGetUniformLocation(shaderProgram, "cameraPosition");
-    colorLoc        = glGetUniformLocation(shaderProgram, "color");
-    ambientLoc      = glGetUniformLocation(shaderProgram, "ambientColor");
-    diffuseLoc      = glGetUniformLocation(shaderProgram, "diffuseColor");
-    specularLoc     = glGetUniformLocation(shaderProgram, "specularColor");
-    transparencyLoc = glGetUniformLocation(shaderProgram, "transparency");
-    specularityLoc  = glGetUniformLocation(shaderProgram, "specularity");
-    shinynessLoc    = glGetUniformLocation(shaderProgram, "shinyness");
-    lightPowerLoc   = glGetUniformLocation(shaderProgram, "lightPower");
     skinTextureLoc  = glGetUniformLocation(shaderProgram, "skinTextureSampler");
 
+    glUseProgram(shaderProgram);
     glUniform3f(lightPosLoc,  lightPosition[0],  lightPosition[1],  lightPosition[2]);
+    glUniform1i(skinTextureLoc, 0);
+    glUniformBlockBinding(shaderProgram, glGetUniformBlockIndex(shaderProgram, "Material"), UBO_MATERIAL);
+    glUniformBlockBinding(shaderProgram, glGetUniformBlockIndex(shaderProgram, "Frame"),    UBO_FRAME);
+
+    // Fur uniforms that never change, the layers set what differs per shell
+    setupFurProgram(furShaderProgram, lightPosition);
+    shellAlphaExponentLoc = glGetUniformLocation(furShaderProgram, "shellAlphaExponent");
+
+    // The tessellated shells share the fragment shader, and refine against the window size
+    if(tessellatedFurShaderProgram) {
+
+        setupFurProgram(tessellatedFurShaderProgram, lightPosition);
+        tessellatedShellAlphaExponentLoc = glGetUniformLocation(tessellatedFurShaderProgram, "shellAlphaExponent");
+
+        glUniform2f(glGetUniformLocation(tessellatedFurShaderProgram, "viewportSize"),   static_cast<float>(WIDTH), static_cast<float>(HEIGHT));
+        glUniform1f(glGetUniformLocation(tessellatedFurShaderProgram, "tessEdgePixels"), TESS_EDGE_PIXELS);
+        glUniform1f(glGetUniformLocation(tessellatedFurShaderProgram, "maxTessLevel"),   MAX_TESS_LEVEL);
+    }
+
+    // The fins are lit like the shells, and have their own strand texture
+    if(finShaderProgram) {
+
+        setupFurProgram(finShaderProgram, lightPosition);
+        glUniform1i(glGetUniformLocation(finShaderProgram, "finSampler"), FIN_TEXTURE_UNIT);
+
+        generateFinTexture();
+    }
+
+    // Uniform blocks for the parameters, filled in by applyParameters() whenever they change
+    glGenBuffers(1, &materialBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(MaterialBlock), NULL, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &furBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, furBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FurBlock), NULL, GL_DYNAMIC_DRAW);
 
 
     glGenBuffers(1, &vertexBuffer);
@@ -118,117 +227,833 @@ void Geometry::initialize(glm::vec3 lightPosition) {
         reinterpret_cast<void*>(0)      // array buffer offset, 0
     );
 
+
+    // All levels of detail in one index buffer, the vertex array remembers it
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * sizeof(GLuint), &mIndices[0], GL_STATIC_DRAW);
+
+    // Edge adjacency for the fins, on the full mesh since the silhouette is where the detail shows
+    if(finShaderProgram && !mLODs.empty()) {
+        mFins.initialize(mRenderVerts, mIndices, mLODs[0].first, mLODs[0].count);
+        mFinQuery.initialize();
+    }
+
+
+    // Displacement of the fur tips, rewritten by updateFur() every frame
+    mDynamics.initialize(mRenderVerts, mRenderNormals);
+
+    glGenBuffers(1, &displacementBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, displacementBuffer);
+    glBufferData(GL_ARRAY_BUFFER, mRenderVerts.size() * sizeof(glm::vec3), &mDynamics.getDisplacement()[0], GL_STREAM_DRAW);
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(
+        3,                              // shader layout, in this case 3
+        3,                              // size, 3 for a vec3
+        GL_FLOAT,                       // type, float for vec3's
+        GL_FALSE,                       // normalized, no
+        0,                              // stride, 0
+        reinterpret_cast<void*>(0)      // array buffer offset, 0
+    );
+
+    mBoundDisplacement = displacementBuffer;
+
+
+    // One transform, tint and seed per instance, see FurInstance.h. All of them stay in this buffer,
+    // the ones drawn in a frame are streamed by cullInstances().
+    glGenBuffers(1, &instanceBuffer);
+
+    for(unsigned int i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(INSTANCE_TRANSFORM_ATTRIBUTE + i);
+        glVertexAttribDivisor(INSTANCE_TRANSFORM_ATTRIBUTE + i, 1);
+    }
+
+    glEnableVertexAttribArray(INSTANCE_TINT_SEED_ATTRIBUTE);
+    glVertexAttribDivisor(INSTANCE_TINT_SEED_ATTRIBUTE, 1);
+
+    uploadInstances();
+    bindInstances(instanceBuffer, 0);
+
+    // The GPU dynamics keep their own state, and read the rest pose from our buffers
+    mGPUDynamics.initialize(dynamicsShaderProgram, vertexBuffer, normalBuffer, mDynamics.getWindWeights(), mRenderVerts.size());
+
     for(std::vector<Layer *>::iterator it = mFurLayers.begin(); it != mFurLayers.end(); ++it) {
         (*it)->setShaderProgram(furShaderProgram);
-        (*it)->initialize(lightPosition);
+        (*it)->setTessellatedShaderProgram(tessellatedFurShaderProgram);
+        (*it)->initialize();
     }
 
+    applyParameters();
+
     std::cout << "\nGeometry initialized!\n";
 }
 
 
-void Geometry::render(std::vector<glm::mat4> matrices, float lightSourcePower, float windVelocity, glm::vec3 cameraPosition) {
+void Geometry::submit(RenderQueue &queue, const FrameData &frame) {
 
-    glEnable( GL_CULL_FACE );
-    glEnable(GL_DEPTH_TEST);
+    // Distance along the view direction to the center, with instances the center of all of them
+    glm::vec4 center = frame.matrices[I_V] * frame.matrices[I_M] * glm::vec4(mFieldCenter, 1.0f);
+    float depth      = -center.z;
 
-    glUseProgram(shaderProgram);
+    // What each half binds first, as in renderSkin() and renderShells()
+    bool tessellated = frame.furPath == TESSELLATED_SHELLS && tessellatedFurShaderProgram;
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, skinTextureID);
-    glUniform1i(skinTextureLoc, 0);
+    queue.submit(SKIN_PASS, shaderProgram, mSkinTexture.texture, vertexArrayID, depth, this);
+    queue.submit(FUR_PASS, tessellated ? tessellatedFurShaderProgram : furShaderProgram, mNoiseTexture.texture, vertexArrayID, depth, this);
+}
 
-    // Pass data to shaders as uniforms
-    glUniformMatrix4fv(MVPLoc,          1,                       GL_FALSE,              &matrices[I_MVP][0][0]);
-    glUniformMatrix4fv(MLoc,            1,                       GL_FALSE,              &matrices[I_M][0][0]);
-    glUniformMatrix4fv(VLoc,            1,                       GL_FALSE,              &matrices[I_V][0][0]);
-    glUniform3f(       cameraPosLoc,    cameraPosition[0],       cameraPosition[1],     cameraPosition[2]);
-    glUniform3f(       colorLoc,        mMaterial.color[0],      mMaterial.color[1],    mMaterial.color[2]);
-    glUniform3f(       ambientLoc,      mMaterial.ambient[0],    mMaterial.ambient[1],  mMaterial.ambient[2]);
-    glUniform3f(       diffuseLoc,      mMaterial.diffuse[0],    mMaterial.diffuse[1],  mMaterial.diffuse[2]);
-    glUniform3f(       specularLoc,     mMaterial.specular[0],   mMaterial.specular[1], mMaterial.specular[2]);
-    glUniform1f(       transparencyLoc, mMaterial.transparency);
-    glUniform1f(       specularityLoc,  mMaterial.specularity);
-    glUniform1f(       shinynessLoc,    mMaterial.shinyness);
-    glUniform1f(       lightPowerLoc,   lightSourcePower);
-
-    // Rebind vertex, uv, and normal data, since everything is updated every frame
-    glBindVertexArray(vertexArrayID);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, mRenderVerts.size()   * sizeof(glm::vec3), &mRenderVerts[0],   GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ARRAY_BUFFER, uvBuffer);
-    glBufferData(GL_ARRAY_BUFFER, mRenderUvs.size()     * sizeof(glm::vec2), &mRenderUvs[0],     GL_STATIC_DRAW);
+void Geometry::renderSkin(RenderState &state, const FrameData &frame) {
 
-    glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-    glBufferData(GL_ARRAY_BUFFER, mRenderNormals.size() * sizeof(glm::vec3), &mRenderNormals[0], GL_STATIC_DRAW);
+    state.enable(GL_CULL_FACE);
+    state.enable(GL_DEPTH_TEST);
+
+    state.useProgram(shaderProgram);
+    state.bindTexture(0, GL_TEXTURE_2D_ARRAY, mSkinTexture.texture);
+    state.bindUniformBuffer(UBO_MATERIAL, materialBuffer);
+
+    // The vertex data is static and was uploaded in initialize(), the vertex array remembers the attribute setup
+    state.bindVertexArray(vertexArrayID);
+
+    mTrianglesDrawn = 0;
+
+    // Nearest batch first, then early-Z rejects what is behind it. Each picks the detail from how large
+    // its nearest instance is on screen.
+    for(unsigned int b = 0; b < mBatchCount; b++) {
+
+        const InstanceBatch &batch = mBatches[b];
+
+        unsigned int lod = selectMeshLOD(frame, batch.scale, 1.0f);
+
+        bindInstances(mInstanceSource, mInstanceSourceOffset + batch.first * sizeof(FurInstance));
+
+        glDrawElementsInstanced(GL_TRIANGLES, mLODs[lod].count, GL_UNSIGNED_INT, reinterpret_cast<void*>(mLODs[lod].first * sizeof(GLuint)), batch.count);
+
+        mTrianglesDrawn += mLODs[lod].count / 3 * batch.count;
+    }
+}
+
+
+void Geometry::renderShells(RenderState &state, const FrameData &frame) {
+
+    mShellsDrawn = 0;
+    mFinsDrawn   = 0;
+
+    // The nearest batch has the most shells, if not even it has any there is nothing to set up
+    if(mBatchCount == 0 || selectShellCount(frame, mBatches[0].scale) == 0)
+        return;
+
+    // One dispatch for the meshlets of every level, before the fur program is bound. The culling
+    // is in the space of the mesh, so only for a geometry without instances.
+    bool culled = frame.meshletCulling && mCuller.isAvailable() && !mInstanced;
+
+    if(culled) {
+
+        glm::vec4 eye = glm::inverse(frame.matrices[I_V] * frame.matrices[I_M]) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+        mCuller.cull(state, Frustum(frame.matrices[I_MVP]), glm::vec3(eye),
+                     mParameters.furLength * (1.0f + FurDynamics::MAX_DISPLACEMENT));
+    }
+
+    state.enable(GL_CULL_FACE);
+    state.bindVertexArray(vertexArrayID);
 
-    // Draw the polygons
-    glDrawArrays(GL_TRIANGLES, 0, mRenderVerts.size());
+    if(culled)
+        mCuller.bind();
 
-    // Unbind
-    glBindVertexArray(0);
+    bool tessellated = frame.furPath == TESSELLATED_SHELLS && tessellatedFurShaderProgram;
+
+    state.useProgram(tessellated ? tessellatedFurShaderProgram : furShaderProgram);
+
+    // Samplers were assigned to these units in initialize(), the layers are in the fur block
+    state.bindTexture(1, GL_TEXTURE_2D_ARRAY, mNoiseTexture.texture);
+    state.bindTexture(2, GL_TEXTURE_2D_ARRAY, mHairMap.texture);
+    state.bindTexture(MAX_HEIGHT_TEXTURE_UNIT, GL_TEXTURE_2D, mHeightMap.getTexture());
+    state.bindUniformBuffer(UBO_FUR, furBuffer);
+
+    // With alpha to coverage the shells write depth per covered sample and don't blend, so the order
+    // doesn't matter for the result. Outermost first, then early-Z rejects what is hidden under fur.
+    bool coverage = frame.shellBlending == ALPHA_TO_COVERAGE_SHELLS;
+
+    if(coverage) {
+        state.disable(GL_BLEND);
+        state.enable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+    }
+
+    // Blended shells go over what is behind them, so the farthest batch first. Covered ones nearest first.
+    for(unsigned int b = 0; b < mBatchCount; b++) {
+
+        const InstanceBatch &batch = mBatches[coverage ? b : mBatchCount - 1 - b];
+
+        unsigned int shells   = selectShellCount(frame, batch.scale);
+        unsigned int lod      = selectMeshLOD(frame, batch.scale, 1.0f);
+        unsigned int outerLOD = selectMeshLOD(frame, batch.scale, OUTER_SHELL_DETAIL);
+
+        // Tessellation does its own refinement, all shells start from the same coarse patches
+        if(tessellated)
+            lod = outerLOD = std::min(TESSELLATION_BASE_LOD, static_cast<unsigned int>(mLODs.size()) - 1);
+
+        // Fewer shells have to be more opaque each, so that the stack lets through as much light as all of them would
+        glUniform1f(tessellated ? tessellatedShellAlphaExponentLoc : shellAlphaExponentLoc,
+                    static_cast<float>(mNumberOfLayers) / static_cast<float>(shells));
+
+        bindInstances(mInstanceSource, mInstanceSourceOffset + batch.first * sizeof(FurInstance));
+
+        // All shells share the vertex array of the geometry, and the uniform blocks.
+        // The drawn shells are spread evenly over the full stack and always include the outermost one,
+        // they keep their own offset and index, so the fur length and the alpha thresholds stay the same.
+        for(unsigned int n = 1; n <= shells; n++) {
+
+            unsigned int i = coverage ? shells + 1 - n : n;
+
+            unsigned int level = 2 * i > shells ? outerLOD : lod;
+            unsigned int layer = i * mNumberOfLayers / shells - 1;
+
+            // Only the meshlets whose fur can reach this shell, none above the highest fur
+            unsigned int height = shellHeight(frame, layer, shells);
+
+            if(height >= HEIGHT_VALUES || mTrianglesAbove[level * HEIGHT_VALUES + height] == 0)
+                continue;
+
+            // With the culling the count is an upper bound, the meshlets culled on the GPU draw nothing
+            if(culled) {
+                mFurLayers[layer]->renderIndirect(state, frame, mLODMeshlets[level], mMeshletsAbove[level * HEIGHT_VALUES + height]);
+            }
+            else {
+                MeshLOD shellLOD = mFurLODs[level];
+                shellLOD.count   = mTrianglesAbove[level * HEIGHT_VALUES + height] * 3;
+
+                mFurLayers[layer]->render(state, frame, shellLOD, batch.count);
+            }
+
+            mTrianglesDrawn += mTrianglesAbove[level * HEIGHT_VALUES + height] * batch.count;
+        }
+
+        // The counters show the nearest instances, they have the most shells
+        mShellsDrawn = std::max(mShellsDrawn, shells);
+    }
+
+    // Blended or covered like the shells, over them so they are sorted far enough for blending
+    if(finsEnabled(frame))
+        renderFins(state);
+
+    if(coverage) {
+        state.disable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+        state.enable(GL_BLEND);
+    }
+}
+
+
+void Geometry::renderFins(RenderState &state) {
+
+    unsigned int edges = mFins.getFinCount();
+
+    if(edges == 0)
+        return;
+
+    // Fins are seen from both sides
+    state.disable(GL_CULL_FACE);
+    state.useProgram(finShaderProgram);
+    state.bindTexture(FIN_TEXTURE_UNIT, GL_TEXTURE_2D, finTextureID);
+
+    // The silhouette edges index the same vertices, the vertex array takes their index buffer for the draw
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mFins.getIndexBuffer());
+
+    mFinQuery.begin();
+    glDrawElements(GL_LINES, edges * 2, GL_UNSIGNED_INT, reinterpret_cast<void*>(0));
+    mFinQuery.end();
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+    // Only the edges seen edge on become fins, two triangles each
+    GLuint64 triangles = mFinQuery.getResult();
+
+    mFinsDrawn       = static_cast<unsigned int>(triangles / 2);
+    mTrianglesDrawn += static_cast<unsigned int>(triangles);
+
+    state.enable(GL_CULL_FACE);
+}
+
+
+bool Geometry::isVisible(const Frustum &frustum) {
+
+    // The tips can be pushed out beyond the fur length by the dynamics, and the instances scale that too
+    float reach = mParameters.furLength * (1.0f + FurDynamics::MAX_DISPLACEMENT) * mInstanceScale;
+
+    // The sphere rejects most of what is far off, the box is tighter around long or flat meshes
+    if(!frustum.intersectsSphere(mFieldCenter, mFieldRadius + reach))
+        return false;
+
+    return frustum.intersectsBox(mFieldLow - glm::vec3(reach), mFieldHigh + glm::vec3(reach));
+}
+
+
+void Geometry::setInstances(const std::vector<FurInstance> &instances) {
+
+    // Without any the geometry is drawn once, where the scene's model matrix puts it
+    mInstanced = !instances.empty();
+    mInstances = mInstanced ? instances : std::vector<FurInstance>(1);
+
+    // Filled in every frame by cullInstances(), sized here so that the frames don't allocate
+    mInstanceSizes.resize(mInstances.size());
+    mInstanceScales.resize(mInstances.size());
+
+    updateFieldBounds();
+
+    if(instanceBuffer)
+        uploadInstances();
+}
+
+
+void Geometry::uploadInstances() {
+
+    // Only changes when the instances are set, a new store lets the GPU keep drawing from the old one
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, mInstances.size() * sizeof(FurInstance), &mInstances[0], GL_STATIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(2);
 
+    // Until the first cull, all of them from here
+    mInstanceSource       = instanceBuffer;
+    mInstanceSourceOffset = 0;
+
+    mBatches[0].first = 0;
+    mBatches[0].count = mInstances.size();
+    mBatches[0].scale = std::numeric_limits<float>::max();
+
+    mBatchCount     = 1;
+    mInstancesDrawn = mInstances.size();
+}
+
+
+void Geometry::bindInstances(GLuint buffer, GLintptr offset) {
+
+    if(buffer == mBoundInstances && offset == mBoundInstancesOffset)
+        return;
+
+    // GL 3.3 has no base instance, each batch points the instance attributes of the bound vertex array at its data
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    for(unsigned int i = 0; i < 4; i++)
+        glVertexAttribPointer(INSTANCE_TRANSFORM_ATTRIBUTE + i, 4, GL_FLOAT, GL_FALSE, sizeof(FurInstance),
+                              reinterpret_cast<void*>(offset + i * sizeof(glm::vec4)));
+
+    glVertexAttribPointer(INSTANCE_TINT_SEED_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(FurInstance),
+                          reinterpret_cast<void*>(offset + offsetof(FurInstance, tint)));
+
+    mBoundInstances       = buffer;
+    mBoundInstancesOffset = offset;
+}
+
+
+unsigned int Geometry::cullInstances(const Frustum &frustum, const FrameData &frame, StreamBuffer &stream) {
+
+    // As in isVisible(), the dynamics can push the tips beyond the fur length
+    float reach   = mParameters.furLength * (1.0f + FurDynamics::MAX_DISPLACEMENT);
+    float nearest = 0.0f;
+
+    glm::mat4 modelView = frame.matrices[I_V] * frame.matrices[I_M];
+
+    unsigned int visible = 0;
+
+    for(unsigned int i = 0; i < mInstances.size(); i++) {
+
+        float size = mInstanceSizes[i];
 
-    GLint noiseLoc = mFurLayers.front()->getNoiseTextureLoc();
-    GLint hairLoc  = mFurLayers.front()->getHairMapLoc();
-    GLint noiseID  = mFurLayers.front()->getNoiseTextureID();
-    GLint hairID   = mFurLayers.front()->getHairMapID();
+        glm::vec3 center = glm::vec3(mInstances[i].transform * glm::vec4(mBoundingCenter, 1.0f));
 
-    if(mFurLayers.size() > 0) {
+        if(!frustum.intersectsSphere(center, (mBoundingRadius + reach) * size)) {
+            mInstanceScales[i] = 0.0f;
+            continue;
+        }
+
+        mInstanceScales[i] = projectedScale(frame, modelView, center, (mBoundingRadius + mParameters.furLength) * size, size);
+
+        nearest = std::max(nearest, mInstanceScales[i]);
+        visible++;
+    }
+
+    mInstancesDrawn = visible;
+    mBatchCount     = 0;
+
+    if(visible == 0)
+        return 0;
+
+    // The first batch takes everything that gets all the shells anyway, each further one half the scale of the one before
+    float fullScale = static_cast<float>(mNumberOfLayers) * PIXELS_PER_SHELL / std::max(mParameters.furLength, 1.0e-4f);
+
+    unsigned int counts[INSTANCE_BATCHES] = { 0 };
+    float        scales[INSTANCE_BATCHES] = { 0.0f };
+
+    for(unsigned int i = 0; i < mInstances.size(); i++) {
+
+        float scale = mInstanceScales[i];
+
+        if(scale <= 0.0f)
+            continue;
+
+        unsigned int b = instanceBatch(scale, fullScale, INSTANCE_BATCHES);
 
-        glUseProgram(furShaderProgram);
+        counts[b]++;
+        scales[b] = std::max(scales[b], scale);
+    }
+
+    StreamAllocation allocation = stream.allocate(visible * sizeof(FurInstance));
+
+    if(!allocation.data) {
+
+        // Out of stream space, all of them from the static buffer with the detail of the nearest
+        mInstanceSource       = instanceBuffer;
+        mInstanceSourceOffset = 0;
+
+        mBatches[0].first = 0;
+        mBatches[0].count = mInstances.size();
+        mBatches[0].scale = nearest;
+
+        mBatchCount     = 1;
+        mInstancesDrawn = mInstances.size();
 
-        // Set active tex-unit and bind texture
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, noiseID);
-        glUniform1i(noiseLoc, 1);
+        return mInstancesDrawn;
+    }
+
+    // Where each batch starts in the frame's instance data, nearest first
+    unsigned int cursors[INSTANCE_BATCHES];
+    unsigned int first = 0;
+
+    for(unsigned int b = 0; b < INSTANCE_BATCHES; b++) {
 
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, hairID);
-        glUniform1i(hairLoc, 2);
+        cursors[b] = first;
 
-        for(std::vector<Layer *>::iterator it = mFurLayers.begin(); it != mFurLayers.end(); ++it)
-            (*it)->render(matrices, lightSourcePower, windVelocity, cameraPosition);
+        if(counts[b] == 0)
+            continue;
+
+        mBatches[mBatchCount].first = first;
+        mBatches[mBatchCount].count = counts[b];
+        mBatches[mBatchCount].scale = scales[b];
+
+        mBatchCount++;
+        first += counts[b];
     }
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
+    writeInstances(static_cast<FurInstance *>(allocation.data), cursors, fullScale);
+
+    // What went through the mapping can get lost, then the same goes up again from a copy
+    if(!stream.commit(allocation)) {
+
+        std::vector<FurInstance> instances(visible);
+
+        writeInstances(&instances[0], cursors, fullScale);
+        stream.upload(allocation, &instances[0]);
+    }
+
+    mInstanceSource       = allocation.buffer;
+    mInstanceSourceOffset = allocation.offset;
+
+    return visible;
+}
+
+
+void Geometry::writeInstances(FurInstance *instances, const unsigned int *starts, float fullScale) {
+
+    unsigned int cursors[INSTANCE_BATCHES];
+
+    std::copy(starts, starts + INSTANCE_BATCHES, cursors);
+
+    for(unsigned int i = 0; i < mInstances.size(); i++) {
+
+        float scale = mInstanceScales[i];
+
+        if(scale <= 0.0f)
+            continue;
+
+        instances[cursors[instanceBatch(scale, fullScale, INSTANCE_BATCHES)]++] = mInstances[i];
+    }
+}
+
+
+void Geometry::updateFieldBounds() {
+
+    mFieldLow      = glm::vec3(std::numeric_limits<float>::max());
+    mFieldHigh     = glm::vec3(-std::numeric_limits<float>::max());
+    mInstanceScale = 0.0f;
+
+    // Box around the corners of every instance's box, once when they are set and never per frame
+    for(unsigned int i = 0; i < mInstances.size(); i++) {
+
+        const glm::mat4 &transform = mInstances[i].transform;
+
+        for(unsigned int c = 0; c < 8; c++) {
+
+            glm::vec3 corner((c & 1) ? mBoundingHigh.x : mBoundingLow.x,
+                             (c & 2) ? mBoundingHigh.y : mBoundingLow.y,
+                             (c & 4) ? mBoundingHigh.z : mBoundingLow.z);
+
+            glm::vec3 p = glm::vec3(transform * glm::vec4(corner, 1.0f));
+
+            mFieldLow  = glm::min(mFieldLow,  p);
+            mFieldHigh = glm::max(mFieldHigh, p);
+        }
+
+        // Longest axis, for the scaled sphere and fur
+        mInstanceSizes[i] = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+
+        mInstanceScale = std::max(mInstanceScale, mInstanceSizes[i]);
+    }
+
+    mFieldCenter = (mFieldLow + mFieldHigh) * 0.5f;
+    mFieldRadius = 0.0f;
+
+    for(unsigned int i = 0; i < mInstances.size(); i++) {
+
+        glm::vec3 center = glm::vec3(mInstances[i].transform * glm::vec4(mBoundingCenter, 1.0f));
+
+        mFieldRadius = std::max(mFieldRadius, glm::length(center - mFieldCenter) + mBoundingRadius * mInstanceScale);
+    }
+}
+
+
+bool Geometry::finsEnabled(const FrameData &frame) {
+
+    // The silhouette is found in the space of the mesh, with instances there is one per instance
+    return frame.fins && finShaderProgram && !mInstanced;
+}
+
+
+float Geometry::projectedScale(const FrameData &frame, const glm::mat4 &modelView, glm::vec3 center, float radius, float size) {
+
+    // Distance to the front of the bounding sphere with the fur on, inside of it we are as close as it gets
+    float distance = -(modelView * glm::vec4(center, 1.0f)).z - radius;
+
+    if(distance <= 0.0f)
+        return std::numeric_limits<float>::max();
+
+    // Pixels per unit in object space where the instance is closest to the camera, a scaled instance is that much larger
+    return frame.pixelsPerUnit * size / distance;
+}
+
+
+unsigned int Geometry::selectShellCount(const FrameData &frame, float scale) {
+
+    // The quality governor caps the shells whether or not the LOD is on, keeping at least one
+    unsigned int layers = static_cast<unsigned int>(mFurLayers.size());
+    unsigned int count  = std::min(layers, std::max(static_cast<unsigned int>(layers * frame.shellFraction + 0.5f), 1u));
+
+    if(!frame.shellLOD || count == 0)
+        return count;
+
+    // Length of the fur in pixels
+    float furPixels = mParameters.furLength * scale;
+
+    float pixelsPerShell = finsEnabled(frame) ? PIXELS_PER_SHELL_WITH_FINS : PIXELS_PER_SHELL;
+
+    unsigned int shells = static_cast<unsigned int>(std::min(ceilf(furPixels / pixelsPerShell), static_cast<float>(count)));
+
+    return std::min(std::max(shells, MIN_SHELLS), count);
+}
+
+
+unsigned int Geometry::selectMeshLOD(const FrameData &frame, float scale, float detail) {
+
+    if(!frame.meshLOD)
+        return 0;
+
+    // Triangles worth drawing for the area the bounding sphere covers on screen
+    float radius = (mBoundingRadius + mParameters.furLength) * std::min(scale, 1.0e6f);
+    float wanted = 3.14159f * radius * radius / PIXELS_PER_TRIANGLE * detail;
+
+    // The finest level that doesn't have more than that, or the coarsest one
+    for(unsigned int i = 0; i < mLODs.size(); i++) {
+        if(mLODs[i].count / 3 <= wanted)
+            return i;
+    }
+
+    return mLODs.size() - 1;
+}
+
+
+void Geometry::updateFur(float dt, const FrameData &frame, RenderState &state, WorkerPool &workers, StreamBuffer &stream, WindField &windField) {
+
+    if(mParameters.version != mAppliedVersion)
+        applyParameters();
+
+    // Hidden geometries don't move, and shouldn't see the rotation since they were last shown as motion
+    if(!mShallRender) {
+        mDynamics.reset();
+        mGPUDynamics.reset();
+        return;
+    }
+
+    GLuint   source = displacementBuffer;
+    GLintptr offset = 0;
+
+    if(frame.dynamicsMode == GPU_DYNAMICS && dynamicsShaderProgram) {
+
+        mDynamics.reset();
+        mGPUDynamics.step(state, dt, frame.orientation, windField, mParameters);
+
+        source = mGPUDynamics.getDisplacementBuffer();
+    }
+    else {
+
+        mGPUDynamics.reset();
+
+        // The workers write the displacement straight into this frame's slice of the stream buffer
+        StreamAllocation allocation = stream.allocate(mRenderVerts.size() * sizeof(glm::vec3));
+
+        mDynamics.step(workers, dt, frame.orientation, windField, mParameters, static_cast<glm::vec3 *>(allocation.data));
+
+        if(allocation.data && stream.commit(allocation)) {
+
+            source = allocation.buffer;
+            offset = allocation.offset;
+        }
+        else if(mRenderVerts.size() > 0) {
+
+            // Out of stream space, or the mapping was lost. Orphan our own buffer so that we don't wait
+            // for the frame that still reads it.
+            const std::vector<glm::vec3> &displacement = allocation.data ? mDynamics.gatherDisplacement() : mDynamics.getDisplacement();
+
+            glBindBuffer(GL_ARRAY_BUFFER, displacementBuffer);
+            glBufferData(GL_ARRAY_BUFFER, displacement.size() * sizeof(glm::vec3), NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, displacement.size() * sizeof(glm::vec3), &displacement[0]);
+        }
+    }
+
+    // Point the shells at wherever the latest displacement is, it moves every frame
+    if(source != mBoundDisplacement || offset != mBoundDisplacementOffset) {
+
+        state.bindVertexArray(vertexArrayID);
+
+        glBindBuffer(GL_ARRAY_BUFFER, source);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void*>(offset));
+
+        mBoundDisplacement       = source;
+        mBoundDisplacementOffset = offset;
+    }
+}
+
+
+void Geometry::updateFins(WorkerPool &workers, const FrameData &frame) {
+
+    if(!finsEnabled(frame) || !mShallRender) {
+        mFins.reset();
+        return;
+    }
+
+    // The eye in object space, the face planes are there
+    glm::vec4 eye = glm::inverse(frame.matrices[I_V] * frame.matrices[I_M]) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    mFins.update(workers, glm::vec3(eye));
+}
+
+
+void Geometry::setupFurProgram(GLuint program, glm::vec3 lightPosition) {
+
+    glUseProgram(program);
+    glUniform3f(glGetUniformLocation(program, "lightPosition"),  lightPosition[0], lightPosition[1], lightPosition[2]);
+    glUniform1i(glGetUniformLocation(program, "numberOfLayers"), mNumberOfLayers);
+    glUniform3f(glGetUniformLocation(program, "ambientColor"),   0.3f, 0.3f, 0.3f);
+    glUniform3f(glGetUniformLocation(program, "diffuseColor"),   0.8f, 0.8f, 0.8f);
+    glUniform1i(glGetUniformLocation(program, "textureSampler"), 1);
+    glUniform1i(glGetUniformLocation(program, "hairMapSampler"), 2);
+    glUniform1i(glGetUniformLocation(program, "maxHeightSampler"), MAX_HEIGHT_TEXTURE_UNIT);
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "FurParameters"), UBO_FUR);
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Frame"),         UBO_FRAME);
 }
 
 
-void Geometry::updateFur(float dt) {
+void Geometry::setParameters(const FurParameters &parameters) {
+
+    unsigned int version = mParameters.version + 1;
+
+    mParameters = parameters;
+    mParameters.version = version;
+}
+
+
+void Geometry::setNoiseType(int noiseType) {
+
+    if(mParameters.noiseType == noiseType)
+        return;
 
+    mParameters.noiseType = noiseType;
+    mParameters.version++;
+}
+
+
+void Geometry::applyParameters() {
+
+    // Shell offsets depend on the fur length
     float offset = 0.0f;
 
-    float stepLength = mFurLength / static_cast<float>(mNumberOfLayers);
+    float stepLength = mParameters.furLength / static_cast<float>(mNumberOfLayers);
 
-    for(std::vector<Layer*>::iterator it = mFurLayers.begin(); it != mFurLayers.end(); ++it) {
+    for(std::vector<Layer*>::iterator it = mFurLayers.begin(); it != mFurLayers.end(); ++it)
         (*it)->setOffset(offset += stepLength);
-        (*it)->setFurLength(mFurLength);
-        (*it)->setFurNoiseLengthVariation(mFurNoiseLengthVariation);
-        (*it)->setFurNoiseSampleScale(mFurNoiseSampleScale);
-        (*it)->setColor(mMaterial.furColor);
-        (*it)->setFurPatternScale(mMaterial.furPatternScale);
-        (*it)->setNoiseType(mNoiseType);
+
+    // Everything else goes to the uniform blocks
+    MaterialBlock material;
+    material.color         = mParameters.color;
+    material.ambientColor  = mParameters.ambient;
+    material.diffuseColor  = mParameters.diffuse;
+    material.specularColor = mParameters.specular;
+    material.transparency  = mParameters.transparency;
+    material.specularity   = mParameters.specularity;
+    material.shinyness     = mParameters.shinyness;
+    material.skinLayer     = mSkinTexture.layer;
+
+    FurBlock fur;
+    fur.furColor                = mParameters.furColor;
+    fur.furLength               = mParameters.furLength;
+    fur.furNoiseLengthVariation = mParameters.furNoiseLengthVariation;
+    fur.furNoiseSampleScale     = mParameters.furNoiseSampleScale;
+    fur.furPatternScale         = mParameters.furPatternScale;
+    fur.noiseType               = mParameters.noiseType;
+    fur.noiseLayer              = mNoiseTexture.layer;
+    fur.hairMapLayer            = mHairMap.layer;
+    fur.heightMargin            = HEIGHT_MARGIN;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(MaterialBlock), &material);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, furBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FurBlock), &fur);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    mAppliedVersion = mParameters.version;
+}
+
+
+void Geometry::cullBaldTriangles(std::vector<unsigned char> &heights) {
+
+    mFurLODs = mLODs;
+    mBaldFraction = 0.0f;
+
+    if(mIndices.empty())
+        return;
+
+    // Within each level the triangles with fur go first, the bald ones after, both in their original
+    // order. The heights move along with their triangles.
+    std::vector<unsigned int> reordered(mIndices);
+    std::vector<unsigned char> reorderedHeights(heights);
+
+    for(unsigned int l = 0; l < mLODs.size(); l++) {
+
+        unsigned int first = mLODs[l].first / 3;
+        unsigned int count = mLODs[l].count / 3;
+        unsigned int next  = first;
+
+        for(int pass = 0; pass < 2; pass++) {
+
+            for(unsigned int i = first; i < first + count; i++) {
+
+                if((heights[i] == 0) != (pass == 1))
+                    continue;
+
+                for(unsigned int c = 0; c < 3; c++)
+                    reordered[next * 3 + c] = mIndices[i * 3 + c];
+
+                reorderedHeights[next] = heights[i];
+
+                next++;
+            }
+
+            if(pass == 0)
+                mFurLODs[l].count = (next - first) * 3;
+        }
     }
+
+    mIndices.swap(reordered);
+    heights.swap(reorderedHeights);
+
+    if(!mLODs.empty() && mLODs[0].count > 0)
+        mBaldFraction = 1.0f - static_cast<float>(mFurLODs[0].count) / static_cast<float>(mLODs[0].count);
+
+    std::cout << mHairMapName << ": " << mBaldFraction * 100.0f << "% of the triangles are bald, the shells skip them" << std::endl;
 }
 
-void Geometry::setScreenCoordMovement(glm::vec2 m) {
 
-    for(std::vector<Layer *>::iterator it = mFurLayers.begin(); it != mFurLayers.end(); ++it)
-        (*it)->setScreenCoordMovement(m * 0.5f);
+void Geometry::buildMeshlets(const std::vector<unsigned char> &heights) {
+
+    mMeshlets.clear();
+    mLODMeshlets.assign(mLODs.size(), 0);
+
+    std::vector<unsigned int> reordered(mIndices);
+    std::vector<unsigned int> furry;
+    std::vector<Meshlet> meshlets;
+
+    mTrianglesAbove.assign(mLODs.size() * HEIGHT_VALUES, 0);
+    mMeshletsAbove.assign(mLODs.size() * HEIGHT_VALUES, 0);
+
+    // Only the fur at the start of each level, the bald triangles after it stay where they are
+    for(unsigned int l = 0; l < mFurLODs.size(); l++) {
+
+        unsigned int first = mFurLODs[l].first / 3;
+        unsigned int count = mFurLODs[l].count / 3;
+
+        furry.clear();
+
+        for(unsigned int i = first; i < first + count; i++)
+            furry.push_back(i);
+
+        // Nearby triangles go in one meshlet, which is as high as its highest triangle
+        meshlets.clear();
+        ::buildMeshlets(mRenderVerts, mIndices, furry, meshlets, MESHLET_TRIANGLES);
+
+        for(unsigned int m = 0; m < meshlets.size(); m++) {
+            for(unsigned int i = meshlets[m].firstIndex / 3; i < (meshlets[m].firstIndex + meshlets[m].count) / 3; i++)
+                meshlets[m].height = std::max(meshlets[m].height, static_cast<unsigned int>(heights[furry[i]]));
+        }
+
+        // Highest first, so that every shell draws a prefix of the meshlets
+        std::stable_sort(meshlets.begin(), meshlets.end(), [](const Meshlet &a, const Meshlet &b) { return a.height > b.height; });
+
+        unsigned int next = first;
+
+        mLODMeshlets[l] = static_cast<unsigned int>(mMeshlets.size());
+
+        for(unsigned int m = 0; m < meshlets.size(); m++) {
+
+            unsigned int triangle = meshlets[m].firstIndex / 3;
+
+            meshlets[m].firstIndex = next * 3;
+
+            for(unsigned int i = triangle; i < triangle + meshlets[m].count / 3; i++, next++) {
+                for(unsigned int c = 0; c < 3; c++)
+                    reordered[next * 3 + c] = mIndices[furry[i] * 3 + c];
+            }
+
+            // Counted once per height, summed up below
+            mTrianglesAbove[l * HEIGHT_VALUES + meshlets[m].height] += meshlets[m].count / 3;
+            mMeshletsAbove[l * HEIGHT_VALUES + meshlets[m].height]++;
+
+            mMeshlets.push_back(meshlets[m]);
+        }
+
+        for(int v = HEIGHT_VALUES - 2; v >= 0; v--) {
+            mTrianglesAbove[l * HEIGHT_VALUES + v] += mTrianglesAbove[l * HEIGHT_VALUES + v + 1];
+            mMeshletsAbove[l * HEIGHT_VALUES + v]  += mMeshletsAbove[l * HEIGHT_VALUES + v + 1];
+        }
+    }
+
+    mIndices.swap(reordered);
+
+    std::cout << mHairMapName << ": " << mMeshlets.size() << " meshlets" << std::endl;
 }
 
 
-void Geometry::setCurrentTime(float t) {
+unsigned int Geometry::shellHeight(const FrameData &frame, unsigned int layer, unsigned int shells) {
+
+    // Lowest the shell can be, the temporal jitter moves it down by up to one spacing of the drawn shells
+    float jitter    = frame.temporalShells ? static_cast<float>(mNumberOfLayers) / static_cast<float>(shells) : 0.0f;
+    float height    = std::max(static_cast<float>(layer) - jitter, 0.0f) / static_cast<float>(mNumberOfLayers);
+
+    // And the lowest threshold the noise can give it
+    float threshold = 0.2f + 0.8f * height - mParameters.furNoiseLengthVariation - HEIGHT_MARGIN;
 
-    for(std::vector<Layer *>::iterator it = mFurLayers.begin(); it != mFurLayers.end(); ++it)
-        (*it)->setCurrentTime(t);
+    // The meshlets from this height map value up reach the shell, HEIGHT_VALUES if none do
+    return static_cast<unsigned int>(std::min(std::max(static_cast<int>(ceilf(threshold * 255.0f)), 1), static_cast<int>(HEIGHT_VALUES)));
 }
 
 
@@ -236,6 +1061,43 @@ bool Geometry::loadMesh(const char * objName) {
 
     if(!loadObj(objName, mRenderVerts, mRenderUvs, mRenderNormals))
         return false;
+
+    if(mRenderVerts.empty())
+        return true;
+
+    // Share the vertices between triangles, then build the coarser levels of detail on top
+    weldMesh(mRenderVerts, mRenderUvs, mRenderNormals, mIndices);
+    buildLODChain(mRenderVerts, mIndices, mLODs, LOD_RATIO, MIN_LOD_TRIANGLES);
+
+    std::cout << objName << ": " << mRenderVerts.size() << " vertices, levels of detail with";
+
+    for(unsigned int i = 0; i < mLODs.size(); i++)
+        std::cout << " " << mLODs[i].count / 3;
+
+    std::cout << " triangles" << std::endl;
+
+    // Bounding box of the skin, and a sphere around its center, good enough for screen size estimates.
+    // The fur is added when they are used, its length can change.
+    glm::vec3 low  = mRenderVerts[0];
+    glm::vec3 high = mRenderVerts[0];
+
+    for(unsigned int i = 1; i < mRenderVerts.size(); i++) {
+        low  = glm::min(low,  mRenderVerts[i]);
+        high = glm::max(high, mRenderVerts[i]);
+    }
+
+    mBoundingLow    = low;
+    mBoundingHigh   = high;
+    mBoundingCenter = (low + high) * 0.5f;
+    mBoundingRadius = 0.0f;
+
+    for(unsigned int i = 0; i < mRenderVerts.size(); i++)
+        mBoundingRadius = std::max(mBoundingRadius, glm::length(mRenderVerts[i] - mBoundingCenter));
+
+    // Until instances are set the geometry is one instance without a transform
+    setInstances(std::vector<FurInstance>());
+
+    return true;
 }
 
 
@@ -245,21 +1107,14 @@ void Geometry::createFurLayers() {
 
     float offset = 0.0f;
 
-    float stepLength = mFurLength / static_cast<float>(mNumberOfLayers);
+    float stepLength = mParameters.furLength / static_cast<float>(mNumberOfLayers);
 
-    for(unsigned int i = 0; i < mNumberOfLayers; i++) {
-
-        mFurLayers[i] = new Layer(mRenderVerts, mRenderUvs, mRenderNormals, offset += stepLength, mNumberOfLayers, i);
-        mFurLayers[i]->setFurNoiseLengthVariation(mFurNoiseLengthVariation);
-        mFurLayers[i]->setFurNoiseSampleScale(mFurNoiseSampleScale);
-        mFurLayers[i]->setNoiseTextureID(noiseTextureID);
-        mFurLayers[i]->setHairMapID(hairMapID);
-        mFurLayers[i]->setHairMapName(mHairMapName);
-    }
+    for(unsigned int i = 0; i < mNumberOfLayers; i++)
+        mFurLayers[i] = new Layer(offset += stepLength, mNumberOfLayers, i);
 }
 
 
-void Geometry::generateNoiseTexture() {
+void Geometry::generateNoiseTexture(TextureArrayManager &textures) {
 
     unsigned int x = 0, y = 0;
     float noiseScale = 1.0f;
@@ -281,16 +1136,59 @@ void Geometry::generateNoiseTexture() {
         x++;
     }
 
-    // Generate OpenGL texture
-    glGenTextures(1, &noiseTextureID);
-    glBindTexture(GL_TEXTURE_2D, noiseTextureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mTextureWidth, mTextureHeight, 0, GL_BGRA, GL_UNSIGNED_BYTE, &mTextureData[0]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // A layer of the noise array of this size, the noise is the same for every geometry that has it
+    std::string name = "noise " + std::to_string(mTextureWidth) + " x " + std::to_string(mTextureHeight);
+
+    mNoiseTexture = textures.add(GL_RGBA, mTextureWidth, mTextureHeight, GL_BGRA, GL_UNSIGNED_BYTE, &mTextureData[0], GL_LINEAR, GL_LINEAR, name);
+}
+
+
+void Geometry::generateFinTexture() {
+
+    std::vector<GLubyte> texels(FIN_TEXTURE_WIDTH * FIN_TEXTURE_HEIGHT, 0);
+
+    // Fixed seed, the fins look the same every run
+    unsigned int seed = 12345u;
+
+    for(int x = 0; x < FIN_TEXTURE_WIDTH; x++) {
+
+        // Some columns have no strand, the others one of random length that thins out towards the tip
+        seed = seed * 1664525u + 1013904223u;
+
+        if((seed >> 8) % 1000 >= FIN_STRAND_DENSITY * 1000.0f)
+            continue;
+
+        seed = seed * 1664525u + 1013904223u;
+
+        float length = 0.5f + 0.5f * ((seed >> 8) % 1000) / 1000.0f;
+
+        for(int y = 0; y < FIN_TEXTURE_HEIGHT; y++) {
+
+            float height = (y + 0.5f) / FIN_TEXTURE_HEIGHT / length;
+
+            if(height < 1.0f)
+                texels[y * FIN_TEXTURE_WIDTH + x] = static_cast<GLubyte>(255.0f * sqrtf(1.0f - height));
+        }
+    }
+
+    // Repeats along the edge, but not past the root or the tip
+    glGenTextures(1, &finTextureID);
+    glBindTexture(GL_TEXTURE_2D, finTextureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, FIN_TEXTURE_WIDTH, FIN_TEXTURE_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, &texels[0]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 
-GLuint Geometry::loadTexture(const std::string filename, int &width, int &height) {
+TextureLayer Geometry::loadTexture(TextureArrayManager &textures, const std::string filename, int &width, int &height, std::vector<GLubyte> *red) {
+
+   TextureLayer texture;
 
    //header for testing if it is a png
    png_byte header[8];
@@ -298,7 +1196,7 @@ GLuint Geometry::loadTexture(const std::string filename, int &width, int &height
    //open file as binary
    FILE *fp = fopen(filename.c_str(), "rb");
    if (!fp) {
-     return TEXTURE_LOAD_ERROR;
+     return texture;
    }
    
    //read the header
@@ -308,7 +1206,7 @@ GLuint Geometry::loadTexture(const std::string filename, int &width, int &height
    int is_png = !png_sig_cmp(header, 0, 8);
    if (!is_png) {
      fclose(fp);
-     return TEXTURE_LOAD_ERROR;
+     return texture;
    }
    
    //create png struct
@@ -316,7 +1214,7 @@ GLuint Geometry::loadTexture(const std::string filename, int &width, int &height
        NULL, NULL);
    if (!png_ptr) {
      fclose(fp);
-     return (TEXTURE_LOAD_ERROR);
+     return texture;
    }
    
    //create png info struct
@@ -324,7 +1222,7 @@ GLuint Geometry::loadTexture(const std::string filename, int &width, int &height
    if (!info_ptr) {
      png_destroy_read_struct(&png_ptr, (png_infopp) NULL, (png_infopp) NULL);
      fclose(fp);
-     return (TEXTURE_LOAD_ERROR);
+     return texture;
    }
  
    //create png info struct
@@ -332,14 +1230,14 @@ GLuint Geometry::loadTexture(const std::string filename, int &width, int &height
    if (!end_info) {
      png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
      fclose(fp);
-     return (TEXTURE_LOAD_ERROR);
+     return texture;
    }
  
    //png error stuff, not sure libpng man suggests this.
    if (setjmp(png_jmpbuf(png_ptr))) {
      png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
      fclose(fp);
-     return (TEXTURE_LOAD_ERROR);
+     return texture;
    }
  
    //init png reading
@@ -363,8 +1261,22 @@ GLuint Geometry::loadTexture(const std::string filename, int &width, int &height
    width = twidth;
    height = theight;
  
+   // Gray, palette and 16 bit images come out as 8 bit RGB, or RGBA if they have alpha
+   png_set_expand(png_ptr);
+   png_set_strip_16(png_ptr);
+   png_set_gray_to_rgb(png_ptr);
+
    // Update the png info struct.
    png_read_update_info(png_ptr, info_ptr);
+
+   // Anything else would make the upload read past the rows
+   int channels = png_get_channels(png_ptr, info_ptr);
+   if (channels != 3 && channels != 4) {
+     std::cerr << "Unsupported PNG layout in " << filename << ": " << channels << " channels" << std::endl;
+     png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+     fclose(fp);
+     return texture;
+   }
  
    // Row size in bytes.
    int rowbytes = png_get_rowbytes(png_ptr, info_ptr);
@@ -375,7 +1287,7 @@ GLuint Geometry::loadTexture(const std::string filename, int &width, int &height
      //clean up memory and close stuff
      png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
      fclose(fp);
-     return TEXTURE_LOAD_ERROR;
+     return texture;
    }
  
    //row_pointers is for pointing to image_data for reading the png with libpng
@@ -385,7 +1297,7 @@ GLuint Geometry::loadTexture(const std::string filename, int &width, int &height
      png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
      delete[] image_data;
      fclose(fp);
-     return TEXTURE_LOAD_ERROR;
+     return texture;
    }
    // set the individual row_pointers to point at the correct offsets of image_data
    for (int i = 0; i < height; ++i)
@@ -394,13 +1306,16 @@ GLuint Geometry::loadTexture(const std::string filename, int &width, int &height
    //read the png into image_data through row_pointers
    png_read_image(png_ptr, row_pointers);
  
-   //Now generate the OpenGL texture object
-   GLuint texture;
-   glGenTextures(1, &texture);
-   glBindTexture(GL_TEXTURE_2D, texture);
-   glTexImage2D(GL_TEXTURE_2D,0, GL_RGBA, width, height, 0,
-       GL_RGB, GL_UNSIGNED_BYTE, (GLvoid*) image_data);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   // Keep the red channel around if asked for, rows bottom up like the texture
+   if (red) {
+     red->resize(width * height);
+     for (int i = 0; i < width * height; ++i)
+       (*red)[i] = image_data[(i / width) * rowbytes + (i % width) * channels];
+   }
+
+   //Now make it a layer of the array for textures of this size, files used by several geometries only once
+   GLenum format = (channels == 4) ? GL_RGBA : GL_RGB;
+   texture = textures.add(GL_RGBA, width, height, format, GL_UNSIGNED_BYTE, image_data, GL_NEAREST, GL_LINEAR, filename);
  
    //clean up memory and close stuff
    png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
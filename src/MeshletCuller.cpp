@@ -0,0 +1,76 @@
+#include "../include/MeshletCuller.h"
+
+// Binding points of the storage buffers, as in the culling shader
+#define SSBO_MESHLETS	0
+#define SSBO_COMMANDS	1
+
+
+MeshletCuller::MeshletCuller() {
+
+}
+
+
+MeshletCuller::~MeshletCuller() {
+
+    glDeleteBuffers(1, &meshletBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+}
+
+
+void MeshletCuller::initialize(GLuint program, const std::vector<Meshlet> &meshlets) {
+
+    shaderProgram = program;
+    mMeshletCount = static_cast<unsigned int>(meshlets.size());
+
+    if(!shaderProgram || meshlets.empty())
+        return;
+
+    frustumPlanesLoc = glGetUniformLocation(shaderProgram, "frustumPlanes");
+    eyeLoc           = glGetUniformLocation(shaderProgram, "eye");
+    furReachLoc      = glGetUniformLocation(shaderProgram, "furReach");
+    meshletCountLoc  = glGetUniformLocation(shaderProgram, "meshletCount");
+
+    glGenBuffers(1, &meshletBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshletBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, meshlets.size() * sizeof(Meshlet), &meshlets[0], GL_STATIC_DRAW);
+
+    // Written by the culling pass every frame, only ever read by the GPU
+    glGenBuffers(1, &commandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, meshlets.size() * COMMAND_SIZE, NULL, GL_DYNAMIC_COPY);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+
+void MeshletCuller::cull(RenderState &state, const Frustum &frustum, const glm::vec3 &eye, float furReach) {
+
+    if(!isAvailable())
+        return;
+
+    glm::vec4 planes[Frustum::PLANES];
+
+    for(unsigned int i = 0; i < Frustum::PLANES; i++)
+        planes[i] = frustum.getPlane(i);
+
+    state.useProgram(shaderProgram);
+
+    glUniform4fv(frustumPlanesLoc, Frustum::PLANES, &planes[0][0]);
+    glUniform3f(eyeLoc, eye.x, eye.y, eye.z);
+    glUniform1f(furReachLoc, furReach);
+    glUniform1ui(meshletCountLoc, mMeshletCount);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_MESHLETS, meshletBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_COMMANDS, commandBuffer);
+
+    glDispatchCompute((mMeshletCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+    // The draws read the commands, and the vertex shaders nothing else the pass wrote
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+
+void MeshletCuller::bind() {
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+}
@@ -0,0 +1,95 @@
+#include <algorithm>
+
+#include "../include/QualityGovernor.h"
+
+namespace {
+
+    // From full quality to the cheapest the fur is allowed to get, each level gives up a little more.
+    // The shells are a fraction of what each geometry has, 16 of 24 at the second level.
+    const QualitySettings LEVELS[] = {
+        { 1.0f,   1.0f,  2 },
+        { 0.667f, 1.0f,  2 },
+        { 0.667f, 1.0f,  1 },
+        { 0.5f,   0.75f, 1 },
+        { 0.333f, 0.75f, 1 },
+        { 0.333f, 0.5f,  0 },
+        { 0.25f,  0.5f,  0 },
+        { 0.167f, 0.5f,  0 }
+    };
+
+    const int LEVEL_COUNT = sizeof(LEVELS) / sizeof(LEVELS[0]);
+
+    // Weight of the newest frame in the smoothed frame cost
+    const float SMOOTHING = 0.1f;
+
+    // Over budget above this fraction of the target, clear headroom below the other
+    const float DOWNGRADE_RATIO = 1.05f;
+    const float UPGRADE_RATIO   = 0.75f;
+
+    // Frames to wait after a change before judging the new level
+    const unsigned int SETTLE_FRAMES = 30;
+}
+
+
+QualityGovernor::QualityGovernor() {
+
+    apply();
+}
+
+
+QualityGovernor::~QualityGovernor() {
+
+}
+
+
+void QualityGovernor::update(float frameTime) {
+
+    if(!mEnabled) {
+
+        if(mLevel != 0)
+            reset();
+
+        mAverageTime = frameTime;
+        return;
+    }
+
+    mAverageTime = (mAverageTime > 0.0f) ? mAverageTime + (frameTime - mAverageTime) * SMOOTHING : frameTime;
+
+    if(++mSettleFrames < SETTLE_FRAMES)
+        return;
+
+    int level = mLevel;
+
+    if(mAverageTime > mTargetTime * DOWNGRADE_RATIO)
+        level = std::min(mLevel + 1, LEVEL_COUNT - 1);
+
+    else if(mAverageTime < mTargetTime * UPGRADE_RATIO)
+        level = std::max(mLevel - 1, 0);
+
+    if(level == mLevel)
+        return;
+
+    mLevel        = level;
+    mSettleFrames = 0;
+
+    apply();
+}
+
+
+void QualityGovernor::reset() {
+
+    mLevel        = 0;
+    mSettleFrames = 0;
+    mAverageTime  = 0.0f;
+
+    apply();
+}
+
+
+void QualityGovernor::apply() {
+
+    mSettings = LEVELS[mLevel];
+
+    if(!mResolutionScaling)
+        mSettings.furResolution = 1.0f;
+}
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cstring>
+
+#include "../include/RenderQueue.h"
+#include "../include/Geometry.h"
+
+
+RenderQueue::RenderQueue() {
+
+}
+
+
+RenderQueue::~RenderQueue() {
+
+}
+
+
+void RenderQueue::begin(FrameArena &arena, unsigned int capacity, bool furBackToFront) {
+
+    // The arena hands the packets back at the start of the next frame
+    mPackets = arena.allocate<DrawPacket>(capacity);
+
+    // Should it run out the packets go on the heap, which only grows when the capacity does
+    if(!mPackets && capacity > 0) {
+
+        if(mFallback.size() < capacity)
+            mFallback.resize(capacity);
+
+        mPackets = &mFallback[0];
+    }
+
+    mCapacity = mPackets ? capacity : 0;
+    mCount    = 0;
+
+    mFurBackToFront = furBackToFront;
+}
+
+
+void RenderQueue::submit(RenderPass pass, GLuint program, GLuint texture, GLuint vertexArray, float depth, Geometry *geometry) {
+
+    if(mCount == mCapacity)
+        return;
+
+    // Only the low bits of the names, two that share them just aren't grouped
+    const std::uint64_t stateMask = (1u << STATE_BITS) - 1;
+
+    std::uint64_t state = ((program     & stateMask) << (2 * STATE_BITS))
+                        | ((texture     & stateMask) << STATE_BITS)
+                        |  (vertexArray & stateMask);
+
+    // Pass in the top bits. Below it the state and then the depth, or the other way round for blended fur.
+    std::uint64_t key = static_cast<std::uint64_t>(pass) << 62;
+
+    if(pass == FUR_PASS && mFurBackToFront)
+        key |= (depthBits(depth, true) << (3 * STATE_BITS)) | state;
+    else
+        key |= (state << DEPTH_BITS) | depthBits(depth, false);
+
+    DrawPacket &packet = mPackets[mCount++];
+
+    packet.key      = key;
+    packet.pass     = pass;
+    packet.geometry = geometry;
+}
+
+
+void RenderQueue::sort() {
+
+    // Equal keys keep the order they were submitted in, so the frame doesn't flicker between them
+    std::stable_sort(mPackets, mPackets + mCount, [](const DrawPacket &a, const DrawPacket &b) { return a.key < b.key; });
+}
+
+
+void RenderQueue::execute(RenderState &state, const FrameData &frame, RenderPass pass) {
+
+    // The packets of a pass are next to each other after the sort
+    for(unsigned int i = 0; i < mCount; i++) {
+
+        if(mPackets[i].pass != pass)
+            continue;
+
+        if(pass == SKIN_PASS)
+            mPackets[i].geometry->renderSkin(state, frame);
+        else
+            mPackets[i].geometry->renderShells(state, frame);
+    }
+}
+
+
+std::uint64_t RenderQueue::depthBits(float depth, bool farFirst) {
+
+    // The bits of a positive float sort like its value, behind the camera counts as nearest
+    depth = std::max(depth, 0.0f);
+
+    std::uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+
+    std::uint64_t quantized = bits >> (32 - DEPTH_BITS);
+
+    return farFirst ? ((1u << DEPTH_BITS) - 1) - quantized : quantized;
+}
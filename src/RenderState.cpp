@@ -0,0 +1,217 @@
+#include <cassert>
+
+#include "../include/RenderState.h"
+
+RenderState::RenderState() {
+
+    // The capabilities the render paths toggle
+    mCapabilities[0] = GL_BLEND;
+    mCapabilities[1] = GL_CULL_FACE;
+    mCapabilities[2] = GL_DEPTH_TEST;
+    mCapabilities[3] = GL_SAMPLE_ALPHA_TO_COVERAGE;
+    mCapabilities[4] = GL_MULTISAMPLE;
+    mCapabilities[5] = GL_RASTERIZER_DISCARD;
+    mCapabilities[6] = GL_SCISSOR_TEST;
+
+    // Spare slot for anything else
+    mCapabilities[7] = GL_NONE;
+
+    invalidate();
+}
+
+
+RenderState::~RenderState() {
+
+}
+
+
+void RenderState::invalidate() {
+
+    mProgram     = UNINITIALIZED;
+    mVertexArray = UNINITIALIZED;
+
+    invalidateTextures();
+
+    for(unsigned int i = 0; i < MAX_UNIFORM_BUFFER_BINDINGS; i++) {
+        mUniformBuffers[i] = UNINITIALIZED;
+        mUniformOffsets[i] = UNKNOWN;
+    }
+
+    for(int i = 0; i < CAPABILITY_COUNT; i++)
+        mCapabilityStates[i] = UNKNOWN;
+
+    mBlendSource           = UNINITIALIZED;
+    mBlendDestination      = UNINITIALIZED;
+    mBlendSourceAlpha      = UNINITIALIZED;
+    mBlendDestinationAlpha = UNINITIALIZED;
+    mDepthMask             = UNKNOWN;
+    mColorMask             = UNKNOWN;
+}
+
+
+void RenderState::invalidateTextures() {
+
+    mActiveUnit = UNINITIALIZED;
+
+    for(unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+        mTextures[i]       = UNINITIALIZED;
+        mTextureTargets[i] = UNINITIALIZED;
+    }
+}
+
+
+void RenderState::useProgram(GLuint program) {
+
+    if(program == mProgram)
+        return;
+
+    glUseProgram(program);
+    mProgram = program;
+}
+
+
+void RenderState::bindVertexArray(GLuint vertexArray) {
+
+    if(vertexArray == mVertexArray)
+        return;
+
+    glBindVertexArray(vertexArray);
+    mVertexArray = vertexArray;
+}
+
+
+void RenderState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+
+    assert(unit < MAX_TEXTURE_UNITS);
+
+    if(mTextures[unit] == texture && mTextureTargets[unit] == target)
+        return;
+
+    if(mActiveUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        mActiveUnit = unit;
+    }
+
+    glBindTexture(target, texture);
+
+    mTextures[unit]       = texture;
+    mTextureTargets[unit] = target;
+}
+
+
+void RenderState::bindUniformBuffer(GLuint binding, GLuint buffer) {
+
+    assert(binding < MAX_UNIFORM_BUFFER_BINDINGS);
+
+    if(mUniformBuffers[binding] == buffer && mUniformOffsets[binding] == UNKNOWN)
+        return;
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+
+    mUniformBuffers[binding] = buffer;
+    mUniformOffsets[binding] = UNKNOWN;
+}
+
+
+void RenderState::bindUniformBufferRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+
+    assert(binding < MAX_UNIFORM_BUFFER_BINDINGS);
+
+    // Ranges out of the stream buffer move every frame, the size never does for a given block
+    if(mUniformBuffers[binding] == buffer && mUniformOffsets[binding] == offset)
+        return;
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+
+    mUniformBuffers[binding] = buffer;
+    mUniformOffsets[binding] = offset;
+}
+
+
+void RenderState::enable(GLenum cap) {
+
+    int &state = capability(cap);
+
+    if(state == 1)
+        return;
+
+    glEnable(cap);
+    state = 1;
+}
+
+
+void RenderState::disable(GLenum cap) {
+
+    int &state = capability(cap);
+
+    if(state == 0)
+        return;
+
+    glDisable(cap);
+    state = 0;
+}
+
+
+void RenderState::blendFunc(GLenum source, GLenum destination) {
+
+    if(source == mBlendSource && destination == mBlendDestination &&
+       source == mBlendSourceAlpha && destination == mBlendDestinationAlpha)
+        return;
+
+    glBlendFunc(source, destination);
+
+    mBlendSource           = source;
+    mBlendDestination      = destination;
+    mBlendSourceAlpha      = source;
+    mBlendDestinationAlpha = destination;
+}
+
+
+void RenderState::blendFuncSeparate(GLenum source, GLenum destination, GLenum sourceAlpha, GLenum destinationAlpha) {
+
+    if(source == mBlendSource && destination == mBlendDestination &&
+       sourceAlpha == mBlendSourceAlpha && destinationAlpha == mBlendDestinationAlpha)
+        return;
+
+    glBlendFuncSeparate(source, destination, sourceAlpha, destinationAlpha);
+
+    mBlendSource           = source;
+    mBlendDestination      = destination;
+    mBlendSourceAlpha      = sourceAlpha;
+    mBlendDestinationAlpha = destinationAlpha;
+}
+
+
+void RenderState::depthMask(GLboolean flag) {
+
+    if(mDepthMask == static_cast<int>(flag))
+        return;
+
+    glDepthMask(flag);
+    mDepthMask = flag;
+}
+
+
+void RenderState::colorMask(GLboolean flag) {
+
+    if(mColorMask == static_cast<int>(flag))
+        return;
+
+    glColorMask(flag, flag, flag, flag);
+    mColorMask = flag;
+}
+
+
+int &RenderState::capability(GLenum cap) {
+
+    for(int i = 0; i < CAPABILITY_COUNT - 1; i++) {
+        if(mCapabilities[i] == cap)
+            return mCapabilityStates[i];
+    }
+
+    // Untracked capabilities share the last slot, which we never trust
+    mCapabilities[CAPABILITY_COUNT - 1] = cap;
+    mCapabilityStates[CAPABILITY_COUNT - 1] = UNKNOWN;
+
+    return mCapabilityStates[CAPABILITY_COUNT - 1];
+}
@@ -1,6 +1,15 @@
 #include "../include/Scene.h"
 
-Scene::Scene() {
+namespace {
+
+	// Shell jitter of consecutive frames in the temporal mode, each window of four covers the spacing evenly
+	const float SHELL_JITTER[] = { 0.0f, 0.5f, 0.25f, 0.75f };
+
+	const unsigned int JITTER_PHASES = sizeof(SHELL_JITTER) / sizeof(SHELL_JITTER[0]);
+}
+
+Scene::Scene()
+	: mSampleCounter(GL_SAMPLES_PASSED) {
 
 }
 
@@ -12,6 +21,9 @@ Scene::~Scene() {
 			delete mGeometries[i];
 	}
 
+	for(unsigned int i = 0; i < mProgramIDs.size(); i++)
+		glDeleteProgram(mProgramIDs[i]);
+
 	std::cout << "Scene destroyed!\n" << std::endl;
 }
 
@@ -21,24 +33,106 @@ void Scene::initialize() {
 	// Background color
 	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
 	// Set up the camera
 	mCamera = new Camera(glm::vec3(0.0f, 0.0f, 3.0f));
 
 	// Light source position
 	mLightSource.pos = glm::vec3(0.0f, 5.0f, 0.0f);
 
+	// The window is bound now
+	updateTargetSamples();
+
 	GLuint phongID = LoadShaders(mShaderPrograms[I_PHONG].first.c_str(), mShaderPrograms[I_PHONG].second.c_str());
 	GLuint furID   = LoadShaders(mShaderPrograms[I_FUR].first.c_str(),   mShaderPrograms[I_FUR].second.c_str());
 
+	// Transform feedback program for the GPU fur dynamics, captures the new tip state
+	const char * dynamicsVaryings[] = { "displacement", "velocity" };
+	GLuint dynamicsID = mDynamicsShader.empty() ? 0 : LoadTransformFeedbackShader(mDynamicsShader.c_str(), dynamicsVaryings, 2);
+
+	// Tessellated shells are optional, without GL 4.0 the shells stay on the vertex shader path
+	GLuint tessellatedFurID = 0;
+
+	if(!mTessellationShaders[0].empty() && (GLEW_VERSION_4_0 || GLEW_ARB_tessellation_shader)) {
+
+		tessellatedFurID = LoadShaders(mTessellationShaders[0].c_str(), mTessellationShaders[1].c_str(),
+									   mTessellationShaders[2].c_str(), mShaderPrograms[I_FUR].second.c_str());
+
+		// Every patch is one triangle of the mesh
+		if(tessellatedFurID)
+			glPatchParameteri(GL_PATCH_VERTICES, 3);
+	}
+
+	mTessellationAvailable = tessellatedFurID != 0;
+
+	if(!mTessellationAvailable)
+		std::cout << "Tessellation is not available, the shells use the vertex shader path" << std::endl;
+
+	// Weighted OIT is optional as well, blending takes over without the composite pass
+	GLuint compositeID = mCompositeShaders.first.empty() ? 0 : LoadShaders(mCompositeShaders.first.c_str(), mCompositeShaders.second.c_str());
+
+	mOIT.initialize(compositeID);
+
+	// Same for the reduced resolution fur, without it the fur stays at full resolution
+	GLuint upsampleID = mUpsampleShaders.first.empty() ? 0 : LoadShaders(mUpsampleShaders.first.c_str(), mUpsampleShaders.second.c_str());
+
+	mFurUpsampler.initialize(upsampleID);
+
+	// And the temporal accumulation, without it the shells aren't jittered
+	GLuint resolveID = 0, copyID = 0;
+
+	if(!mTemporalShaders[0].empty()) {
+		resolveID = LoadShaders(mTemporalShaders[0].c_str(), mTemporalShaders[1].c_str());
+		copyID    = LoadShaders(mTemporalShaders[0].c_str(), mTemporalShaders[2].c_str());
+	}
+
+	mTemporal.initialize(resolveID, copyID);
+
+	// Fins need a geometry shader, which GL 3.3 always has
+	GLuint finID = mFinShaders[0].empty() ? 0 : LoadShaders(mFinShaders[0].c_str(), mFinShaders[1].c_str(), mFinShaders[2].c_str());
+
+	// Culling the meshlets on the GPU needs compute shaders and multi draw indirect, GL 4.3
+	GLuint cullID = 0;
+
+	if(!mCullShader.empty() && (GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_storage_buffer_object)))
+		cullID = LoadComputeShader(mCullShader.c_str());
+
+	mMeshletCullingAvailable = cullID != 0;
+
+	if(!mMeshletCullingAvailable)
+		std::cout << "Compute shaders are not available, the shells draw without meshlet culling" << std::endl;
+
+	GLuint programIDs[] = { phongID, furID, dynamicsID, tessellatedFurID, compositeID, upsampleID, resolveID, copyID, finID, cullID };
+
+	mProgramIDs.assign(programIDs, programIDs + sizeof(programIDs) / sizeof(programIDs[0]));
+
+	// Room for the frame uniforms plus the displacement of every geometry, in case they are all shown,
+	// and the visible instances of the largest field
+	GLsizeiptr streamSize = 64 * 1024 + MAX_FIELD_SIZE * sizeof(FurInstance);
+
+	for(std::vector<Geometry *>::iterator it = mGeometries.begin(); it != mGeometries.end(); ++it)
+		streamSize += (*it)->getVertexCount() * sizeof(glm::vec3) + 256;
+
+	mStream.initialize(streamSize);
+
+	mWindField.initialize(mFrame.currentTime, mWindVelocity);
+
+	mGPUTimer.initialize();
+
+	mSampleCounter.initialize();
+
 	for(std::vector<Geometry *>::iterator it = mGeometries.begin(); it != mGeometries.end(); ++it) {
 		(*it)->setShaderProgram(phongID);
 		(*it)->setFurShaderProgram(furID);
-		(*it)->initialize(mLightSource.pos);
+		(*it)->setDynamicsShaderProgram(dynamicsID);
+		(*it)->setTessellatedFurShaderProgram(tessellatedFurID);
+		(*it)->setFinShaderProgram(finID);
+		(*it)->setCullShaderProgram(cullID);
+		(*it)->initialize(mLightSource.pos, mWorkers, mTextureArrays);
 	}
 
+	// The geometries only reserved layers, every array is uploaded once they all have
+	mTextureArrays.build();
+
 	std::cout << "\nScene initialized!\n";
 }
 
@@ -47,31 +141,251 @@ void Scene::render() {
 
 	mCamera->update();
 
-	mMatrices.resize(6);
+	// Everything allocated last frame is dead by now
+	mFrameArena.reset();
+
+	// Anything outside the scene (the tweak bar) may have touched GL state since the last frame
+	mRenderState.invalidate();
+
+	mRenderState.enable(GL_BLEND);
+	mRenderState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Get all matrices from the camera so that they can be assigned to each object when rendering
 
-	mMatrices[I_MVP] 	  = mCamera->getProjectionMatrix() * mCamera->getViewMatrix() * mCamera->getModelMatrix();
+	mFrame.matrices[I_MVP] = mCamera->getProjectionMatrix() * mCamera->getViewMatrix() * mCamera->getModelMatrix();
+
+	mFrame.matrices[I_M]   = mCamera->getModelMatrix();
+
+	mFrame.matrices[I_V]   = mCamera->getViewMatrix();
+
+	mFrame.cameraPosition   = mCamera->getPosition();
+	mFrame.lightSourcePower = mLightSource.power;
+	mFrame.windVelocity     = mWindVelocity;
+
+	// Vertical pixels per unit at distance one, the viewport is always WIDTH x HEIGHT
+	mFrame.pixelsPerUnit    = mCamera->getProjectionMatrix()[1][1] * HEIGHT * 0.5f;
+	mFrame.shellLOD         = mShellLOD;
+	mFrame.meshLOD          = mMeshLOD;
+	mFrame.furPath          = mTessellationAvailable ? mFurPath : VERTEX_SHELLS;
+	mFrame.shellBlending    = (mShellBlending == WEIGHTED_OIT_SHELLS && !mOIT.isAvailable()) ? BLENDED_SHELLS : mShellBlending;
+	mFrame.shellFraction    = mGovernor.getSettings().shellFraction;
+	mFrame.fins             = mFins;
+	mFrame.meshletCulling   = mMeshletCullingAvailable && mMeshletCulling;
+
+	// Only blended fur can go through the reduced resolution target, so only then may the governor scale it
+	bool upsampling = mFurUpsampler.isAvailable() && mFrame.shellBlending == BLENDED_SHELLS;
+
+	mGovernor.setResolutionScaling(upsampling);
+
+	float furScale = std::min(1.0f / mFurDownsample, mGovernor.getSettings().furResolution);
 
-	mMatrices[I_M] 	  	  = mCamera->getModelMatrix();
+	bool temporal = mTemporalShells && mTemporal.isAvailable();
 
-	mMatrices[I_V] 	  	  = mCamera->getViewMatrix();
+	mFrame.temporalShells = temporal;
+
+	// Whatever is in the history is stale once the mode was off
+	if(!temporal)
+		mTemporal.invalidate();
+
+	mTemporalFrame++;
+
+	// Collect what should be drawn this frame. All geometries share the model matrix, so one object
+	// space frustum tests them all, and then the instances of those in view. The instances that are
+	// left go to the stream buffer, grouped by distance.
+	Frustum frustum(mFrame.matrices[I_MVP]);
+
+	beginStreamFrame();
+
+	Geometry ** renderList = mFrameArena.allocate<Geometry *>(mGeometries.size());
+	unsigned int renderCount = 0;
+
+	// Should the arena run out the list goes on the heap, it only grows the first time
+	if(!renderList) {
+		mRenderListFallback.resize(mGeometries.size());
+		renderList = mRenderListFallback.empty() ? NULL : &mRenderListFallback[0];
+	}
+
+	mGeometriesCulled = 0;
 
 	for(std::vector<Geometry *>::iterator it = mGeometries.begin(); it != mGeometries.end(); ++it) {
-		if((*it)->getShallRender())
-			(*it)->render(mMatrices, mLightSource.power, mWindVelocity, mCamera->getPosition());
+
+		if(!(*it)->getShallRender())
+			continue;
+
+		if((*it)->isVisible(frustum) && (*it)->cullInstances(frustum, mFrame, mStream) > 0)
+			renderList[renderCount++] = *it;
+		else
+			mGeometriesCulled++;
 	}
+
+	// Everything per frame that the shaders share goes in one uniform block
+	StreamAllocation frameBlock = mStream.allocate(sizeof(FrameUniforms), mStream.getUniformAlignment());
+
+	if(frameBlock.data) {
+
+		// Built on the stack and copied in, a lost mapping needs it again
+		FrameUniforms uniforms;
+
+		uniforms.MVP 			= mFrame.matrices[I_MVP];
+		uniforms.M 				= mFrame.matrices[I_M];
+		uniforms.V 				= mFrame.matrices[I_V];
+		uniforms.cameraPosition = mFrame.cameraPosition;
+		uniforms.lightPower 	= mFrame.lightSourcePower;
+		uniforms.noiseDetail 	= mGovernor.getSettings().noiseDetail;
+		uniforms.shellBlending  = mFrame.shellBlending;
+		uniforms.shellJitter    = temporal ? SHELL_JITTER[mTemporalFrame % JITTER_PHASES] : 0.0f;
+
+		*static_cast<FrameUniforms *>(frameBlock.data) = uniforms;
+
+		if(!mStream.commit(frameBlock))
+			mStream.upload(frameBlock, &uniforms);
+
+		mRenderState.bindUniformBufferRange(UBO_FRAME, frameBlock.buffer, frameBlock.offset, frameBlock.size);
+	}
+
+	mShellsDrawn    = 0;
+	mTrianglesDrawn = 0;
+	mFinsDrawn      = 0;
+
+	// The silhouettes only depend on the camera, find them before any of the passes draw
+	for(unsigned int i = 0; i < renderCount; i++)
+		renderList[i]->updateFins(mWorkers, mFrame);
+
+	// Every pass below draws from the same sorted packets. Blended fur goes far to near, the other
+	// modes don't care about the order and group the fur by state.
+	mRenderQueue.begin(mFrameArena, renderCount * 2, mFrame.shellBlending == BLENDED_SHELLS);
+
+	for(unsigned int i = 0; i < renderCount; i++)
+		renderList[i]->submit(mRenderQueue, mFrame);
+
+	mRenderQueue.sort();
+
+	// The passes below return to whatever is bound, so they all end up in the temporal target
+	if(temporal)
+		mTemporal.begin(mRenderState, mTargetSamples);
+
+	mSampleCounter.begin();
+
+	if(mFrame.shellBlending == WEIGHTED_OIT_SHELLS) {
+
+		// The skins are opaque and go straight into the framebuffer
+		mRenderQueue.execute(mRenderState, mFrame, SKIN_PASS);
+
+		// Once more, depth only, so that the skins hide the shells behind them in the OIT targets
+		mOIT.begin(mRenderState);
+		mRenderState.colorMask(GL_FALSE);
+
+		mRenderQueue.execute(mRenderState, mFrame, SKIN_PASS);
+
+		mRenderState.colorMask(GL_TRUE);
+
+		// No sorting needed between the geometries or the shells of one
+		mOIT.accumulate(mRenderState);
+
+		mRenderQueue.execute(mRenderState, mFrame, FUR_PASS);
+
+		mOIT.composite(mRenderState);
+	}
+	else if(upsampling && furScale < 1.0f) {
+
+		// Full resolution skins, then their depth once more to hide the fur behind them and guide the upsample
+		mRenderQueue.execute(mRenderState, mFrame, SKIN_PASS);
+
+		mFurUpsampler.begin(mRenderState);
+
+		mRenderQueue.execute(mRenderState, mFrame, SKIN_PASS);
+
+		mFurUpsampler.accumulate(mRenderState, furScale);
+
+		mRenderQueue.execute(mRenderState, mFrame, FUR_PASS);
+
+		mFurUpsampler.composite(mRenderState, mCamera->getProjectionMatrix());
+	}
+	else {
+
+		// Every skin before any fur, so that the shells blend over all of them
+		mRenderQueue.execute(mRenderState, mFrame, SKIN_PASS);
+		mRenderQueue.execute(mRenderState, mFrame, FUR_PASS);
+	}
+
+	mSampleCounter.end();
+
+	if(temporal)
+		mTemporal.resolve(mRenderState, mFrame.matrices[I_MVP], mPreviousMVP);
+
+	mPreviousMVP = mFrame.matrices[I_MVP];
+
+	mBaldFraction   = 0.0f;
+	mInstancesDrawn = 0;
+
+	for(unsigned int i = 0; i < renderCount; i++) {
+		mInstancesDrawn += renderList[i]->getInstancesDrawn();
+		mBaldFraction   += renderList[i]->getBaldFraction() / renderCount;
+		mShellsDrawn    += renderList[i]->getShellsDrawn();
+		mTrianglesDrawn += renderList[i]->getTrianglesDrawn();
+		mFinsDrawn      += renderList[i]->getFinsDrawn();
+	}
+
+	mOverdraw = static_cast<float>(mSampleCounter.getResult()) / (static_cast<float>(WIDTH * HEIGHT) * mTargetSamples);
+
+	// The GPU owns this frame's stream data until the fence passes
+	mStream.endFrame();
+	mStreamFrameOpen = false;
+
+	mGPUTimer.end();
+
+	// Whichever side took longer bounds the frame rate, the governor picks the quality for the next frame
+	float cpuTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - mFrameStart).count();
+
+	mGovernor.update(std::max(cpuTime, mGPUTimer.getTime()));
 }
 
 
 void Scene::update(float dt) {
 
+	// Take the wind the worker solved since last frame, and have it start on the next one
+	mWindField.update(mFrame.currentTime, mWindVelocity);
+
+	mFrame.orientation  = mCamera->getOrientation();
+	mFrame.dynamicsMode = mDynamicsMode;
+
+	// The GPU dynamics go through the render state, and the tweak bar may have touched GL since last frame
+	mRenderState.invalidate();
+
+	beginStreamFrame();
+
+	mDynamicsTime = 0.0f;
+
 	for(std::vector<Geometry *>::iterator it = mGeometries.begin(); it != mGeometries.end(); ++it) {
-		(*it)->updateFur(dt);
+		(*it)->updateFur(dt, mFrame, mRenderState, mWorkers, mStream, mWindField);
+		mDynamicsTime += (*it)->getDynamicsTime();
 	}
 }
 
 
+void Scene::updateTargetSamples() {
+
+	// Whatever is bound, the window or an offscreen target, decides how many samples a pixel has
+	GLint samples = 0;
+	glGetIntegerv(GL_SAMPLES, &samples);
+
+	mTargetSamples = std::max(samples, 1);
+}
+
+
+void Scene::beginStreamFrame() {
+
+	if(mStreamFrameOpen)
+		return;
+
+	mStream.beginFrame();
+	mStreamFrameOpen = true;
+
+	mFrameStart = std::chrono::steady_clock::now();
+	mGPUTimer.begin();
+}
+
+
 void Scene::updateCameraPosition(double x, double y) {
     
     if(!mCamera->dragged())
@@ -80,9 +394,6 @@ void Scene::updateCameraPosition(double x, double y) {
     mCamera->rotate(mCamera->getOrientation(), x, y);
 
     mCamera->dragUpdate(x, y);
-
-    for(std::vector<Geometry *>::iterator it = mGeometries.begin(); it != mGeometries.end(); ++it)
-    	(*it)->setScreenCoordMovement(mCamera->getScreenCoordMovement());
 }
 
 
@@ -97,10 +408,3 @@ void Scene::resetCamera() {
 
 	mCamera->reset();
 }
-
-
-void Scene::setCurrentTime(float t) {
-
-	for(std::vector<Geometry *>::iterator it = mGeometries.begin(); it != mGeometries.end(); ++it)
-		(*it)->setCurrentTime(t);
-}
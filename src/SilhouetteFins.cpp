@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+
+#include "../include/SilhouetteFins.h"
+
+// SSE is everywhere on x86, other targets take the scalar path
+#if defined(__SSE__) || defined(_M_X64)
+#define FUR_SIMD
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+    // A full pass at least this often, new silhouettes may show up anywhere when the object turns
+    const unsigned int FULL_UPDATE_INTERVAL = 30;
+
+    // And whenever the view direction turned further than this since the last update, about 2 degrees.
+    // The incremental pass moves the silhouette by one ring of faces, that is all it can follow.
+    const float FULL_UPDATE_COSINE = 0.9994f;
+}
+
+
+SilhouetteFins::SilhouetteFins() {
+
+}
+
+
+SilhouetteFins::~SilhouetteFins() {
+
+    glDeleteBuffers(1, &indexBuffer);
+}
+
+
+void SilhouetteFins::initialize(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices, unsigned int first, unsigned int count) {
+
+    mFaceCount = count / 3;
+
+    if(positions.empty())
+        return;
+
+    // Corners at the same position are one vertex here, seams in the UVs or normals don't split the surface
+    std::vector<unsigned int> order(positions.size());
+
+    for(unsigned int i = 0; i < order.size(); i++)
+        order[i] = i;
+
+    std::sort(order.begin(), order.end(), [&positions](unsigned int a, unsigned int b) {
+        const glm::vec3 &p = positions[a], &q = positions[b];
+        return p.x < q.x || (p.x == q.x && (p.y < q.y || (p.y == q.y && p.z < q.z)));
+    });
+
+    std::vector<unsigned int> welded(positions.size());
+
+    for(unsigned int i = 0; i < order.size(); i++)
+        welded[order[i]] = (i > 0 && positions[order[i]] == positions[order[i - 1]]) ? welded[order[i - 1]] : order[i];
+
+    // Padding stays zero, a plane that never faces the eye
+    unsigned int padded = (mFaceCount + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+
+    mPlaneX.assign(padded, 0.0f);
+    mPlaneY.assign(padded, 0.0f);
+    mPlaneZ.assign(padded, 0.0f);
+    mPlaneD.assign(padded, 0.0f);
+    mFacing.assign(padded, 0);
+
+    mFaceEdges.assign(mFaceCount * 3, NO_EDGE);
+
+    // Edges by their welded end points, with the number of faces seen on each so far
+    std::unordered_map<unsigned long long, unsigned int> edgeMap;
+    std::vector<Edge> edges;
+    std::vector<unsigned int> shared;
+
+    for(unsigned int f = 0; f < mFaceCount; f++) {
+
+        const unsigned int *t = &indices[first + f * 3];
+
+        // Only the sign of the plane matters, the normal doesn't have to be unit length
+        glm::vec3 n = glm::cross(positions[t[1]] - positions[t[0]], positions[t[2]] - positions[t[0]]);
+
+        mPlaneX[f] = n.x;
+        mPlaneY[f] = n.y;
+        mPlaneZ[f] = n.z;
+        mPlaneD[f] = glm::dot(n, positions[t[0]]);
+
+        // Degenerate faces face nowhere and don't connect anything
+        if(glm::dot(n, n) == 0.0f)
+            continue;
+
+        for(unsigned int c = 0; c < 3; c++) {
+
+            unsigned int a = t[c], b = t[(c + 1) % 3];
+            unsigned int wa = welded[a], wb = welded[b];
+
+            if(wa == wb)
+                continue;
+
+            unsigned long long key = (static_cast<unsigned long long>(std::min(wa, wb)) << 32) | std::max(wa, wb);
+
+            std::unordered_map<unsigned long long, unsigned int>::iterator found = edgeMap.find(key);
+
+            if(found == edgeMap.end()) {
+
+                Edge edge = { { a, b }, { f, NO_FACE } };
+
+                mFaceEdges[f * 3 + c] = static_cast<unsigned int>(edges.size());
+                edgeMap[key] = static_cast<unsigned int>(edges.size());
+
+                edges.push_back(edge);
+                shared.push_back(1);
+            }
+            else {
+
+                if(shared[found->second]++ == 1)
+                    edges[found->second].faces[1] = f;
+
+                mFaceEdges[f * 3 + c] = found->second;
+            }
+        }
+    }
+
+    // Only edges between exactly two faces can be on the silhouette, borders and non-manifold edges are left out
+    std::vector<unsigned int> remap(edges.size(), NO_EDGE);
+
+    mEdges.clear();
+
+    for(unsigned int e = 0; e < edges.size(); e++) {
+        if(shared[e] == 2) {
+            remap[e] = static_cast<unsigned int>(mEdges.size());
+            mEdges.push_back(edges[e]);
+        }
+    }
+
+    for(unsigned int i = 0; i < mFaceEdges.size(); i++) {
+        if(mFaceEdges[i] != NO_EDGE)
+            mFaceEdges[i] = remap[mFaceEdges[i]];
+    }
+
+    mSlots.assign(mEdges.size(), NO_SLOT);
+    mEdgeStamp.assign(mEdges.size(), 0);
+    mFaceStamp.assign(mFaceCount, 0);
+
+    // Nothing is allocated per frame, the silhouette can't have more edges than the mesh
+    mFins.clear();
+    mFins.reserve(mEdges.size());
+    mFinIndices.clear();
+    mFinIndices.reserve(mEdges.size() * 2);
+    mCandidates.reserve(mFaceCount);
+
+    glm::vec3 low  = positions[0];
+    glm::vec3 high = positions[0];
+
+    for(unsigned int i = 1; i < positions.size(); i++) {
+        low  = glm::min(low,  positions[i]);
+        high = glm::max(high, positions[i]);
+    }
+
+    mCenter = (low + high) * 0.5f;
+
+    // Bound through the copy target, binding an element array buffer would change the current vertex array
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, std::max<size_t>(mEdges.size(), 1) * 2 * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    std::cout << "Fins: " << mEdges.size() << " edges between " << mFaceCount << " faces" << std::endl;
+
+    mFramesToFullUpdate = 0;
+}
+
+
+void SilhouetteFins::update(WorkerPool &workers, const glm::vec3 &eye) {
+
+    if(mEdges.empty())
+        return;
+
+    float turn = glm::dot(glm::normalize(mEye - mCenter), glm::normalize(eye - mCenter));
+
+    mEye = eye;
+
+    // Nothing to grow the silhouette from when there is none yet
+    if(mFramesToFullUpdate == 0 || mFins.empty() || !(turn > FULL_UPDATE_COSINE)) {
+        fullUpdate(workers);
+        mFramesToFullUpdate = FULL_UPDATE_INTERVAL;
+    }
+    else {
+        incrementalUpdate();
+        mFramesToFullUpdate--;
+    }
+
+    upload();
+}
+
+
+void SilhouetteFins::classifyJob(unsigned int begin, unsigned int end, void *context) {
+
+    static_cast<SilhouetteFins *>(context)->classify(begin * SIMD_WIDTH, end * SIMD_WIDTH);
+}
+
+
+void SilhouetteFins::classify(unsigned int begin, unsigned int end) {
+
+#ifdef FUR_SIMD
+
+    const __m128 ex   = _mm_set1_ps(mEye.x);
+    const __m128 ey   = _mm_set1_ps(mEye.y);
+    const __m128 ez   = _mm_set1_ps(mEye.z);
+    const __m128 zero = _mm_setzero_ps();
+
+    for(unsigned int i = begin; i < end; i += SIMD_WIDTH) {
+
+        __m128 distance = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&mPlaneX[i]), ex),
+                                                           _mm_mul_ps(_mm_loadu_ps(&mPlaneY[i]), ey)),
+                                                _mm_mul_ps(_mm_loadu_ps(&mPlaneZ[i]), ez)),
+                                     _mm_loadu_ps(&mPlaneD[i]));
+
+        int mask = _mm_movemask_ps(_mm_cmpgt_ps(distance, zero));
+
+        mFacing[i]     = mask & 1;
+        mFacing[i + 1] = (mask >> 1) & 1;
+        mFacing[i + 2] = (mask >> 2) & 1;
+        mFacing[i + 3] = (mask >> 3) & 1;
+    }
+
+#else
+
+    for(unsigned int i = begin; i < end; i++)
+        mFacing[i] = facing(i);
+
+#endif
+}
+
+
+bool SilhouetteFins::facing(unsigned int f) {
+
+    return mPlaneX[f] * mEye.x + mPlaneY[f] * mEye.y + mPlaneZ[f] * mEye.z - mPlaneD[f] > 0.0f;
+}
+
+
+void SilhouetteFins::fullUpdate(WorkerPool &workers) {
+
+    // Jobs work on whole SIMD blocks
+    unsigned int blocks = static_cast<unsigned int>(mFacing.size()) / SIMD_WIDTH;
+
+    workers.parallelFor(blocks, FACES_PER_JOB / SIMD_WIDTH, classifyJob, this);
+
+    for(unsigned int e = 0; e < mEdges.size(); e++)
+        testEdge(e);
+}
+
+
+void SilhouetteFins::incrementalUpdate() {
+
+    mStamp++;
+    mCandidates.clear();
+
+    // The faces on last frame's silhouette
+    for(unsigned int i = 0; i < mFins.size(); i++) {
+
+        const Edge &edge = mEdges[mFins[i]];
+
+        for(unsigned int j = 0; j < 2; j++) {
+            if(mFaceStamp[edge.faces[j]] != mStamp) {
+                mFaceStamp[edge.faces[j]] = mStamp;
+                mCandidates.push_back(edge.faces[j]);
+            }
+        }
+    }
+
+    // Plus their neighbours, so that both faces of every edge of the first ring are up to date
+    unsigned int ring = static_cast<unsigned int>(mCandidates.size());
+
+    for(unsigned int i = 0; i < ring; i++) {
+
+        unsigned int f = mCandidates[i];
+
+        for(unsigned int c = 0; c < 3; c++) {
+
+            unsigned int e = mFaceEdges[f * 3 + c];
+
+            if(e == NO_EDGE)
+                continue;
+
+            unsigned int neighbour = mEdges[e].faces[0] == f ? mEdges[e].faces[1] : mEdges[e].faces[0];
+
+            if(mFaceStamp[neighbour] != mStamp) {
+                mFaceStamp[neighbour] = mStamp;
+                mCandidates.push_back(neighbour);
+            }
+        }
+    }
+
+    for(unsigned int i = 0; i < mCandidates.size(); i++)
+        mFacing[mCandidates[i]] = facing(mCandidates[i]);
+
+    // The silhouette can move by one face in any direction
+    for(unsigned int i = 0; i < ring; i++) {
+
+        unsigned int f = mCandidates[i];
+
+        for(unsigned int c = 0; c < 3; c++) {
+
+            unsigned int e = mFaceEdges[f * 3 + c];
+
+            if(e != NO_EDGE && mEdgeStamp[e] != mStamp) {
+                mEdgeStamp[e] = mStamp;
+                testEdge(e);
+            }
+        }
+    }
+}
+
+
+void SilhouetteFins::testEdge(unsigned int e) {
+
+    bool silhouette = mFacing[mEdges[e].faces[0]] != mFacing[mEdges[e].faces[1]];
+
+    if(silhouette && mSlots[e] == NO_SLOT)
+        addFin(e);
+    else if(!silhouette && mSlots[e] != NO_SLOT)
+        removeFin(e);
+}
+
+
+void SilhouetteFins::addFin(unsigned int e) {
+
+    unsigned int slot = static_cast<unsigned int>(mFins.size());
+
+    mSlots[e] = slot;
+    mFins.push_back(e);
+
+    mFinIndices.push_back(mEdges[e].vertices[0]);
+    mFinIndices.push_back(mEdges[e].vertices[1]);
+
+    mDirtySlot = std::min(mDirtySlot, slot);
+}
+
+
+void SilhouetteFins::removeFin(unsigned int e) {
+
+    // The last fin takes the free slot, so the fins stay packed at the front of the buffer
+    unsigned int slot = mSlots[e];
+    unsigned int last = mFins.back();
+
+    mFins[slot]  = last;
+    mSlots[last] = slot;
+
+    mFinIndices[slot * 2]     = mFinIndices[mFinIndices.size() - 2];
+    mFinIndices[slot * 2 + 1] = mFinIndices[mFinIndices.size() - 1];
+
+    mFins.pop_back();
+    mFinIndices.pop_back();
+    mFinIndices.pop_back();
+
+    mSlots[e] = NO_SLOT;
+
+    mDirtySlot = std::min(mDirtySlot, slot);
+}
+
+
+void SilhouetteFins::upload() {
+
+    unsigned int count = static_cast<unsigned int>(mFins.size());
+
+    if(mDirtySlot < count) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, mDirtySlot * 2 * sizeof(GLuint), (count - mDirtySlot) * 2 * sizeof(GLuint), &mFinIndices[mDirtySlot * 2]);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    mDirtySlot = count;
+}
@@ -0,0 +1,215 @@
+#include <cstdio>
+
+#include "../include/TemporalAccumulator.h"
+
+namespace {
+
+    // Texture units of the resolve pass, the copy pass only uses the first
+    const GLuint COLOR_UNIT   = 0;
+    const GLuint DEPTH_UNIT   = 1;
+    const GLuint HISTORY_UNIT = 2;
+}
+
+
+// About the last four frames make up the result
+const float TemporalAccumulator::BLEND_FACTOR = 0.25f;
+
+
+TemporalAccumulator::TemporalAccumulator() {
+
+    for(int i = 0; i < 2; i++) {
+        historyFramebufferIDs[i] = 0;
+        historyTextureIDs[i]     = 0;
+    }
+}
+
+
+TemporalAccumulator::~TemporalAccumulator() {
+
+    glDeleteTextures(1, &colorTextureID);
+    glDeleteTextures(1, &depthTextureID);
+    glDeleteTextures(2, historyTextureIDs);
+    glDeleteFramebuffers(1, &sceneFramebufferID);
+    glDeleteFramebuffers(2, historyFramebufferIDs);
+    glDeleteRenderbuffers(1, &colorRenderbufferID);
+    glDeleteRenderbuffers(1, &depthRenderbufferID);
+    glDeleteFramebuffers(1, &multisampleFramebufferID);
+}
+
+
+void TemporalAccumulator::initialize(GLuint resolve, GLuint copy) {
+
+    resolveProgram = resolve;
+    copyProgram    = copy;
+
+    if(!isAvailable())
+        return;
+
+    glUseProgram(resolveProgram);
+    glUniform1i(glGetUniformLocation(resolveProgram, "colorSampler"),   COLOR_UNIT);
+    glUniform1i(glGetUniformLocation(resolveProgram, "depthSampler"),   DEPTH_UNIT);
+    glUniform1i(glGetUniformLocation(resolveProgram, "historySampler"), HISTORY_UNIT);
+
+    reprojectionLoc = glGetUniformLocation(resolveProgram, "reprojection");
+    blendFactorLoc  = glGetUniformLocation(resolveProgram, "blendFactor");
+    historyValidLoc = glGetUniformLocation(resolveProgram, "historyValid");
+
+    glUseProgram(copyProgram);
+    glUniform1i(glGetUniformLocation(copyProgram, "colorSampler"), COLOR_UNIT);
+
+    mPass.initialize(WIDTH, HEIGHT);
+
+    glGenFramebuffers(1, &sceneFramebufferID);
+    glGenFramebuffers(2, historyFramebufferIDs);
+    glGenFramebuffers(1, &multisampleFramebufferID);
+    glGenRenderbuffers(1, &colorRenderbufferID);
+    glGenRenderbuffers(1, &depthRenderbufferID);
+    glGenTextures(1, &colorTextureID);
+    glGenTextures(1, &depthTextureID);
+    glGenTextures(2, historyTextureIDs);
+
+    if(!resize(WIDTH, HEIGHT, 1))
+        resolveProgram = copyProgram = 0;
+}
+
+
+void TemporalAccumulator::begin(RenderState &state, int samples) {
+
+    // The history is reprojected pixel for pixel, it can't carry over to a new size. Nor to new
+    // samples, the edges would resolve differently. Resizing binds the textures directly, so the cache
+    // forgets its bindings.
+    bool resized = mPass.begin();
+
+    if(resized || samples != mSamples) {
+        resize(mPass.getWidth(), mPass.getHeight(), samples);
+        state.invalidateTextures();
+        mHistoryValid = false;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mSamples > 1 ? multisampleFramebufferID : sceneFramebufferID);
+    glViewport(0, 0, mPass.getWidth(), mPass.getHeight());
+
+    // Clears honor the masks, the clear color is the scene's
+    state.colorMask(GL_TRUE);
+    state.depthMask(GL_TRUE);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+
+void TemporalAccumulator::resolve(RenderState &state, const glm::mat4 &current, const glm::mat4 &previous) {
+
+    unsigned int next = 1 - mCurrentHistory;
+
+    // One color and depth per pixel for the reprojection. Depth can't be averaged, any one sample will do.
+    if(mSamples > 1) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, multisampleFramebufferID);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFramebufferID);
+        glBlitFramebuffer(0, 0, mPass.getWidth(), mPass.getHeight(), 0, 0, mPass.getWidth(), mPass.getHeight(), GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+
+    state.disable(GL_DEPTH_TEST);
+    state.disable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
+
+    // Current frame and reprojected history into the next history
+    glBindFramebuffer(GL_FRAMEBUFFER, historyFramebufferIDs[next]);
+
+    state.useProgram(resolveProgram);
+    state.bindTexture(COLOR_UNIT,   GL_TEXTURE_2D, colorTextureID);
+    state.bindTexture(DEPTH_UNIT,   GL_TEXTURE_2D, depthTextureID);
+    state.bindTexture(HISTORY_UNIT, GL_TEXTURE_2D, historyTextureIDs[mCurrentHistory]);
+
+    // From clip space of this frame to clip space of the last one, everything moves with the same matrices
+    glm::mat4 reprojection = previous * glm::inverse(current);
+
+    glUniformMatrix4fv(reprojectionLoc, 1, GL_FALSE, &reprojection[0][0]);
+    glUniform1f(blendFactorLoc, BLEND_FACTOR);
+    glUniform1i(historyValidLoc, mHistoryValid ? 1 : 0);
+
+    mPass.draw(state);
+
+    // The history is the picture
+    mPass.end();
+
+    state.useProgram(copyProgram);
+    state.bindTexture(COLOR_UNIT, GL_TEXTURE_2D, historyTextureIDs[next]);
+
+    mPass.draw(state);
+
+    mCurrentHistory = next;
+    mHistoryValid   = true;
+
+    // The passes were opaque copies, the tweak bar drawn over the picture and the skins of the next
+    // frame need depth testing and blending back on. Culling is up to whoever draws next.
+    state.enable(GL_DEPTH_TEST);
+    state.enable(GL_BLEND);
+}
+
+
+bool TemporalAccumulator::resize(int width, int height, int samples) {
+
+    mSamples = samples;
+
+    glBindTexture(GL_TEXTURE_2D, colorTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindTexture(GL_TEXTURE_2D, depthTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebufferID);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTextureID, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_TEXTURE_2D, depthTextureID, 0);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    // Same formats as the textures, a blit can't convert depth
+    if(mSamples > 1 && status == GL_FRAMEBUFFER_COMPLETE) {
+
+        glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbufferID);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, mSamples, GL_RGBA8, width, height);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbufferID);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, mSamples, GL_DEPTH_COMPONENT24, width, height);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, multisampleFramebufferID);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbufferID);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, depthRenderbufferID);
+
+        status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    }
+
+    // The history is sampled between pixels when reprojected, so it's filtered. Half floats keep small
+    // contributions from rounding away when the blend factor is low.
+    for(int i = 0; i < 2 && status == GL_FRAMEBUFFER_COMPLETE; i++) {
+
+        glBindTexture(GL_TEXTURE_2D, historyTextureIDs[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, historyFramebufferIDs[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historyTextureIDs[i], 0);
+
+        status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Temporal framebuffers incomplete, status: 0x%x\n", status);
+        return false;
+    }
+
+    return true;
+}
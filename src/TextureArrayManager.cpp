@@ -0,0 +1,131 @@
+#include <iostream>
+
+#include "../include/TextureArrayManager.h"
+
+
+TextureArrayManager::TextureArrayManager() {
+
+}
+
+
+TextureArrayManager::~TextureArrayManager() {
+
+    for(unsigned int i = 0; i < mArrays.size(); i++)
+        glDeleteTextures(1, &mArrays[i].texture);
+}
+
+
+TextureLayer TextureArrayManager::add(GLenum internalFormat, int width, int height, GLenum format, GLenum type,
+                                      const void *pixels, GLenum minFilter, GLenum magFilter, const std::string &name) {
+
+    if(!name.empty()) {
+
+        std::map<std::string, TextureLayer>::iterator named = mNamed.find(name);
+
+        if(named != mNamed.end())
+            return named->second;
+    }
+
+    TextureLayer result;
+
+    unsigned int bytes = bytesPerTexel(format, type);
+
+    if(!pixels || width <= 0 || height <= 0 || bytes == 0)
+        return result;
+
+    // The array of textures like this one, arrays that are built already can't take more layers
+    unsigned int a = 0;
+
+    for(; a < mArrays.size(); a++) {
+
+        const Array &array = mArrays[a];
+
+        if(!array.built && array.internalFormat == internalFormat && array.format == format && array.type == type &&
+           array.width == width && array.height == height && array.minFilter == minFilter && array.magFilter == magFilter)
+            break;
+    }
+
+    if(a == mArrays.size()) {
+
+        Array array;
+        array.internalFormat = internalFormat;
+        array.format         = format;
+        array.type           = type;
+        array.width          = width;
+        array.height         = height;
+        array.minFilter      = minFilter;
+        array.magFilter      = magFilter;
+        array.built          = false;
+        array.layerCount     = 0;
+
+        // Named now so that the layer can be handed out, the storage comes in build()
+        glGenTextures(1, &array.texture);
+
+        mArrays.push_back(array);
+    }
+
+    Array &array = mArrays[a];
+
+    const unsigned char *begin = static_cast<const unsigned char *>(pixels);
+
+    array.layers.push_back(std::vector<unsigned char>(begin, begin + static_cast<std::size_t>(width) * height * bytes));
+
+    result.texture = array.texture;
+    result.layer   = static_cast<GLint>(array.layerCount++);
+
+    if(!name.empty())
+        mNamed[name] = result;
+
+    return result;
+}
+
+
+void TextureArrayManager::build() {
+
+    // Rows are tightly packed whatever the width
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for(unsigned int a = 0; a < mArrays.size(); a++) {
+
+        Array &array = mArrays[a];
+
+        if(array.built)
+            continue;
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, array.internalFormat, array.width, array.height, array.layerCount, 0, array.format, array.type, NULL);
+
+        for(unsigned int l = 0; l < array.layerCount; l++)
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, l, array.width, array.height, 1, array.format, array.type, &array.layers[l][0]);
+
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, array.minFilter);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, array.magFilter);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+
+        std::vector<std::vector<unsigned char> >().swap(array.layers);
+        array.built = true;
+
+        std::cout << "Texture array " << array.width << " x " << array.height << ": " << array.layerCount << " layers" << std::endl;
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+
+unsigned int TextureArrayManager::bytesPerTexel(GLenum format, GLenum type) {
+
+    // Only the unsigned byte formats the geometries use
+    if(type != GL_UNSIGNED_BYTE)
+        return 0;
+
+    switch(format) {
+        case GL_RED:  return 1;
+        case GL_RG:   return 2;
+        case GL_RGB:
+        case GL_BGR:  return 3;
+        case GL_RGBA:
+        case GL_BGRA: return 4;
+        default:      return 0;
+    }
+}
@@ -0,0 +1,153 @@
+#include <cstdio>
+
+#include "../include/WeightedOIT.h"
+
+namespace {
+
+    // Texture units of the composite pass
+    const GLuint ACCUMULATION_UNIT = 0;
+    const GLuint WEIGHT_UNIT       = 1;
+}
+
+
+WeightedOIT::WeightedOIT() {
+
+}
+
+
+WeightedOIT::~WeightedOIT() {
+
+    glDeleteTextures(1, &accumulationTextureID);
+    glDeleteTextures(1, &weightTextureID);
+    glDeleteTextures(1, &depthTextureID);
+    glDeleteFramebuffers(1, &framebufferID);
+}
+
+
+void WeightedOIT::initialize(GLuint program) {
+
+    compositeProgram = program;
+
+    if(!compositeProgram)
+        return;
+
+    glUseProgram(compositeProgram);
+    glUniform1i(glGetUniformLocation(compositeProgram, "accumulationSampler"), ACCUMULATION_UNIT);
+    glUniform1i(glGetUniformLocation(compositeProgram, "weightSampler"),       WEIGHT_UNIT);
+
+    mPass.initialize(WIDTH, HEIGHT);
+
+    glGenFramebuffers(1, &framebufferID);
+    glGenTextures(1, &accumulationTextureID);
+    glGenTextures(1, &weightTextureID);
+    glGenTextures(1, &depthTextureID);
+
+    if(!resize(WIDTH, HEIGHT))
+        compositeProgram = 0;
+}
+
+
+void WeightedOIT::begin(RenderState &state) {
+
+    // The composite reads the sums pixel for pixel, so they have the size of the framebuffer they go over.
+    // Resizing binds the textures directly, on whatever unit is active, so the cache forgets its bindings.
+    if(mPass.begin()) {
+        resize(mPass.getWidth(), mPass.getHeight());
+        state.invalidateTextures();
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+    glViewport(0, 0, mPass.getWidth(), mPass.getHeight());
+
+    // Clears honor the masks
+    state.colorMask(GL_TRUE);
+    state.depthMask(GL_TRUE);
+
+    // Nothing added yet, and everything behind fully revealed
+    const GLfloat accumulation[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    const GLfloat weight[]       = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const GLfloat depth          = 1.0f;
+
+    glClearBufferfv(GL_COLOR, 0, accumulation);
+    glClearBufferfv(GL_COLOR, 1, weight);
+    glClearBufferfv(GL_DEPTH, 0, &depth);
+}
+
+
+void WeightedOIT::accumulate(RenderState &state) {
+
+    state.colorMask(GL_TRUE);
+    state.depthMask(GL_FALSE);
+    state.enable(GL_DEPTH_TEST);
+    state.enable(GL_BLEND);
+
+    // Color and weights are summed, the alpha of the accumulation target becomes the product of (1 - alpha)
+    state.blendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+
+void WeightedOIT::composite(RenderState &state) {
+
+    mPass.end();
+
+    state.disable(GL_DEPTH_TEST);
+    state.disable(GL_CULL_FACE);
+    state.enable(GL_BLEND);
+
+    // The shader outputs the average color with the revealage as alpha: color * (1 - r) + background * r
+    state.blendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+
+    state.useProgram(compositeProgram);
+    state.bindTexture(ACCUMULATION_UNIT, GL_TEXTURE_2D, accumulationTextureID);
+    state.bindTexture(WEIGHT_UNIT,       GL_TEXTURE_2D, weightTextureID);
+
+    mPass.draw(state);
+
+    // accumulate() stopped the depth writes and changed the blend function for the sums, the skins of
+    // the next frame write depth and the tweak bar blends with the usual function
+    state.depthMask(GL_TRUE);
+    state.enable(GL_DEPTH_TEST);
+    state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+
+bool WeightedOIT::resize(int width, int height) {
+
+    // Half floats, the weights reach into the thousands and the sums go past one
+    glBindTexture(GL_TEXTURE_2D, accumulationTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindTexture(GL_TEXTURE_2D, weightTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // Own depth, the opaque surfaces are drawn into it again so the transparent ones can be tested against them
+    glBindTexture(GL_TEXTURE_2D, depthTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulationTextureID, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weightTextureID, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_TEXTURE_2D, depthTextureID, 0);
+
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "OIT framebuffer incomplete, status: 0x%x\n", status);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cmath>
+
+#include "../include/WindField.h"
+#include "../include/utils/Simplexnoise1234.h"
+
+// SSE is everywhere on x86, other targets take the scalar path
+#if defined(__SSE__) || defined(_M_X64)
+#define FUR_SIMD
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+    // Spatial frequency of the turbulence, and how fast it drifts through the volume
+    const float FREQUENCY   = 0.6f;
+    const float DRIFT_SPEED = 0.3f;
+
+    // Strength of the turbulence relative to the base wind
+    const float TURBULENCE  = 6.0f;
+}
+
+
+// The volume covers [-2, 2] in every direction, enough for all the meshes
+const float WindField::ORIGIN = -2.0f;
+const float WindField::EXTENT = 4.0f;
+
+
+WindField::WindField() {
+
+}
+
+
+WindField::~WindField() {
+
+    if(mThread.joinable()) {
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQuit = true;
+        }
+
+        mWake.notify_one();
+        mThread.join();
+    }
+
+    glDeleteTextures(1, &textureID);
+}
+
+
+void WindField::initialize(float time, float velocity) {
+
+    const int cells     = RESOLUTION * RESOLUTION * RESOLUTION;
+    const int potential = POTENTIAL_RESOLUTION * POTENTIAL_RESOLUTION * POTENTIAL_RESOLUTION;
+
+    mPotentialX.assign(potential, 0.0f);
+    mPotentialY.assign(potential, 0.0f);
+    mPotentialZ.assign(potential, 0.0f);
+
+    mFront.assign(cells * 3, 0.0f);
+    mBack.assign(cells * 3, 0.0f);
+
+    // The first field is solved right away, so that there is something to sample
+    solve(time, velocity, mFront);
+
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_3D, textureID);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, RESOLUTION, RESOLUTION, RESOLUTION, 0, GL_RGB, GL_FLOAT, &mFront[0]);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    mThread = std::thread(&WindField::workerLoop, this);
+}
+
+
+void WindField::update(float time, float velocity) {
+
+    bool published = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // The worker is idle once it's ready, so the back buffer is ours to take
+        if(mReady) {
+            std::swap(mFront, mBack);
+            mReady = false;
+            published = true;
+        }
+
+        if(!mRequested) {
+            mRequestTime     = time;
+            mRequestVelocity = velocity;
+            mRequested       = true;
+        }
+    }
+
+    mWake.notify_one();
+
+    if(published) {
+        glBindTexture(GL_TEXTURE_3D, textureID);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, RESOLUTION, RESOLUTION, RESOLUTION, GL_RGB, GL_FLOAT, &mFront[0]);
+        glBindTexture(GL_TEXTURE_3D, 0);
+    }
+}
+
+
+glm::vec3 WindField::sample(const glm::vec3 &position) const {
+
+    // Same addressing as linear filtering with clamp to edge: texel centers at (i + 0.5) / RESOLUTION
+    float f[3];
+    int   i[3];
+
+    for(int a = 0; a < 3; a++) {
+        f[a] = std::min(std::max((position[a] - ORIGIN) / EXTENT * RESOLUTION - 0.5f, 0.0f), RESOLUTION - 1.0f);
+        i[a] = std::min(static_cast<int>(f[a]), RESOLUTION - 2);
+        f[a] -= i[a];
+    }
+
+    const int strideY = RESOLUTION * 3;
+    const int strideZ = RESOLUTION * RESOLUTION * 3;
+
+    const float *c = &mFront[i[2] * strideZ + i[1] * strideY + i[0] * 3];
+
+    glm::vec3 result(0.0f);
+
+    for(int corner = 0; corner < 8; corner++) {
+
+        int dx = corner & 1, dy = (corner >> 1) & 1, dz = corner >> 2;
+
+        float weight = (dx ? f[0] : 1.0f - f[0]) * (dy ? f[1] : 1.0f - f[1]) * (dz ? f[2] : 1.0f - f[2]);
+
+        const float *v = c + dz * strideZ + dy * strideY + dx * 3;
+
+        result += glm::vec3(v[0], v[1], v[2]) * weight;
+    }
+
+    return result;
+}
+
+
+void WindField::workerLoop() {
+
+    for(;;) {
+
+        float time, velocity;
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [this]() { return mQuit || (mRequested && !mReady); });
+
+            if(mQuit)
+                return;
+
+            time     = mRequestTime;
+            velocity = mRequestVelocity;
+        }
+
+        solve(time, velocity, mBack);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mReady     = true;
+        mRequested = false;
+    }
+}
+
+
+void WindField::solve(float t, float velocity, std::vector<float> &field) {
+
+    const int   P = POTENTIAL_RESOLUTION;
+    const int   N = RESOLUTION;
+    const float h = EXTENT / RESOLUTION;
+
+    // Gusting base wind, the curve the fur vertex shader used to apply to every vertex
+    float baseX = sin(t * 3.0f + cos(snoise2(t, t * 0.2f)) * 0.5f) * 8.0f * velocity;
+    float baseY = cos(t * 2.0f + sin(snoise2(t * 0.05f, t)) * 0.5f) * 8.0f * velocity;
+    float baseZ = 0.0f;
+
+    // Vector potential at the cell centers plus a border, drifting through the volume over time
+    float driftX = t * DRIFT_SPEED;
+    float driftY = t * DRIFT_SPEED * 0.5f;
+    float driftZ = t * DRIFT_SPEED * 0.7f;
+
+    for(int z = 0; z < P; z++) {
+        for(int y = 0; y < P; y++) {
+            for(int x = 0; x < P; x++) {
+
+                float px = (ORIGIN + (x - 0.5f) * h) * FREQUENCY - driftX;
+                float py = (ORIGIN + (y - 0.5f) * h) * FREQUENCY - driftY;
+                float pz = (ORIGIN + (z - 0.5f) * h) * FREQUENCY - driftZ;
+
+                int index = (z * P + y) * P + x;
+
+                // Unrelated noise per component, by sampling far apart
+                mPotentialX[index] = snoise3(px,         py,         pz);
+                mPotentialY[index] = snoise3(px + 31.4f, py - 17.1f, pz + 5.3f);
+                mPotentialZ[index] = snoise3(px - 11.7f, py + 43.9f, pz - 23.5f);
+            }
+        }
+    }
+
+    // Velocity is the base plus the curl of the potential, divergence free by construction
+    const float scale = TURBULENCE * velocity / (2.0f * h);
+
+    const float *ax = &mPotentialX[0];
+    const float *ay = &mPotentialY[0];
+    const float *az = &mPotentialZ[0];
+
+    for(int z = 0; z < N; z++) {
+        for(int y = 0; y < N; y++) {
+
+            // Center of the row in the potential grid, and the neighbours in each direction
+            int row = ((z + 1) * P + (y + 1)) * P + 1;
+            int sy  = P;
+            int sz  = P * P;
+
+            float *out = &field[((z * N) + y) * N * 3];
+
+#ifdef FUR_SIMD
+
+            const __m128 s  = _mm_set1_ps(scale);
+            const __m128 bx = _mm_set1_ps(baseX), by = _mm_set1_ps(baseY), bz = _mm_set1_ps(baseZ);
+
+            for(int x = 0; x < N; x += 4) {
+
+                int c = row + x;
+
+                __m128 cx = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(az + c + sy), _mm_loadu_ps(az + c - sy)),
+                                       _mm_sub_ps(_mm_loadu_ps(ay + c + sz), _mm_loadu_ps(ay + c - sz)));
+                __m128 cy = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(ax + c + sz), _mm_loadu_ps(ax + c - sz)),
+                                       _mm_sub_ps(_mm_loadu_ps(az + c + 1),  _mm_loadu_ps(az + c - 1)));
+                __m128 cz = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(ay + c + 1),  _mm_loadu_ps(ay + c - 1)),
+                                       _mm_sub_ps(_mm_loadu_ps(ax + c + sy), _mm_loadu_ps(ax + c - sy)));
+
+                float vx[4], vy[4], vz[4];
+                _mm_storeu_ps(vx, _mm_add_ps(bx, _mm_mul_ps(cx, s)));
+                _mm_storeu_ps(vy, _mm_add_ps(by, _mm_mul_ps(cy, s)));
+                _mm_storeu_ps(vz, _mm_add_ps(bz, _mm_mul_ps(cz, s)));
+
+                // Interleave for the RGB texture
+                for(int i = 0; i < 4; i++) {
+                    out[(x + i) * 3]     = vx[i];
+                    out[(x + i) * 3 + 1] = vy[i];
+                    out[(x + i) * 3 + 2] = vz[i];
+                }
+            }
+
+#else
+
+            for(int x = 0; x < N; x++) {
+
+                int c = row + x;
+
+                out[x * 3]     = baseX + ((az[c + sy] - az[c - sy]) - (ay[c + sz] - ay[c - sz])) * scale;
+                out[x * 3 + 1] = baseY + ((ax[c + sz] - ax[c - sz]) - (az[c + 1]  - az[c - 1]))  * scale;
+                out[x * 3 + 2] = baseZ + ((ay[c + 1]  - ay[c - 1])  - (ax[c + sy] - ax[c - sy])) * scale;
+            }
+
+#endif
+        }
+    }
+}
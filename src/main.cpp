@@ -3,11 +3,15 @@
 #include <iostream>
 #include <math.h>
 #include <vector>
+#include <cstring>
 
 #include <AntTweakBar.h>
 
 #include "../include/Scene.h"
 #include "../include/Geometry.h"
+#include "../include/utils/Framebuffer.h"
+#include "../include/utils/Regression.h"
+#include "../include/utils/AllocStats.h"
 
 
 // functions
@@ -17,9 +21,23 @@ void mouseButton(GLFWwindow *, int, int, int);
 void mouseMotion(GLFWwindow *, double, double);
 void mouseScroll(GLFWwindow *, double, double);
 void keyboardInput(GLFWwindow *, int, int, int, int);
-double calculateFPS(double, std::string);
+double calculateFPS(double, const char *);
 void loadGeometryData();
 void updateTweakBarVariables();
+std::vector<FurInstance> createField(int);
+void TW_CALL setFloatParameter(const void *, void *);
+void TW_CALL getFloatParameter(void *, void *);
+void TW_CALL setColorParameter(const void *, void *);
+void TW_CALL getColorParameter(void *, void *);
+void TW_CALL setIntParameter(const void *, void *);
+void TW_CALL getIntParameter(void *, void *);
+void parseArguments(int, char **);
+int runRegression();
+void renderRegressionFrame();
+double measureFrameTime();
+void benchmarkShellBlending();
+void benchmarkField();
+void printCounters();
 
 
 // AntTweakBar variables
@@ -31,13 +49,37 @@ TwEnumVal MeshesEV[] = { {SPHERE, "Sphere"}, {TORUS, "Torus"}, {PLANE, "Plane"},
 TwType meshType;
 
 // For noise types
-NoiseType currentNoise = SIMPLEX;
 TwEnumVal NoiseTypesEV[] = { { SIMPLEX, "Simplex" }, { WORLEY, "Worley" } };
 TwType noiseType;
 
-// Variables for the tweakBar
-float furLength, specularity, transparency, shinyness, furNoiseLengthVariation, furNoiseSampleScale, furPatternScale;
-glm::vec3 skinColor, ambientColor, diffuseColor, specularColor, furColor;
+// For fur dynamics modes
+TwEnumVal DynamicsModesEV[] = { { CPU_DYNAMICS, "CPU" }, { GPU_DYNAMICS, "GPU" } };
+TwType dynamicsMode;
+
+// For the shell geometry
+TwEnumVal FurPathsEV[] = { { VERTEX_SHELLS, "Mesh LOD" }, { TESSELLATED_SHELLS, "Tessellation" } };
+TwType furPath;
+
+// For how the shells are composited
+TwEnumVal ShellBlendingEV[] = { { BLENDED_SHELLS, "Blend" }, { ALPHA_TO_COVERAGE_SHELLS, "Alpha to coverage" }, { WEIGHTED_OIT_SHELLS, "Weighted OIT" } };
+TwType shellBlending;
+
+// For the resolution of the fur
+TwEnumVal FurDownsamplesEV[] = { { 1, "Full" }, { 2, "Half" }, { 4, "Quarter" } };
+TwType furDownsample;
+
+// Parameter block the tweakBar writes to, every write bumps its version
+FurParameters tweakParameters;
+
+// Version and mesh that the block was last pushed to
+unsigned int pushedVersion = UNINITIALIZED;
+Geometry * pushedMesh = nullptr;
+
+// Copies of the selected mesh in the field demo, 1 is the mesh on its own. The field is only
+// rebuilt when the size or the mesh changes.
+int fieldSize = 1;
+int pushedFieldSize = 1;
+Geometry * fieldMesh = nullptr;
 
 
 
@@ -63,12 +105,38 @@ Geometry * bunny = nullptr;
 Geometry * teapot = nullptr;
 
 // Global variables
-std::string windowTitle = "Rasmus Volumetric Fur Demo";
+const char * windowTitle = "Rasmus Volumetric Fur Demo";
 
 std::map<std::string, std::vector<std::string>> geometryData;
 
+// Regression mode settings, see parseArguments()
+bool regressionMode = false;
+
+bool updateGolden = false;
+
+float imageThreshold = 0.1f;          // Perceptual delta (0-1) before a pixel counts as changed
+
+float maxMismatchFraction = 0.005f;   // Fraction of changed pixels allowed per scene
+
+float frameTimeTolerance = 20.0f;     // Allowed frame time regression in percent
 
-int main() {
+bool shellBenchmark = false;          // Also compare the shell blending modes, and time the largest field
+
+const float REGRESSION_TIME = 1.0f;
+
+const int REGRESSION_WARMUP_FRAMES = 5;
+
+const int REGRESSION_FRAMES = 30;
+
+// The field demo is a square grid of small copies, turned and tinted at random, at most MAX_FIELD_SIZE
+const float FIELD_SPACING = 0.6f;
+
+const float FIELD_SCALE = 0.2f;
+
+
+int main(int argc, char **argv) {
+
+    parseArguments(argc, argv);
 
     // Magic
     glewExperimental = GL_TRUE;
@@ -101,12 +169,30 @@ int main() {
 
     scene->addShaderPair("shaders/phongvertexshader.glsl", "shaders/phongfragmentshader.glsl");
     scene->addShaderPair("shaders/furvertexshader.glsl", "shaders/furfragmentshader.glsl");
+    scene->setDynamicsShader("shaders/furdynamicsvertexshader.glsl");
+    scene->setTessellationShaders("shaders/furtessvertexshader.glsl", "shaders/furtesscontrolshader.glsl", "shaders/furtessevaluationshader.glsl");
+    scene->setCompositeShaders("shaders/fullscreenvertexshader.glsl", "shaders/oitcompositefragmentshader.glsl");
+    scene->setUpsampleShaders("shaders/fullscreenvertexshader.glsl", "shaders/furupsamplefragmentshader.glsl");
+    scene->setFinShaders("shaders/finvertexshader.glsl", "shaders/fingeometryshader.glsl", "shaders/finfragmentshader.glsl");
+    scene->setCullShader("shaders/meshletcullcomputeshader.glsl");
+    scene->setTemporalShaders("shaders/fullscreenvertexshader.glsl", "shaders/temporalresolvefragmentshader.glsl", "shaders/copyfragmentshader.glsl");
 
     // Initialize scene
     scene->initialize();
 
     mesh = torus;
 
+    // Render the fixed scenes offscreen and compare them to the golden images, then quit
+    if(regressionMode) {
+
+        int result = runRegression();
+
+        delete scene;
+        glfwTerminate();
+
+        return result;
+    }
+
     // Initialze AntTweakBar
     initializeAntTweakBar();
 
@@ -128,8 +214,8 @@ int main() {
 
         time = static_cast<float>(glfwGetTime());
 
-        scene->update(time - previousTime);
         scene->setCurrentTime(time);
+        scene->update(time - previousTime);
         
         updateTweakBarVariables();
 
@@ -145,6 +231,9 @@ int main() {
         glfwSwapBuffers(window);
         glfwPollEvents();
 
+        GLStats::endFrame();
+        AllocStats::endFrame();
+
     } // Check if the ESC key was pressed or the window was closed
     while ( glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
            glfwWindowShouldClose(window) == 0 );
@@ -175,8 +264,13 @@ int initializeOpenGL() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_SAMPLES, MSAA_SAMPLES);
+
+    // Nothing is presented in regression mode, everything goes to an offscreen framebuffer
+    if(regressionMode)
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
 
-    window = glfwCreateWindow( WIDTH, HEIGHT, windowTitle.c_str(), NULL, NULL);
+    window = glfwCreateWindow( WIDTH, HEIGHT, windowTitle, NULL, NULL);
 
     if( window == NULL ){
 
@@ -220,18 +314,12 @@ void initializeAntTweakBar() {
 
     noiseType = TwDefineEnum("NoiseType", NoiseTypesEV, 2);
 
-    furLength               = mesh->getFurLength();
-    skinColor               = mesh->getColor();
-    ambientColor            = mesh->getAmbient();
-    diffuseColor            = mesh->getDiffuse();
-    specularColor           = mesh->getSpecular();
-    furColor                = mesh->getFurColor();
-    specularity             = mesh->getSpecularity();
-    transparency            = mesh->getTransparency();
-    shinyness               = mesh->getShinyness();
-    furNoiseLengthVariation = mesh->getFurNoiseLengthVariation();
-    furNoiseSampleScale     = mesh->getFurNoiseSampleScale();
-    furPatternScale         = mesh->getFurPatternScale();
+    dynamicsMode = TwDefineEnum("DynamicsMode", DynamicsModesEV, 2);
+    furPath      = TwDefineEnum("FurPath", FurPathsEV, 2);
+    shellBlending = TwDefineEnum("ShellBlending", ShellBlendingEV, 3);
+    furDownsample = TwDefineEnum("FurDownsample", FurDownsamplesEV, 3);
+
+    tweakParameters = mesh->getParameters();
 
 
     // Mesh to be rendered
@@ -244,6 +332,15 @@ void initializeAntTweakBar() {
             NULL
         );
 
+    // Copies of the mesh, all drawn with the same draw calls
+    TwAddVarRW(
+            tweakbar,
+            "Field size",
+            TW_TYPE_INT32,
+            &fieldSize,
+            " group='Scene' label='Field size' min=1 max=5000 step=100 help='Instances of the mesh on a grid, each with its own transform, fur tint and noise' "
+        );
+
     // Light source power
     TwAddVarRW(
             tweakbar, 
@@ -263,115 +360,344 @@ void initializeAntTweakBar() {
         );
 
     // Main color of material
-    TwAddVarRW(tweakbar, 
+    TwAddVarCB(tweakbar, 
             "Color", 
             TW_TYPE_COLOR3F, 
-            &skinColor,
+            setColorParameter,
+            getColorParameter,
+            &tweakParameters.color,
             " group='Material' label='Color' "
         );
 
     // Ambient component
-    TwAddVarRW(tweakbar, 
+    TwAddVarCB(tweakbar, 
             "Ambient", 
             TW_TYPE_COLOR3F, 
-            &ambientColor, 
+            setColorParameter,
+            getColorParameter,
+            &tweakParameters.ambient, 
             " group='Material' label='Ambient' "
         );
 
     // Diffuse component
-    TwAddVarRW(tweakbar, 
+    TwAddVarCB(tweakbar, 
             "Diffuse", 
             TW_TYPE_COLOR3F, 
-            &diffuseColor, 
+            setColorParameter,
+            getColorParameter,
+            &tweakParameters.diffuse, 
             " group='Material' label='Diffuse' "
         );
 
     // Specular component
-    TwAddVarRW(tweakbar, 
+    TwAddVarCB(tweakbar, 
             "Specular", 
             TW_TYPE_COLOR3F, 
-            &specularColor, 
+            setColorParameter,
+            getColorParameter,
+            &tweakParameters.specular, 
             " group='Material' label='Specular' "
         );
 
     // Specularity of material
-    TwAddVarRW(
+    TwAddVarCB(
             tweakbar, 
             "Specularity", 
             TW_TYPE_FLOAT, 
-            &specularity,
+            setFloatParameter,
+            getFloatParameter,
+            &tweakParameters.specularity,
             " group='Material' label='Specularity' min=1 max=50 step=1 help='Specularity of material' "
         );
 
     // Shinyness of material
-    TwAddVarRW(
+    TwAddVarCB(
             tweakbar, 
             "Shinyness", 
             TW_TYPE_FLOAT, 
-            &shinyness,
+            setFloatParameter,
+            getFloatParameter,
+            &tweakParameters.shinyness,
             " group='Material' label='Shinyness' min=0 max=1 step=0.01 help='Shinyness of material' "
         );
 
     // Transparency of material
-    TwAddVarRW(
+    TwAddVarCB(
             tweakbar, 
             "Transparency", 
             TW_TYPE_FLOAT, 
-            &transparency,
+            setFloatParameter,
+            getFloatParameter,
+            &tweakParameters.transparency,
             " group='Material' label='Transparency' min=0 max=1 step=0.01 help='Transparency of material' "
         );
 
     // Fur main color
-    TwAddVarRW(tweakbar, 
+    TwAddVarCB(tweakbar, 
             "Fur Color", 
             TW_TYPE_COLOR3F, 
-            &furColor,
+            setColorParameter,
+            getColorParameter,
+            &tweakParameters.furColor,
             " group='Fur' label='Fur Color' "
         );
 
     // Fur length
-    TwAddVarRW(
+    TwAddVarCB(
             tweakbar, 
             "Length", 
             TW_TYPE_FLOAT, 
-            &furLength,
+            setFloatParameter,
+            getFloatParameter,
+            &tweakParameters.furLength,
             " group='Fur' label='Length' min=0.1 max=0.5 step=0.005 help='Length of fur' "
         );
 
     // Fur length variation
-    TwAddVarRW(
+    TwAddVarCB(
             tweakbar, 
             "Length Variation", 
             TW_TYPE_FLOAT, 
-            &furNoiseLengthVariation,
+            setFloatParameter,
+            getFloatParameter,
+            &tweakParameters.furNoiseLengthVariation,
             " group='Fur' label='Length Variation' min=0.0 max=0.5 step=0.01 help='Length variation of fur strands' "
         );
 
     // Fur length variation sample scale
-    TwAddVarRW(
+    TwAddVarCB(
             tweakbar, 
             "Length Variation Sample Scale", 
             TW_TYPE_FLOAT, 
-            &furNoiseSampleScale,
+            setFloatParameter,
+            getFloatParameter,
+            &tweakParameters.furNoiseSampleScale,
             " group='Fur' label='Length Variation Sample Scale' min=0.5 max=20.0 step=0.1 help='Sample scale of length variation noise' "
         );
 
     // Fur length variation sample scale
-    TwAddVarRW(
+    TwAddVarCB(
             tweakbar, 
             "Scale of the fur pattern", 
             TW_TYPE_FLOAT, 
-            &furPatternScale,
+            setFloatParameter,
+            getFloatParameter,
+            &tweakParameters.furPatternScale,
             " group='Fur' label='Pattern scale' min=0.0 max=20.0 step=0.1 help='Scale of the fur pattern' "
         );
 
-    TwAddVarRW(
+    TwAddVarCB(
             tweakbar,
             "Noise type",
             noiseType,
-            &currentNoise,
+            setIntParameter,
+            getIntParameter,
+            &tweakParameters.noiseType,
             " group='Fur' label='Noise type' help='Type of noise function' "
         );
+
+    // Where the fur dynamics run
+    TwAddVarRW(
+            tweakbar,
+            "Dynamics mode",
+            dynamicsMode,
+            &scene->getDynamicsMode(),
+            " group='Dynamics' label='Mode' help='Simulate the fur on the CPU or with transform feedback on the GPU' "
+        );
+
+    // Spring stiffness of the fur strands
+    TwAddVarCB(
+            tweakbar,
+            "Stiffness",
+            TW_TYPE_FLOAT,
+            setFloatParameter,
+            getFloatParameter,
+            &tweakParameters.furStiffness,
+            " group='Dynamics' label='Stiffness' min=10 max=300 step=5 help='Spring stiffness of the fur strands' "
+        );
+
+    // Damping of the fur strands
+    TwAddVarCB(
+            tweakbar,
+            "Damping",
+            TW_TYPE_FLOAT,
+            setFloatParameter,
+            getFloatParameter,
+            &tweakParameters.furDamping,
+            " group='Dynamics' label='Damping' min=0 max=40 step=0.5 help='Damping of the fur strands' "
+        );
+
+    // Level of detail for the fur shells
+    TwAddVarRW(
+            tweakbar,
+            "Shell LOD",
+            TW_TYPE_BOOLCPP,
+            &scene->getShellLOD(),
+            " group='Fur' label='Shell LOD' help='Draw fewer shells when the fur is small on screen' "
+        );
+
+    // Shells actually drawn last frame
+    TwAddVarRO(
+            tweakbar,
+            "Shells drawn",
+            TW_TYPE_UINT32,
+            &scene->getShellsDrawn(),
+            " group='Fur' label='Shells drawn' help='Fur shells drawn last frame, over all meshes' "
+        );
+
+    // Blending or alpha to coverage with depth writes for the shells
+    TwAddVarRW(
+            tweakbar,
+            "Shell blending",
+            shellBlending,
+            &scene->getShellBlending(),
+            " group='Fur' label='Shell blending' help='Alpha to coverage writes depth and lets early-Z skip fur hidden under outer shells, needs multisampling. Weighted OIT is correct in any draw order, also for overlapping meshes' "
+        );
+
+    // Resolution of the blended fur
+    TwAddVarRW(
+            tweakbar,
+            "Fur resolution",
+            furDownsample,
+            &scene->getFurDownsample(),
+            " group='Fur' label='Fur resolution' help='Draw blended fur at a fraction of the resolution and upsample it along the skin depth' "
+        );
+
+    // Jittered shells accumulated over frames
+    TwAddVarRW(
+            tweakbar,
+            "Temporal shells",
+            TW_TYPE_BOOLCPP,
+            &scene->getTemporalShells(),
+            " group='Fur' label='Temporal shells' help='Jitter the shell heights every frame and accumulate the frames, four times the shells when the camera is slow' "
+        );
+
+    // Fins on the silhouettes
+    TwAddVarRW(
+            tweakbar,
+            "Fins",
+            TW_TYPE_BOOLCPP,
+            &scene->getFins(),
+            " group='Fur' label='Fins' help='Extrude textured fins from the silhouette edges, covers grazing views with fewer shells' "
+        );
+
+    // Silhouette edges drawn as fins last frame
+    TwAddVarRO(
+            tweakbar,
+            "Fins drawn",
+            TW_TYPE_UINT32,
+            &scene->getFinsDrawn(),
+            " group='Fur' label='Fins drawn' help='Fins the geometry shader emitted for the silhouette edges, over all meshes, from a few frames ago' "
+        );
+
+    // Tessellated shells, only offered when the GL can do them
+    if(scene->hasTessellation()) {
+        TwAddVarRW(
+                tweakbar,
+                "Shell geometry",
+                furPath,
+                &scene->getFurPath(),
+                " group='Fur' label='Shell geometry' help='Simplified meshes, or coarse patches tessellated by screen size and curvature' "
+            );
+    }
+
+    // Meshlet culling on the GPU, only offered when the GL can do it
+    if(scene->hasMeshletCulling()) {
+        TwAddVarRW(
+                tweakbar,
+                "GPU culling",
+                TW_TYPE_BOOLCPP,
+                &scene->getMeshletCulling(),
+                " group='Fur' label='GPU culling' help='Cull the shell meshlets against the view and by their normals in a compute shader, and draw the rest indirectly' "
+            );
+    }
+
+    // Level of detail for the meshes
+    TwAddVarRW(
+            tweakbar,
+            "Mesh LOD",
+            TW_TYPE_BOOLCPP,
+            &scene->getMeshLOD(),
+            " group='Fur' label='Mesh LOD' help='Draw simplified meshes when they are small on screen' "
+        );
+
+    // Triangles actually drawn last frame
+    TwAddVarRO(
+            tweakbar,
+            "Triangles drawn",
+            TW_TYPE_UINT32,
+            &scene->getTrianglesDrawn(),
+            " group='Fur' label='Triangles drawn' help='Skin and shell triangles drawn last frame, over all meshes' "
+        );
+
+    // Triangles the shells skip because the hair map has no fur on them
+    TwAddVarRO(
+            tweakbar,
+            "Bald triangles",
+            TW_TYPE_FLOAT,
+            &scene->getBaldFraction(),
+            " group='Fur' label='Bald triangles' precision=3 help='Fraction of the mesh triangles without fur in the hair map, only the skin draws them' "
+        );
+
+    // Copies of the meshes drawn
+    TwAddVarRO(
+            tweakbar,
+            "Instances drawn",
+            TW_TYPE_UINT32,
+            &scene->getInstancesDrawn(),
+            " group='Fur' label='Instances drawn' help='Instances of the shown meshes drawn last frame, those out of view are culled one by one' "
+        );
+
+    // Meshes skipped because they are out of view
+    TwAddVarRO(
+            tweakbar,
+            "Meshes culled",
+            TW_TYPE_UINT32,
+            &scene->getGeometriesCulled(),
+            " group='Fur' label='Meshes culled' help='Shown meshes outside the view last frame, with the fur added to their bounds' "
+        );
+
+    // Time spent integrating the fur last frame
+    TwAddVarRO(
+            tweakbar,
+            "Dynamics time",
+            TW_TYPE_FLOAT,
+            &scene->getDynamicsTime(),
+            " group='Dynamics' label='CPU time (ms)' precision=3 help='CPU time spent in the fur dynamics last frame' "
+        );
+
+    // Quality governor, holds the frame time budget by trading fur quality
+    QualityGovernor &governor = scene->getGovernor();
+
+    TwAddVarRW(tweakbar, "Governor",       TW_TYPE_BOOLCPP, &governor.getEnabled(),    " group='Quality' label='Governor' help='Adjust the fur quality to hold the frame time target' ");
+    TwAddVarRW(tweakbar, "Target time",    TW_TYPE_FLOAT,   &governor.getTargetTime(), " group='Quality' label='Target (ms)' min=4 max=100 step=0.1 help='Frame time budget' ");
+    TwAddVarRO(tweakbar, "Frame cost",     TW_TYPE_FLOAT,   &governor.getAverageTime(), " group='Quality' label='Frame cost (ms)' precision=2 help='Smoothed CPU or GPU time of a frame, whichever is longer' ");
+    TwAddVarRO(tweakbar, "Quality level",  TW_TYPE_INT32,   &governor.getLevel(),      " group='Quality' label='Level' help='0 is full quality, higher is cheaper' ");
+    TwAddVarRO(tweakbar, "Shell cap",      TW_TYPE_FLOAT,   &governor.getShellFraction(), " group='Quality' label='Shell cap' precision=2 help='Fraction of the shells of each mesh that may be drawn' ");
+    TwAddVarRO(tweakbar, "Fur resolution", TW_TYPE_FLOAT,   &governor.getFurResolution(), " group='Quality' label='Fur resolution' precision=2 ");
+    TwAddVarRO(tweakbar, "Noise detail",   TW_TYPE_INT32,   &governor.getNoiseDetail(), " group='Quality' label='Noise detail' help='2 all noise, 1 no length variation, 0 no pattern' ");
+    TwAddVarRO(tweakbar, "Overdraw",       TW_TYPE_FLOAT,   &scene->getOverdraw(),     " group='Quality' label='Overdraw' precision=2 help='Samples passing the depth test per sample on screen' ");
+
+    // GL call counters of the last frame, only available in GL_STATS builds
+    if(GLStats::enabled()) {
+
+        const GLCounters &counters = GLStats::lastFrame();
+
+        TwAddVarRO(tweakbar, "Draw calls",      TW_TYPE_UINT32, &counters.drawCalls,      " group='Stats' label='Draw calls' ");
+        TwAddVarRO(tweakbar, "State changes",   TW_TYPE_UINT32, &counters.stateChanges,   " group='Stats' label='State changes' ");
+        TwAddVarRO(tweakbar, "Uniform updates", TW_TYPE_UINT32, &counters.uniformUpdates, " group='Stats' label='Uniform updates' ");
+        TwAddVarRO(tweakbar, "Texture binds",   TW_TYPE_UINT32, &counters.textureBinds,   " group='Stats' label='Texture binds' ");
+        TwAddVarRO(tweakbar, "Bytes uploaded",  TW_TYPE_UINT32, &counters.bytesUploaded,  " group='Stats' label='Bytes uploaded' ");
+    }
+
+    // Heap allocations of the last frame, only available in ALLOC_STATS builds
+    if(AllocStats::enabled()) {
+
+        const AllocCounters &allocations = AllocStats::lastFrame();
+
+        TwAddVarRO(tweakbar, "Allocations",      TW_TYPE_UINT32, &allocations.allocations, " group='Stats' label='Allocations' ");
+        TwAddVarRO(tweakbar, "Allocated bytes",  TW_TYPE_UINT32, &allocations.bytes,       " group='Stats' label='Allocated bytes' ");
+    }
 }
 
 
@@ -439,7 +765,7 @@ void keyboardInput(GLFWwindow* window, int key, int scancode, int action, int mo
 }
 
 
-double calculateFPS(double timeInterval = 1.0, std::string windowTitle = "NONE") {
+double calculateFPS(double timeInterval = 1.0, const char * windowTitle = nullptr) {
 
     // Static values which only get initialised the first time the function runs
     static double startTime  =  glfwGetTime(); // Set the initial time to now
@@ -449,6 +775,9 @@ double calculateFPS(double timeInterval = 1.0, std::string windowTitle = "NONE")
     // we don't have a start time we simply cannot get an accurate FPS value on our very
     // first read if the time interval is zero, so we'll settle for an FPS value of zero instead.
     static double frameCount =  -1.0;
+
+    // The title is formatted into a fixed buffer so that the frame loop never touches the heap
+    static char title[256];
  
     frameCount++;
  
@@ -470,24 +799,16 @@ double calculateFPS(double timeInterval = 1.0, std::string windowTitle = "NONE")
         fps = round(frameCount / duration);
  
         // If the user specified a window title to append the FPS value to...
-        if (windowTitle != "NONE") {
+        if (windowTitle) {
 
-            // Convert the fps value into a string using an output stringstream
-            std::ostringstream stream;
-            stream << fps;
-            std::string fpsString = stream.str();
- 
-            // Append the FPS value to the window title details
-            windowTitle += " | FPS: " + fpsString;
- 
-            // Convert the new window title to a c_str and set it
-            const char* pszConstString = windowTitle.c_str();
-            glfwSetWindowTitle(window, pszConstString);
+            // Append the FPS value to the window title details and set it
+            snprintf(title, sizeof(title), "%s | FPS: %.0f", windowTitle, fps);
+            glfwSetWindowTitle(window, title);
         }
         // If the user didn't specify a window to append the FPS to then output the FPS to the console
         else {
             
-            std::cout << "FPS: " << fps << std::endl;
+            printf("FPS: %.0f\n", fps);
         }
  
         // Reset the frame count to zero and set the initial time to be now
@@ -643,40 +964,418 @@ void updateTweakBarVariables() {
     }
 
 
-    switch(currentNoise) {
+    // Only push the parameter block when the tweak bar changed it, or to a newly selected mesh
+    if(tweakParameters.version != pushedVersion || mesh != pushedMesh) {
+
+        mesh->setParameters(tweakParameters);
+
+        pushedVersion = tweakParameters.version;
+        pushedMesh    = mesh;
+    }
+
+    // The field moves to a newly selected mesh, the old one goes back to a single copy
+    if(fieldSize != pushedFieldSize || mesh != fieldMesh) {
+
+        if(fieldMesh && fieldMesh != mesh)
+            fieldMesh->setInstances(std::vector<FurInstance>());
+
+        mesh->setInstances(createField(fieldSize));
+
+        pushedFieldSize = fieldSize;
+        fieldMesh       = mesh;
+    }
+}
+
+
+std::vector<FurInstance> createField(int size) {
+
+    std::vector<FurInstance> field;
+
+    // A single copy is the mesh as it is
+    if(size <= 1)
+        return field;
+
+    size = std::min(size, MAX_FIELD_SIZE);
+
+    int columns = static_cast<int>(ceilf(sqrtf(static_cast<float>(size))));
+
+    field.resize(size);
+
+    // Same field every time
+    unsigned int seed = 12345u;
+
+    for(int i = 0; i < size; i++) {
+
+        float random[4];
+
+        for(int r = 0; r < 4; r++) {
+            seed = seed * 1664525u + 1013904223u;
+            random[r] = static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+        }
+
+        float x     = (static_cast<float>(i % columns) - 0.5f * (columns - 1)) * FIELD_SPACING;
+        float z     = (static_cast<float>(i / columns) - 0.5f * (columns - 1)) * FIELD_SPACING;
+        float angle = random[0] * 6.2831853f;
+        float scale = FIELD_SCALE * (0.8f + 0.4f * random[1]);
+
+        // Turned about the up axis and scaled
+        glm::mat4 &transform = field[i].transform;
+
+        transform[0] = glm::vec4( cosf(angle) * scale, 0.0f, -sinf(angle) * scale, 0.0f);
+        transform[1] = glm::vec4( 0.0f,                scale, 0.0f,                0.0f);
+        transform[2] = glm::vec4( sinf(angle) * scale, 0.0f,  cosf(angle) * scale, 0.0f);
+        transform[3] = glm::vec4( x,                   0.0f,  z,                   1.0f);
+
+        field[i].tint = glm::vec3(0.7f + 0.3f * random[2], 0.7f + 0.3f * random[3], 0.8f + 0.2f * random[2] * random[3]);
+        field[i].seed = static_cast<float>(i);
+    }
+
+    return field;
+}
+
+
+
+void parseArguments(int argc, char **argv) {
 
-        case SIMPLEX:
+    for(int i = 1; i < argc; i++) {
 
-            if(mesh->getNoiseType() != SIMPLEX) {
-                mesh->setNoiseType(SIMPLEX);
+        if(strcmp(argv[i], "--regression") == 0)
+            regressionMode = true;
+
+        else if(strcmp(argv[i], "--update-golden") == 0)
+            updateGolden = true;
+
+        else if(strncmp(argv[i], "--image-threshold=", 18) == 0)
+            imageThreshold = static_cast<float>(atof(argv[i] + 18));
+
+        else if(strncmp(argv[i], "--max-mismatch=", 15) == 0)
+            maxMismatchFraction = static_cast<float>(atof(argv[i] + 15));
+
+        else if(strncmp(argv[i], "--frame-tolerance=", 18) == 0)
+            frameTimeTolerance = static_cast<float>(atof(argv[i] + 18));
+
+        else if(strcmp(argv[i], "--shell-benchmark") == 0)
+            regressionMode = shellBenchmark = true;
+
+        else
+            std::cout << "Unknown argument: " << argv[i] << std::endl;
+    }
+}
+
+
+int runRegression() {
+
+    Framebuffer target;
+
+    if(!target.initialize(WIDTH, HEIGHT))
+        return EXIT_FAILURE;
+
+    Geometry * meshes[] = { sphere, torus, plane, monkey, bunny, teapot };
+
+    std::map<std::string, double> baseline, timings;
+
+    if(!updateGolden && !loadTimings(PATH_GOLDEN + FILE_NAME_TIMINGS, baseline))
+        std::cout << "No frame time baseline found, only comparing images" << std::endl;
+
+    std::vector<GLubyte> pixels, golden;
+
+    int failures = 0;
+
+    std::cout << "\nRunning regression scenes...\n" << std::endl;
+
+    // Always compare at full quality
+    scene->getGovernor().getEnabled() = false;
+
+    for(unsigned int m = 0; m < 6; m++) {
+
+        for(unsigned int n = 0; n < 2; n++) {
+
+            // Only the mesh under test is rendered, with a fixed camera and time
+            for(unsigned int i = 0; i < 6; i++)
+                meshes[i]->setShallRender(i == m);
+
+            meshes[m]->setNoiseType(NoiseTypesEV[n].Value);
+
+            scene->resetCamera();
+            scene->setCurrentTime(REGRESSION_TIME);
+
+            std::string name = std::string(MeshesEV[m].Label) + "_" + NoiseTypesEV[n].Label;
+
+            target.bind();
+
+            double frameTime = measureFrameTime();
+
+            target.readPixels(pixels);
+            target.unbind();
+
+            std::string goldenName = PATH_GOLDEN + name + FILE_NAME_PNG;
+
+            if(updateGolden) {
+
+                if(!writePNG(goldenName, WIDTH, HEIGHT, pixels)) {
+                    std::cout << name << ": could not write " << goldenName << std::endl;
+                    failures++;
+                }
+
+                timings[name] = frameTime;
+
+                std::cout << name << ": " << frameTime << " ms, golden image updated";
+
+                printCounters();
+
+                std::cout << std::endl;
+
+                continue;
             }
 
-            break;
+            int goldenWidth, goldenHeight;
 
-        case WORLEY:
+            if(!readPNG(goldenName, goldenWidth, goldenHeight, golden) || goldenWidth != WIDTH || goldenHeight != HEIGHT) {
+                std::cout << name << ": FAILED, missing or mismatching golden image " << goldenName << std::endl;
+                failures++;
+                continue;
+            }
+
+            ImageDiff diff = compareImages(pixels, golden, WIDTH, HEIGHT, imageThreshold);
+
+            bool imageOk = diff.mismatchFraction() <= maxMismatchFraction;
+            bool timeOk  = true;
+
+            std::cout << name << ": " << frameTime << " ms, " << diff.mismatchFraction() * 100.0f << "% pixels changed (max delta " << diff.maxDelta << ")";
+
+            printCounters();
 
-            if(mesh->getNoiseType() != WORLEY) {
-                mesh->setNoiseType(WORLEY);
+            std::map<std::string, double>::iterator it = baseline.find(name);
+
+            if(it != baseline.end()) {
+
+                timeOk = frameTime <= it->second * (1.0 + frameTimeTolerance / 100.0);
+
+                std::cout << ", baseline " << it->second << " ms";
             }
 
-            break;
+            if(!imageOk || !timeOk) {
 
-        default:
+                std::cout << " -> FAILED" << (imageOk ? "" : " [image]") << (timeOk ? "" : " [frame time]");
 
-            break;
+                // Keep the failing frame around so that it can be compared by eye
+                writePNG(PATH_GOLDEN + name + "_failed" + FILE_NAME_PNG, WIDTH, HEIGHT, pixels);
+
+                failures++;
+            }
+
+            std::cout << std::endl;
+        }
     }
 
-    mesh->setFurLength(furLength);
-    mesh->setColor(skinColor);
-    mesh->setAmbient(ambientColor);
-    mesh->setDiffuse(diffuseColor);
-    mesh->setSpecular(specularColor);
-    mesh->setFurColor(furColor);
-    mesh->setSpecularity(specularity);
-    mesh->setTransparency(transparency);
-    mesh->setShinyness(shinyness);
-    mesh->setFurNoiseLengthVariation(furNoiseLengthVariation);
-    mesh->setFurNoiseSampleScale(furNoiseSampleScale);
-    mesh->setFurPatternScale(furPatternScale);
+    if(updateGolden && !saveTimings(PATH_GOLDEN + FILE_NAME_TIMINGS, timings)) {
+        std::cout << "Could not write the frame time baseline " << PATH_GOLDEN + FILE_NAME_TIMINGS << std::endl;
+        failures++;
+    }
+
+    if(shellBenchmark) {
+        benchmarkShellBlending();
+        benchmarkField();
+    }
+
+    std::cout << "\nRegression " << (failures ? "failed: " : "passed: ") << failures << " failing scene(s)" << std::endl;
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+void renderRegressionFrame() {
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // A frame always updates, the per frame data lives in the stream buffer. Time stands still.
+    scene->update(0.0f);
+    scene->render();
+
+    // Wait for the GPU, we want the full cost of the frame
+    glFinish();
+
+    GLStats::endFrame();
+    AllocStats::endFrame();
+}
+
+
+double measureFrameTime() {
+
+    // The caller bound the target to measure with
+    scene->updateTargetSamples();
+
+    // Warm up, so that lazy driver work doesn't end up in the timings
+    for(int i = 0; i < REGRESSION_WARMUP_FRAMES; i++)
+        renderRegressionFrame();
+
+    std::vector<double> frameTimes(REGRESSION_FRAMES);
+
+    for(int i = 0; i < REGRESSION_FRAMES; i++) {
+
+        double start = glfwGetTime();
+        renderRegressionFrame();
+        frameTimes[i] = (glfwGetTime() - start) * 1000.0;
+    }
+
+    // Median, a single hiccup shouldn't decide the result
+    std::sort(frameTimes.begin(), frameTimes.end());
+
+    return frameTimes[REGRESSION_FRAMES / 2];
 }
 
+
+void benchmarkShellBlending() {
+
+    // Alpha to coverage needs samples to dither over, both modes get the same target for a fair comparison
+    Framebuffer target;
+
+    if(!target.initialize(WIDTH, HEIGHT, GL_RGBA8, true, MSAA_SAMPLES))
+        return;
+
+    Geometry * meshes[] = { sphere, torus, plane, monkey, bunny, teapot };
+
+    // Every mode at full resolution, then blending at reduced resolutions
+    const struct { int mode; int downsample; const char * label; } configurations[] = {
+        { BLENDED_SHELLS,           1, "blend" },
+        { ALPHA_TO_COVERAGE_SHELLS, 1, "alpha to coverage" },
+        { WEIGHTED_OIT_SHELLS,      1, "weighted OIT" },
+        { BLENDED_SHELLS,           2, "blend at half resolution" },
+        { BLENDED_SHELLS,           4, "blend at quarter resolution" }
+    };
+
+    std::cout << "\nShell blending modes at " << MSAA_SAMPLES << "x MSAA, frame time and overdraw (samples passing the depth test per sample)\n" << std::endl;
+
+    for(unsigned int m = 0; m < 6; m++) {
+
+        for(unsigned int i = 0; i < 6; i++)
+            meshes[i]->setShallRender(i == m);
+
+        meshes[m]->setNoiseType(SIMPLEX);
+
+        std::cout << MeshesEV[m].Label;
+
+        for(unsigned int c = 0; c < sizeof(configurations) / sizeof(configurations[0]); c++) {
+
+            scene->getShellBlending() = configurations[c].mode;
+            scene->getFurDownsample() = configurations[c].downsample;
+            scene->resetCamera();
+            scene->setCurrentTime(REGRESSION_TIME);
+
+            target.bind();
+
+            double frameTime = measureFrameTime();
+
+            target.unbind();
+
+            std::cout << (c == 0 ? ": " : ", ") << configurations[c].label << " "
+                      << frameTime << " ms, overdraw " << scene->getOverdraw();
+        }
+
+        std::cout << std::endl;
+    }
+
+    scene->getShellBlending() = BLENDED_SHELLS;
+    scene->getFurDownsample() = 1;
+}
+
+
+void benchmarkField() {
+
+    Framebuffer target;
+
+    if(!target.initialize(WIDTH, HEIGHT))
+        return;
+
+    Geometry * meshes[] = { sphere, torus, plane, monkey, bunny, teapot };
+
+    // The default camera stands in the middle of the largest field, the near copies get all the detail
+    // and the far ones should get little
+    std::cout << "\nField of " << MAX_FIELD_SIZE << " instances, frame time, instances and triangles drawn\n" << std::endl;
+
+    for(unsigned int m = 0; m < 6; m++) {
+
+        for(unsigned int i = 0; i < 6; i++)
+            meshes[i]->setShallRender(i == m);
+
+        meshes[m]->setNoiseType(SIMPLEX);
+        meshes[m]->setInstances(createField(MAX_FIELD_SIZE));
+
+        scene->resetCamera();
+        scene->setCurrentTime(REGRESSION_TIME);
+
+        target.bind();
+
+        double frameTime = measureFrameTime();
+
+        target.unbind();
+
+        std::cout << MeshesEV[m].Label << ": " << frameTime << " ms, " << scene->getInstancesDrawn() << " instances, "
+                  << scene->getTrianglesDrawn() << " triangles";
+
+        printCounters();
+
+        std::cout << std::endl;
+
+        meshes[m]->setInstances(std::vector<FurInstance>());
+    }
+}
+
+
+void printCounters() {
+
+    if(GLStats::enabled()) {
+
+        const GLCounters &counters = GLStats::lastFrame();
+
+        std::cout << ", " << counters.drawCalls      << " draws"
+                  << ", " << counters.stateChanges   << " state changes"
+                  << ", " << counters.uniformUpdates << " uniforms"
+                  << ", " << counters.textureBinds   << " texture binds"
+                  << ", " << counters.bytesUploaded  << " bytes uploaded";
+    }
+
+    if(AllocStats::enabled())
+        std::cout << ", " << AllocStats::lastFrame().allocations << " allocations";
+}
+
+
+// Tweak bar callbacks, the client data points at a field of tweakParameters
+
+void TW_CALL setFloatParameter(const void * value, void * field) {
+
+    *static_cast<float *>(field) = *static_cast<const float *>(value);
+    tweakParameters.version++;
+}
+
+
+void TW_CALL getFloatParameter(void * value, void * field) {
+
+    *static_cast<float *>(value) = *static_cast<float *>(field);
+}
+
+
+void TW_CALL setColorParameter(const void * value, void * field) {
+
+    *static_cast<glm::vec3 *>(field) = *static_cast<const glm::vec3 *>(value);
+    tweakParameters.version++;
+}
+
+
+void TW_CALL getColorParameter(void * value, void * field) {
+
+    *static_cast<glm::vec3 *>(value) = *static_cast<glm::vec3 *>(field);
+}
+
+
+void TW_CALL setIntParameter(const void * value, void * field) {
+
+    *static_cast<int *>(field) = *static_cast<const int *>(value);
+    tweakParameters.version++;
+}
+
+
+void TW_CALL getIntParameter(void * value, void * field) {
+
+    *static_cast<int *>(value) = *static_cast<int *>(field);
+}
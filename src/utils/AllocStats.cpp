@@ -0,0 +1,75 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "../../include/utils/AllocStats.h"
+
+namespace {
+
+    std::atomic<unsigned int> frameAllocations(0);
+
+    std::atomic<unsigned int> frameBytes(0);
+
+    AllocCounters previousFrame;
+}
+
+
+const AllocCounters &AllocStats::lastFrame() {
+
+    return previousFrame;
+}
+
+
+void AllocStats::endFrame() {
+
+    previousFrame.allocations = frameAllocations.exchange(0);
+    previousFrame.bytes       = frameBytes.exchange(0);
+}
+
+
+bool AllocStats::enabled() {
+
+#ifdef FUR_ALLOC_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+#ifdef FUR_ALLOC_STATS
+
+namespace {
+
+    void *countedAllocation(std::size_t size) {
+
+        frameAllocations++;
+        frameBytes += static_cast<unsigned int>(size);
+
+        void *p = std::malloc(size ? size : 1);
+
+        if(!p)
+            throw std::bad_alloc();
+
+        return p;
+    }
+}
+
+
+void *operator new(std::size_t size)                                     { return countedAllocation(size); }
+
+void *operator new[](std::size_t size)                                   { return countedAllocation(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept    { try { return countedAllocation(size); } catch(...) { return nullptr; } }
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept  { try { return countedAllocation(size); } catch(...) { return nullptr; } }
+
+void operator delete(void *p) noexcept                                   { std::free(p); }
+
+void operator delete[](void *p) noexcept                                 { std::free(p); }
+
+void operator delete(void *p, const std::nothrow_t &) noexcept           { std::free(p); }
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept         { std::free(p); }
+
+#endif // FUR_ALLOC_STATS
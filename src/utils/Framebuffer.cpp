@@ -0,0 +1,132 @@
+#include <cstdio>
+
+#include "../../include/utils/Framebuffer.h"
+
+Framebuffer::Framebuffer() {
+
+}
+
+
+Framebuffer::~Framebuffer() {
+
+    glDeleteTextures(1, &colorTextureID);
+    glDeleteTextures(1, &depthTextureID);
+    glDeleteFramebuffers(1, &framebufferID);
+
+    glDeleteRenderbuffers(1, &colorRenderbufferID);
+    glDeleteRenderbuffers(1, &depthRenderbufferID);
+    glDeleteFramebuffers(1, &multisampleFramebufferID);
+}
+
+
+bool Framebuffer::initialize(int width, int height, GLenum colorFormat, bool depth, int samples) {
+
+    mWidth   = width;
+    mHeight  = height;
+    mSamples = samples;
+
+    glGenFramebuffers(1, &framebufferID);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+
+    // Color attachment, sampled with linear filtering when composited
+    glGenTextures(1, &colorTextureID);
+    glBindTexture(GL_TEXTURE_2D, colorTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, colorFormat, mWidth, mHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTextureID, 0);
+
+    // Depth is kept as a texture so that later passes can sample it
+    if(depth) {
+        glGenTextures(1, &depthTextureID);
+        glBindTexture(GL_TEXTURE_2D, depthTextureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, mWidth, mHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextureID, 0);
+    }
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // The multisampled buffers are what gets drawn to, depth stays in there
+    if(status == GL_FRAMEBUFFER_COMPLETE && mSamples > 0) {
+
+        glGenFramebuffers(1, &multisampleFramebufferID);
+        glBindFramebuffer(GL_FRAMEBUFFER, multisampleFramebufferID);
+
+        glGenRenderbuffers(1, &colorRenderbufferID);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbufferID);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, mSamples, colorFormat, mWidth, mHeight);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbufferID);
+
+        if(depth) {
+            glGenRenderbuffers(1, &depthRenderbufferID);
+            glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbufferID);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, mSamples, GL_DEPTH_COMPONENT24, mWidth, mHeight);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbufferID);
+        }
+
+        status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Framebuffer incomplete, status: 0x%x\n", status);
+        return false;
+    }
+
+    return true;
+}
+
+
+void Framebuffer::bind() {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, multisampleFramebufferID ? multisampleFramebufferID : framebufferID);
+    glViewport(0, 0, mWidth, mHeight);
+}
+
+
+void Framebuffer::unbind() {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+void Framebuffer::resolve() {
+
+    if(!multisampleFramebufferID)
+        return;
+
+    // Keeps whatever is bound for drawing, a blit only needs the read and draw targets
+    GLint previous = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, multisampleFramebufferID);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebufferID);
+    glBlitFramebuffer(0, 0, mWidth, mHeight, 0, 0, mWidth, mHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous);
+}
+
+
+void Framebuffer::readPixels(std::vector<GLubyte> &pixels) {
+
+    resolve();
+
+    pixels.resize(mWidth * mHeight * 4);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebufferID);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
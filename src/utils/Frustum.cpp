@@ -0,0 +1,59 @@
+#include "../../include/utils/Frustum.h"
+
+
+Frustum::Frustum() {
+
+    // Nothing is outside of planes without a normal
+    for(unsigned int i = 0; i < PLANES; i++)
+        mPlanes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+
+Frustum::Frustum(const glm::mat4 &matrix) {
+
+    // Rows of the matrix, glm is column major
+    glm::vec4 row[4];
+
+    for(unsigned int i = 0; i < 4; i++)
+        row[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+
+    // -w <= x, y, z <= w in clip space
+    mPlanes[0] = row[3] + row[0];
+    mPlanes[1] = row[3] - row[0];
+    mPlanes[2] = row[3] + row[1];
+    mPlanes[3] = row[3] - row[1];
+    mPlanes[4] = row[3] + row[2];
+    mPlanes[5] = row[3] - row[2];
+
+    // Unit normals, so that plane . (p, 1) is a distance
+    for(unsigned int i = 0; i < PLANES; i++)
+        mPlanes[i] /= glm::length(glm::vec3(mPlanes[i]));
+}
+
+
+bool Frustum::intersectsSphere(const glm::vec3 &center, float radius) const {
+
+    for(unsigned int i = 0; i < PLANES; i++) {
+        if(glm::dot(glm::vec3(mPlanes[i]), center) + mPlanes[i].w < -radius)
+            return false;
+    }
+
+    return true;
+}
+
+
+bool Frustum::intersectsBox(const glm::vec3 &low, const glm::vec3 &high) const {
+
+    for(unsigned int i = 0; i < PLANES; i++) {
+
+        // The corner furthest along the normal, if even that one is outside so is the box
+        glm::vec3 corner(mPlanes[i].x >= 0.0f ? high.x : low.x,
+                         mPlanes[i].y >= 0.0f ? high.y : low.y,
+                         mPlanes[i].z >= 0.0f ? high.z : low.z);
+
+        if(glm::dot(glm::vec3(mPlanes[i]), corner) + mPlanes[i].w < 0.0f)
+            return false;
+    }
+
+    return true;
+}
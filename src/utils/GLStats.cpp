@@ -0,0 +1,61 @@
+#include "../../include/utils/GLStats.h"
+
+namespace {
+
+    GLCounters currentFrame;
+
+    GLCounters previousFrame;
+}
+
+
+GLCounters &GLStats::current() {
+
+    return currentFrame;
+}
+
+
+const GLCounters &GLStats::lastFrame() {
+
+    return previousFrame;
+}
+
+
+void GLStats::endFrame() {
+
+    previousFrame = currentFrame;
+    currentFrame  = GLCounters();
+}
+
+
+bool GLStats::enabled() {
+
+#ifdef FUR_GL_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+unsigned int GLStats::pixelSize(GLenum format, GLenum type) {
+
+    unsigned int components;
+
+    switch(format) {
+        case GL_RED:
+        case GL_DEPTH_COMPONENT: components = 1; break;
+        case GL_RG:              components = 2; break;
+        case GL_RGB:
+        case GL_BGR:             components = 3; break;
+        default:                 components = 4; break;
+    }
+
+    switch(type) {
+        case GL_UNSIGNED_BYTE:
+        case GL_BYTE:            return components;
+        case GL_UNSIGNED_SHORT:
+        case GL_SHORT:
+        case GL_HALF_FLOAT:      return components * 2;
+        default:                 return components * 4;
+    }
+}
@@ -0,0 +1,72 @@
+#include "../../include/utils/GPUQuery.h"
+
+
+GPUQuery::GPUQuery(GLenum target) : mTarget(target) {
+
+    for(unsigned int i = 0; i < QUERIES; i++) {
+        queryIDs[i] = 0;
+        mPending[i] = false;
+    }
+}
+
+
+GPUQuery::~GPUQuery() {
+
+    if(queryIDs[0])
+        glDeleteQueries(QUERIES, queryIDs);
+}
+
+
+void GPUQuery::initialize() {
+
+    glGenQueries(QUERIES, queryIDs);
+}
+
+
+void GPUQuery::begin() {
+
+    if(!queryIDs[0] || mRunning)
+        return;
+
+    // The slot we're about to reuse holds the oldest query, it has to be done by now.
+    // Then pick up the newer ones that have finished, oldest first.
+    collect(mCurrent, true);
+
+    for(unsigned int i = 1; i < QUERIES; i++)
+        collect((mCurrent + i) % QUERIES, false);
+
+    glBeginQuery(mTarget, queryIDs[mCurrent]);
+    mRunning = true;
+}
+
+
+void GPUQuery::end() {
+
+    if(!mRunning)
+        return;
+
+    glEndQuery(mTarget);
+
+    mPending[mCurrent] = true;
+    mCurrent = (mCurrent + 1) % QUERIES;
+    mRunning = false;
+}
+
+
+void GPUQuery::collect(unsigned int query, bool wait) {
+
+    if(!mPending[query])
+        return;
+
+    if(!wait) {
+
+        GLuint available = 0;
+        glGetQueryObjectuiv(queryIDs[query], GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if(!available)
+            return;
+    }
+
+    glGetQueryObjectui64v(queryIDs[query], GL_QUERY_RESULT, &mResult);
+    mPending[query] = false;
+}
@@ -0,0 +1,629 @@
+#include <algorithm>
+#include <array>
+#include <map>
+#include <queue>
+
+#include "../../include/utils/MeshSimplifier.h"
+
+namespace {
+
+    // Seam edges get planes through them at right angles to the surface, weighted this much
+    // stronger than the surface itself, so that collapses along a seam keep it straight
+    const double SEAM_WEIGHT = 10.0;
+
+    // A collapse may not turn a triangle further than this, as the cosine between the old and new normal
+    const double MIN_NORMAL_COSINE = 0.3;
+
+
+    // Symmetric 4x4 matrix of summed plane equations, xx xy xz xw yy yz yw zz zw ww
+    struct Quadric {
+
+        double a[10];
+
+        Quadric() {
+            for(int i = 0; i < 10; i++)
+                a[i] = 0.0;
+        }
+
+        void addPlane(const glm::dvec3 &n, double d, double weight) {
+            a[0] += weight * n.x * n.x;  a[1] += weight * n.x * n.y;  a[2] += weight * n.x * n.z;  a[3] += weight * n.x * d;
+            a[4] += weight * n.y * n.y;  a[5] += weight * n.y * n.z;  a[6] += weight * n.y * d;
+            a[7] += weight * n.z * n.z;  a[8] += weight * n.z * d;
+            a[9] += weight * d * d;
+        }
+
+        Quadric &operator+=(const Quadric &q) {
+            for(int i = 0; i < 10; i++)
+                a[i] += q.a[i];
+            return *this;
+        }
+
+        // Sum of the weighted squared distances from p to the planes
+        double error(const glm::vec3 &p) const {
+            double x = p.x, y = p.y, z = p.z;
+            return a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+                 + a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+                 + a[7] * z * z + 2.0 * a[8] * z
+                 + a[9];
+        }
+    };
+
+
+    // Moving one position onto a neighbour, ordered so that the priority queue gives the cheapest first
+    struct Collapse {
+
+        double       cost;
+        unsigned int from;
+        unsigned int to;
+        unsigned int version;
+
+        bool operator<(const Collapse &c) const     { return cost > c.cost; }
+    };
+
+
+    // Decimation state. The topology is tracked on positions, the triangle corners index the welded
+    // vertices (wedges), so that a position on a seam has one wedge per side of it.
+    class Simplifier {
+
+    public:
+
+        Simplifier(const std::vector<glm::vec3> &, const std::vector<unsigned int> &);
+
+        void simplify(unsigned int);
+
+        unsigned int getTriangleCount()             { return mAliveTriangles; }
+
+        void appendTriangles(std::vector<unsigned int> &);
+
+    private:
+
+        bool evaluate(unsigned int, unsigned int, double &);
+
+        void collapse(unsigned int, unsigned int);
+
+        void pushBest(unsigned int);
+
+        void gatherNeighbours(unsigned int, std::vector<unsigned int> &);
+
+        void compact(unsigned int);
+
+        unsigned int positionOf(unsigned int, unsigned int);
+
+        unsigned int cornerAt(unsigned int, unsigned int);
+
+        glm::dvec3 triangleNormal(unsigned int, unsigned int, const glm::vec3 &);
+
+
+        unsigned int mAliveTriangles = 0;
+
+        std::vector<unsigned int> mCorners;                 // Wedge of every triangle corner
+        std::vector<bool>         mTriangleAlive;
+
+        std::vector<unsigned int> mWedgePosition;           // Position of every wedge
+        std::vector<glm::vec3>    mPositions;
+
+        std::vector<std::vector<unsigned int> > mTriangles; // Triangles around every position
+        std::vector<Quadric>      mQuadrics;
+        std::vector<unsigned int> mVersions;                // Bumped whenever the neighbourhood changes
+        std::vector<bool>         mLocked;
+        std::vector<bool>         mRemoved;
+
+        std::priority_queue<Collapse> mQueue;
+
+        // Scratch space of evaluate(), collapse() uses what the last evaluation found
+        std::vector<std::pair<unsigned int, unsigned int> > mWedgeMap;
+        std::vector<unsigned int> mRemovedTriangles;
+        std::vector<unsigned int> mNeighboursFrom, mNeighboursTo;
+    };
+
+
+    Simplifier::Simplifier(const std::vector<glm::vec3> &vertices, const std::vector<unsigned int> &indices)
+        : mCorners(indices) {
+
+        unsigned int triangles = indices.size() / 3;
+
+        mAliveTriangles = triangles;
+        mTriangleAlive.assign(triangles, true);
+
+        // Wedges with the same position share it
+        std::map<std::array<float, 3>, unsigned int> positions;
+
+        mWedgePosition.resize(vertices.size());
+
+        for(unsigned int i = 0; i < vertices.size(); i++) {
+
+            std::array<float, 3> key = {{ vertices[i].x, vertices[i].y, vertices[i].z }};
+            std::map<std::array<float, 3>, unsigned int>::iterator it = positions.find(key);
+
+            if(it == positions.end()) {
+                it = positions.insert(std::make_pair(key, static_cast<unsigned int>(mPositions.size()))).first;
+                mPositions.push_back(vertices[i]);
+            }
+
+            mWedgePosition[i] = it->second;
+        }
+
+        unsigned int count = mPositions.size();
+
+        mTriangles.resize(count);
+        mQuadrics.resize(count);
+        mVersions.assign(count, 0);
+        mLocked.assign(count, false);
+        mRemoved.assign(count, false);
+
+        // Every triangle adds its plane to its corners, weighted by its area
+        for(unsigned int t = 0; t < triangles; t++) {
+
+            glm::dvec3 n    = triangleNormal(t, ~0u, glm::vec3());
+            double     area = glm::length(n);
+
+            if(area > 0.0)
+                n /= area;
+
+            double d = -glm::dot(n, glm::dvec3(mPositions[positionOf(t, 0)]));
+
+            for(unsigned int k = 0; k < 3; k++) {
+                mTriangles[positionOf(t, k)].push_back(t);
+                mQuadrics[positionOf(t, k)].addPlane(n, d, area * 0.5);
+            }
+        }
+
+        // Edges by their positions, to find borders and seams. The key is (low << 32 | high),
+        // along with the triangle and the wedges at the low and the high end.
+        struct Edge {
+            unsigned long long key;
+            unsigned int triangle, low, high;
+            bool operator<(const Edge &e) const     { return key < e.key; }
+        };
+
+        std::vector<Edge> edges;
+        edges.reserve(triangles * 3);
+
+        for(unsigned int t = 0; t < triangles; t++) {
+            for(unsigned int k = 0; k < 3; k++) {
+
+                unsigned int wa = mCorners[t * 3 + k], wb = mCorners[t * 3 + (k + 1) % 3];
+
+                if(mWedgePosition[wa] > mWedgePosition[wb])
+                    std::swap(wa, wb);
+
+                Edge e;
+                e.key      = (static_cast<unsigned long long>(mWedgePosition[wa]) << 32) | mWedgePosition[wb];
+                e.triangle = t;
+                e.low      = wa;
+                e.high     = wb;
+
+                edges.push_back(e);
+            }
+        }
+
+        std::sort(edges.begin(), edges.end());
+
+        for(unsigned int i = 0; i < edges.size(); ) {
+
+            unsigned int j = i + 1;
+
+            while(j < edges.size() && edges[j].key == edges[i].key)
+                j++;
+
+            unsigned int a = static_cast<unsigned int>(edges[i].key >> 32);
+            unsigned int b = static_cast<unsigned int>(edges[i].key & 0xffffffffu);
+
+            // Borders and non manifold edges stay exactly where they are
+            if(j - i != 2) {
+                mLocked[a] = mLocked[b] = true;
+            }
+            // A seam when the two sides see different wedges at either end
+            else if(edges[i].low != edges[i + 1].low || edges[i].high != edges[i + 1].high) {
+
+                glm::dvec3 pa(mPositions[a]), pb(mPositions[b]);
+                glm::dvec3 edge   = pb - pa;
+                double     length = glm::length(edge);
+
+                for(unsigned int s = i; s < j && length > 0.0; s++) {
+
+                    glm::dvec3 n = triangleNormal(edges[s].triangle, ~0u, glm::vec3());
+                    glm::dvec3 c = glm::cross(edge, n);
+                    double     l = glm::length(c);
+
+                    if(l <= 0.0)
+                        continue;
+
+                    c /= l;
+
+                    mQuadrics[a].addPlane(c, -glm::dot(c, pa), length * length * SEAM_WEIGHT);
+                    mQuadrics[b].addPlane(c, -glm::dot(c, pa), length * length * SEAM_WEIGHT);
+                }
+            }
+
+            i = j;
+        }
+
+        for(unsigned int p = 0; p < count; p++)
+            pushBest(p);
+    }
+
+
+    void Simplifier::simplify(unsigned int target) {
+
+        while(mAliveTriangles > target && !mQueue.empty()) {
+
+            Collapse c = mQueue.top();
+            mQueue.pop();
+
+            if(mRemoved[c.from] || mRemoved[c.to] || c.version != mVersions[c.from])
+                continue;
+
+            // Something may have changed around the target since the entry was made
+            double cost;
+
+            if(!evaluate(c.from, c.to, cost)) {
+                mVersions[c.from]++;
+                pushBest(c.from);
+                continue;
+            }
+
+            collapse(c.from, c.to);
+        }
+    }
+
+
+    void Simplifier::appendTriangles(std::vector<unsigned int> &indices) {
+
+        for(unsigned int t = 0; t < mTriangleAlive.size(); t++) {
+
+            if(!mTriangleAlive[t])
+                continue;
+
+            indices.push_back(mCorners[t * 3]);
+            indices.push_back(mCorners[t * 3 + 1]);
+            indices.push_back(mCorners[t * 3 + 2]);
+        }
+    }
+
+
+    bool Simplifier::evaluate(unsigned int from, unsigned int to, double &cost) {
+
+        if(mLocked[from] || mRemoved[from] || mRemoved[to])
+            return false;
+
+        mWedgeMap.clear();
+        mRemovedTriangles.clear();
+
+        const std::vector<unsigned int> &around = mTriangles[from];
+
+        // The triangles on the edge go away, they tell which wedge of the target each of ours becomes
+        for(unsigned int i = 0; i < around.size(); i++) {
+
+            unsigned int t = around[i];
+
+            if(!mTriangleAlive[t])
+                continue;
+
+            unsigned int wedgeFrom = ~0u, wedgeTo = ~0u;
+
+            for(unsigned int k = 0; k < 3; k++) {
+                unsigned int w = mCorners[t * 3 + k];
+                if(mWedgePosition[w] == from) wedgeFrom = w;
+                if(mWedgePosition[w] == to)   wedgeTo   = w;
+            }
+
+            if(wedgeTo == ~0u)
+                continue;
+
+            mRemovedTriangles.push_back(t);
+
+            bool known = false;
+
+            for(unsigned int m = 0; m < mWedgeMap.size(); m++) {
+
+                if(mWedgeMap[m].first != wedgeFrom)
+                    continue;
+
+                // The same corner can't end up as two different wedges
+                if(mWedgeMap[m].second != wedgeTo)
+                    return false;
+
+                known = true;
+            }
+
+            if(!known)
+                mWedgeMap.push_back(std::make_pair(wedgeFrom, wedgeTo));
+        }
+
+        if(mRemovedTriangles.empty() || mRemovedTriangles.size() > 2)
+            return false;
+
+        // The remaining triangles keep their shape and their attributes
+        for(unsigned int i = 0; i < around.size(); i++) {
+
+            unsigned int t = around[i];
+
+            if(!mTriangleAlive[t] || std::find(mRemovedTriangles.begin(), mRemovedTriangles.end(), t) != mRemovedTriangles.end())
+                continue;
+
+            unsigned int wedgeFrom = mCorners[t * 3 + cornerAt(t, from)];
+            bool mapped = false;
+
+            for(unsigned int m = 0; m < mWedgeMap.size(); m++)
+                mapped = mapped || mWedgeMap[m].first == wedgeFrom;
+
+            // A corner on the far side of a seam, moving it would drag the seam off its path
+            if(!mapped)
+                return false;
+
+            glm::dvec3 before = triangleNormal(t, ~0u, glm::vec3());
+            glm::dvec3 after  = triangleNormal(t, from, mPositions[to]);
+
+            double lengths = glm::length(before) * glm::length(after);
+
+            if(lengths <= 0.0 || glm::dot(before, after) < MIN_NORMAL_COSINE * lengths)
+                return false;
+        }
+
+        // Only neighbours across the removed triangles may be shared, or the surface would pinch
+        gatherNeighbours(from, mNeighboursFrom);
+        gatherNeighbours(to,   mNeighboursTo);
+
+        unsigned int shared = 0;
+
+        for(unsigned int i = 0; i < mNeighboursFrom.size(); i++) {
+            if(std::binary_search(mNeighboursTo.begin(), mNeighboursTo.end(), mNeighboursFrom[i]))
+                shared++;
+        }
+
+        if(shared != mRemovedTriangles.size())
+            return false;
+
+        Quadric q = mQuadrics[from];
+        q += mQuadrics[to];
+
+        cost = q.error(mPositions[to]);
+
+        return true;
+    }
+
+
+    void Simplifier::collapse(unsigned int from, unsigned int to) {
+
+        for(unsigned int i = 0; i < mRemovedTriangles.size(); i++) {
+            mTriangleAlive[mRemovedTriangles[i]] = false;
+            mAliveTriangles--;
+        }
+
+        std::vector<unsigned int> &around = mTriangles[from];
+
+        for(unsigned int i = 0; i < around.size(); i++) {
+
+            unsigned int t = around[i];
+
+            if(!mTriangleAlive[t])
+                continue;
+
+            unsigned int &w = mCorners[t * 3 + cornerAt(t, from)];
+
+            for(unsigned int m = 0; m < mWedgeMap.size(); m++) {
+                if(mWedgeMap[m].first == w) {
+                    w = mWedgeMap[m].second;
+                    break;
+                }
+            }
+
+            mTriangles[to].push_back(t);
+        }
+
+        around.clear();
+
+        mQuadrics[to] += mQuadrics[from];
+        mRemoved[from] = true;
+
+        // Everything around the target has a new neighbourhood, look for new collapses there
+        compact(to);
+
+        std::vector<unsigned int> neighbours;
+        gatherNeighbours(to, neighbours);
+
+        mVersions[to]++;
+        pushBest(to);
+
+        for(unsigned int i = 0; i < neighbours.size(); i++) {
+            compact(neighbours[i]);
+            mVersions[neighbours[i]]++;
+            pushBest(neighbours[i]);
+        }
+    }
+
+
+    void Simplifier::pushBest(unsigned int position) {
+
+        if(mLocked[position] || mRemoved[position])
+            return;
+
+        std::vector<unsigned int> neighbours;
+        gatherNeighbours(position, neighbours);
+
+        Collapse best;
+        best.cost = -1.0;
+
+        for(unsigned int i = 0; i < neighbours.size(); i++) {
+
+            double cost;
+
+            if(!evaluate(position, neighbours[i], cost))
+                continue;
+
+            if(best.cost < 0.0 || cost < best.cost) {
+                best.cost = cost;
+                best.to   = neighbours[i];
+            }
+        }
+
+        if(best.cost < 0.0)
+            return;
+
+        best.from    = position;
+        best.version = mVersions[position];
+
+        mQueue.push(best);
+    }
+
+
+    void Simplifier::gatherNeighbours(unsigned int position, std::vector<unsigned int> &neighbours) {
+
+        neighbours.clear();
+
+        const std::vector<unsigned int> &around = mTriangles[position];
+
+        for(unsigned int i = 0; i < around.size(); i++) {
+
+            unsigned int t = around[i];
+
+            if(!mTriangleAlive[t])
+                continue;
+
+            for(unsigned int k = 0; k < 3; k++) {
+                unsigned int p = mWedgePosition[mCorners[t * 3 + k]];
+                if(p != position)
+                    neighbours.push_back(p);
+            }
+        }
+
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    }
+
+
+    void Simplifier::compact(unsigned int position) {
+
+        std::vector<unsigned int> &around = mTriangles[position];
+
+        unsigned int kept = 0;
+
+        for(unsigned int i = 0; i < around.size(); i++) {
+            if(mTriangleAlive[around[i]])
+                around[kept++] = around[i];
+        }
+
+        around.resize(kept);
+    }
+
+
+    unsigned int Simplifier::positionOf(unsigned int t, unsigned int k) {
+
+        return mWedgePosition[mCorners[t * 3 + k]];
+    }
+
+
+    // Which corner of triangle t is at the given position
+    unsigned int Simplifier::cornerAt(unsigned int t, unsigned int position) {
+
+        for(unsigned int k = 0; k < 3; k++) {
+            if(mWedgePosition[mCorners[t * 3 + k]] == position)
+                return k;
+        }
+
+        return 0;
+    }
+
+
+    // Unnormalized normal of triangle t, with the corner at position moved to p when there is one
+    glm::dvec3 Simplifier::triangleNormal(unsigned int t, unsigned int position, const glm::vec3 &p) {
+
+        glm::dvec3 v[3];
+
+        for(unsigned int k = 0; k < 3; k++) {
+            unsigned int q = mWedgePosition[mCorners[t * 3 + k]];
+            v[k] = glm::dvec3(q == position ? p : mPositions[q]);
+        }
+
+        return glm::cross(v[1] - v[0], v[2] - v[0]);
+    }
+}
+
+
+void weldMesh(
+    std::vector<glm::vec3> & vertices,
+    std::vector<glm::vec2> & uvs,
+    std::vector<glm::vec3> & normals,
+    std::vector<unsigned int> & indices
+) {
+    std::map<std::array<float, 8>, unsigned int> unique;
+
+    std::vector<glm::vec3> weldedVertices, weldedNormals;
+    std::vector<glm::vec2> weldedUvs;
+
+    indices.resize(vertices.size());
+
+    // Vertices keep the order they first appear in, which keeps neighbouring triangles close in memory
+    for(unsigned int i = 0; i < vertices.size(); i++) {
+
+        std::array<float, 8> key = {{
+            vertices[i].x, vertices[i].y, vertices[i].z,
+            uvs[i].x,      uvs[i].y,
+            normals[i].x,  normals[i].y,  normals[i].z
+        }};
+
+        std::map<std::array<float, 8>, unsigned int>::iterator it = unique.find(key);
+
+        if(it == unique.end()) {
+
+            it = unique.insert(std::make_pair(key, static_cast<unsigned int>(weldedVertices.size()))).first;
+
+            weldedVertices.push_back(vertices[i]);
+            weldedUvs     .push_back(uvs[i]);
+            weldedNormals .push_back(normals[i]);
+        }
+
+        indices[i] = it->second;
+    }
+
+    vertices.swap(weldedVertices);
+    uvs     .swap(weldedUvs);
+    normals .swap(weldedNormals);
+}
+
+
+void buildLODChain(
+    const std::vector<glm::vec3> & vertices,
+    std::vector<unsigned int> & indices,
+    std::vector<MeshLOD> & lods,
+    float ratio,
+    unsigned int minTriangles
+) {
+    lods.clear();
+
+    MeshLOD full;
+    full.first = 0;
+    full.count = indices.size();
+
+    lods.push_back(full);
+
+    Simplifier simplifier(vertices, indices);
+
+    unsigned int triangles = simplifier.getTriangleCount();
+
+    for(;;) {
+
+        unsigned int target = static_cast<unsigned int>(triangles * ratio);
+
+        if(target < minTriangles)
+            break;
+
+        simplifier.simplify(target);
+
+        // Stop when the collapses run out before getting noticeably coarser
+        if(simplifier.getTriangleCount() > triangles - (triangles - target) / 2)
+            break;
+
+        triangles = simplifier.getTriangleCount();
+
+        MeshLOD lod;
+        lod.first = indices.size();
+
+        simplifier.appendTriangles(indices);
+
+        lod.count = indices.size() - lod.first;
+
+        lods.push_back(lod);
+    }
+}
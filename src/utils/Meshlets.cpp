@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "../../include/utils/Meshlets.h"
+
+namespace {
+
+    // Spreads the lower 10 bits so that there are two zero bits between each
+    unsigned int spreadBits(unsigned int v) {
+
+        v = (v | (v << 16)) & 0x030000ffu;
+        v = (v | (v << 8))  & 0x0300f00fu;
+        v = (v | (v << 4))  & 0x030c30c3u;
+        v = (v | (v << 2))  & 0x09249249u;
+        return v;
+    }
+}
+
+
+void buildMeshlets(const std::vector<glm::vec3> &vertices, const std::vector<unsigned int> &indices, std::vector<unsigned int> &triangles, std::vector<Meshlet> &meshlets, unsigned int maxTriangles) {
+
+    if(triangles.empty() || maxTriangles == 0)
+        return;
+
+    // Morton code of the triangle centers in the bounding box of all of them
+    std::vector<glm::vec3> centers(triangles.size());
+
+    glm::vec3 low(std::numeric_limits<float>::max());
+    glm::vec3 high(-std::numeric_limits<float>::max());
+
+    for(unsigned int i = 0; i < triangles.size(); i++) {
+
+        const unsigned int *t = &indices[triangles[i] * 3];
+
+        centers[i] = (vertices[t[0]] + vertices[t[1]] + vertices[t[2]]) / 3.0f;
+
+        low  = glm::min(low,  centers[i]);
+        high = glm::max(high, centers[i]);
+    }
+
+    glm::vec3 scale = 1023.0f / glm::max(high - low, glm::vec3(1e-6f));
+
+    std::vector<std::pair<unsigned int, unsigned int> > keys(triangles.size());
+
+    for(unsigned int i = 0; i < triangles.size(); i++) {
+
+        glm::vec3 cell = (centers[i] - low) * scale;
+
+        keys[i].first  = spreadBits(static_cast<unsigned int>(cell.x))
+                       | spreadBits(static_cast<unsigned int>(cell.y)) << 1
+                       | spreadBits(static_cast<unsigned int>(cell.z)) << 2;
+        keys[i].second = triangles[i];
+    }
+
+    std::stable_sort(keys.begin(), keys.end(), [](const std::pair<unsigned int, unsigned int> &a, const std::pair<unsigned int, unsigned int> &b) { return a.first < b.first; });
+
+    for(unsigned int i = 0; i < triangles.size(); i++)
+        triangles[i] = keys[i].second;
+
+    // Consecutive runs along the curve
+    for(unsigned int first = 0; first < triangles.size(); first += maxTriangles) {
+
+        unsigned int last = std::min(first + maxTriangles, static_cast<unsigned int>(triangles.size()));
+
+        Meshlet meshlet;
+        meshlet.firstIndex = first * 3;
+        meshlet.count      = (last - first) * 3;
+
+        // Sphere around the center of the bounding box
+        glm::vec3 boxLow(std::numeric_limits<float>::max());
+        glm::vec3 boxHigh(-std::numeric_limits<float>::max());
+        glm::vec3 normalSum(0.0f);
+
+        for(unsigned int i = first; i < last; i++) {
+
+            const unsigned int *t = &indices[triangles[i] * 3];
+
+            for(unsigned int c = 0; c < 3; c++) {
+                boxLow  = glm::min(boxLow,  vertices[t[c]]);
+                boxHigh = glm::max(boxHigh, vertices[t[c]]);
+            }
+
+            glm::vec3 n = glm::cross(vertices[t[1]] - vertices[t[0]], vertices[t[2]] - vertices[t[0]]);
+
+            if(glm::dot(n, n) > 0.0f)
+                normalSum += glm::normalize(n);
+        }
+
+        glm::vec3 center = (boxLow + boxHigh) * 0.5f;
+        float radius     = 0.0f;
+
+        for(unsigned int i = first; i < last; i++) {
+
+            const unsigned int *t = &indices[triangles[i] * 3];
+
+            for(unsigned int c = 0; c < 3; c++)
+                radius = std::max(radius, glm::length(vertices[t[c]] - center));
+        }
+
+        meshlet.sphere = glm::vec4(center, radius);
+
+        // Normal cone, a cosine of -1 is a cone that takes in every direction
+        meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+
+        if(glm::dot(normalSum, normalSum) > 0.0f) {
+
+            glm::vec3 axis = glm::normalize(normalSum);
+            float cosine   = 1.0f;
+
+            for(unsigned int i = first; i < last; i++) {
+
+                const unsigned int *t = &indices[triangles[i] * 3];
+
+                glm::vec3 n = glm::cross(vertices[t[1]] - vertices[t[0]], vertices[t[2]] - vertices[t[0]]);
+
+                if(glm::dot(n, n) > 0.0f)
+                    cosine = std::min(cosine, glm::dot(axis, glm::normalize(n)));
+            }
+
+            meshlet.cone = glm::vec4(axis, cosine);
+        }
+
+        meshlets.push_back(meshlet);
+    }
+}
@@ -0,0 +1,178 @@
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+
+#include <png.h>
+
+#include "../../include/utils/Regression.h"
+
+
+bool writePNG(const std::string &filename, int width, int height, const std::vector<GLubyte> &pixels) {
+
+    FILE *fp = fopen(filename.c_str(), "wb");
+    if(!fp)
+        return false;
+
+    png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if(!png_ptr) {
+        fclose(fp);
+        return false;
+    }
+
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    if(!info_ptr) {
+        png_destroy_write_struct(&png_ptr, (png_infopp) NULL);
+        fclose(fp);
+        return false;
+    }
+
+    if(setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        fclose(fp);
+        return false;
+    }
+
+    png_init_io(png_ptr, fp);
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGBA,
+        PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+
+    // OpenGL images start at the bottom row, PNG at the top
+    for(int y = height - 1; y >= 0; --y)
+        png_write_row(png_ptr, const_cast<png_bytep>(&pixels[y * width * 4]));
+
+    png_write_end(png_ptr, NULL);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(fp);
+
+    return true;
+}
+
+
+bool readPNG(const std::string &filename, int &width, int &height, std::vector<GLubyte> &pixels) {
+
+    FILE *fp = fopen(filename.c_str(), "rb");
+    if(!fp)
+        return false;
+
+    png_byte header[8];
+    if(fread(header, 1, 8, fp) != 8 || png_sig_cmp(header, 0, 8)) {
+        fclose(fp);
+        return false;
+    }
+
+    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if(!png_ptr) {
+        fclose(fp);
+        return false;
+    }
+
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    if(!info_ptr) {
+        png_destroy_read_struct(&png_ptr, (png_infopp) NULL, (png_infopp) NULL);
+        fclose(fp);
+        return false;
+    }
+
+    if(setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+        fclose(fp);
+        return false;
+    }
+
+    png_init_io(png_ptr, fp);
+    png_set_sig_bytes(png_ptr, 8);
+    png_read_info(png_ptr, info_ptr);
+
+    // Whatever was stored, expand it to 8 bit RGBA
+    png_set_expand(png_ptr);
+    png_set_strip_16(png_ptr);
+    png_set_gray_to_rgb(png_ptr);
+    png_set_add_alpha(png_ptr, 0xff, PNG_FILLER_AFTER);
+    png_read_update_info(png_ptr, info_ptr);
+
+    width  = png_get_image_width(png_ptr, info_ptr);
+    height = png_get_image_height(png_ptr, info_ptr);
+
+    pixels.resize(width * height * 4);
+
+    std::vector<png_bytep> rows(height);
+    for(int i = 0; i < height; ++i)
+        rows[height - 1 - i] = &pixels[i * width * 4];
+
+    png_read_image(png_ptr, &rows[0]);
+    png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+    fclose(fp);
+
+    return true;
+}
+
+
+ImageDiff compareImages(const std::vector<GLubyte> &a, const std::vector<GLubyte> &b, int width, int height, float threshold) {
+
+    ImageDiff diff;
+    diff.totalPixels = width * height;
+
+    if(a.size() != b.size() || a.size() != diff.totalPixels * 4) {
+        diff.mismatchedPixels = diff.totalPixels;
+        return diff;
+    }
+
+    // The largest possible YIQ delta is 35215, scale the threshold against it
+    const float maxDelta = 35215.0f * threshold * threshold;
+
+    for(unsigned int i = 0; i < a.size(); i += 4) {
+
+        float dr = static_cast<float>(a[i])     - static_cast<float>(b[i]);
+        float dg = static_cast<float>(a[i + 1]) - static_cast<float>(b[i + 1]);
+        float db = static_cast<float>(a[i + 2]) - static_cast<float>(b[i + 2]);
+
+        float y = dr * 0.29889531f + dg * 0.58662247f + db * 0.11448223f;
+        float q = dr * 0.59597799f - dg * 0.27417610f - db * 0.32180189f;
+        float p = dr * 0.21147017f - dg * 0.52261711f + db * 0.31114694f;
+
+        float delta = 0.5053f * y * y + 0.299f * q * q + 0.1957f * p * p;
+
+        if(delta > diff.maxDelta)
+            diff.maxDelta = delta;
+
+        if(delta > maxDelta)
+            diff.mismatchedPixels++;
+    }
+
+    diff.maxDelta = std::sqrt(diff.maxDelta / 35215.0f);
+
+    return diff;
+}
+
+
+bool loadTimings(const std::string &filename, std::map<std::string, double> &timings) {
+
+    std::ifstream stream(filename.c_str());
+    if(!stream.is_open())
+        return false;
+
+    std::string name;
+    double milliseconds;
+
+    while(stream >> name >> milliseconds)
+        timings[name] = milliseconds;
+
+    return true;
+}
+
+
+bool saveTimings(const std::string &filename, const std::map<std::string, double> &timings) {
+
+    std::ofstream stream(filename.c_str());
+    if(!stream.is_open())
+        return false;
+
+    for(std::map<std::string, double>::const_iterator it = timings.begin(); it != timings.end(); ++it)
+        stream << it->first << " " << it->second << "\n";
+
+    // A full disk only shows once the data is written out
+    stream.flush();
+
+    return stream.good();
+}
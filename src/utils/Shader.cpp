@@ -11,89 +11,147 @@ using namespace std;
 
 #include <GL/glew.h>
 
-#include "../../include/utils/Shader.h"
+#include "../../include/utils/GLStats.h"
 
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+#include "../../include/utils/Shader.h"
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+// Compiles one stage, 0 if the file can't be read or doesn't compile
+static GLuint CompileShader(GLenum type, const char * file_path){
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open()){
+	std::string ShaderCode;
+	std::ifstream ShaderStream(file_path, std::ios::in);
+	if(ShaderStream.is_open()){
 		std::string Line = "";
-		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
-		VertexShaderStream.close();
+		while(getline(ShaderStream, Line))
+			ShaderCode += "\n" + Line;
+		ShaderStream.close();
 	}else{
-		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
-		getchar();
+		printf("Impossible to open %s.\n", file_path);
 		return 0;
 	}
 
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
-	}
-
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
 
-	// Compile Vertex Shader
-	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-	glCompileShader(VertexShaderID);
+	printf("Compiling shader : %s\n", file_path);
+	GLuint ShaderID = glCreateShader(type);
+	char const * SourcePointer = ShaderCode.c_str();
+	glShaderSource(ShaderID, 1, &SourcePointer , NULL);
+	glCompileShader(ShaderID);
 
-	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(ShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 0 ){
-		std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("%s\n", &VertexShaderErrorMessage[0]);
+		std::vector<char> ShaderErrorMessage(InfoLogLength+1);
+		glGetShaderInfoLog(ShaderID, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+		printf("%s\n", &ShaderErrorMessage[0]);
 	}
 
-	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-	glCompileShader(FragmentShaderID);
-
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("%s\n", &FragmentShaderErrorMessage[0]);
+	if(Result == GL_FALSE){
+		glDeleteShader(ShaderID);
+		return 0;
 	}
 
-	// Link the program
-	printf("Linking program\n");
-	GLuint ProgramID = glCreateProgram();
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
+	return ShaderID;
+}
 
-	// Check the program
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
-		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-		printf("%s\n", &ProgramErrorMessage[0]);
+
+// Links the compiled stages and deletes them, 0 if any of them is missing or the program doesn't link.
+// Outputs to capture with transform feedback have to be known before linking.
+static GLuint LinkProgram(const GLuint * ShaderIDs, int count, const char * const * varyings = NULL, int varying_count = 0){
+
+	bool Compiled = true;
+
+	for(int i = 0; i < count; i++)
+		Compiled = Compiled && ShaderIDs[i];
+
+	GLuint ProgramID = 0;
+
+	if(Compiled){
+
+		GLint Result = GL_FALSE;
+		int InfoLogLength;
+
+		// Link the program
+		printf("Linking program\n");
+		ProgramID = glCreateProgram();
+		for(int i = 0; i < count; i++)
+			glAttachShader(ProgramID, ShaderIDs[i]);
+		if(varying_count > 0)
+			glTransformFeedbackVaryings(ProgramID, varying_count, varyings, GL_SEPARATE_ATTRIBS);
+		glLinkProgram(ProgramID);
+
+		// Check the program
+		glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+		glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if ( InfoLogLength > 0 ){
+			std::vector<char> ProgramErrorMessage(InfoLogLength+1);
+			glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+			printf("%s\n", &ProgramErrorMessage[0]);
+		}
+
+		if(Result == GL_FALSE){
+			glDeleteProgram(ProgramID);
+			ProgramID = 0;
+		}
 	}
 
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
+	for(int i = 0; i < count; i++){
+		if(ShaderIDs[i])
+			glDeleteShader(ShaderIDs[i]);
+	}
 
 	return ProgramID;
-}
\ No newline at end of file
+}
+
+
+GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+
+	GLuint ShaderIDs[2] = {
+		CompileShader(GL_VERTEX_SHADER,   vertex_file_path),
+		CompileShader(GL_FRAGMENT_SHADER, fragment_file_path)
+	};
+
+	return LinkProgram(ShaderIDs, 2);
+}
+
+
+GLuint LoadTransformFeedbackShader(const char * vertex_file_path, const char * const * varyings, int varying_count){
+
+	GLuint ShaderID = CompileShader(GL_VERTEX_SHADER, vertex_file_path);
+
+	return LinkProgram(&ShaderID, 1, varyings, varying_count);
+}
+
+
+GLuint LoadShaders(const char * vertex_file_path, const char * control_file_path, const char * evaluation_file_path, const char * fragment_file_path){
+
+	GLuint ShaderIDs[4] = {
+		CompileShader(GL_VERTEX_SHADER,          vertex_file_path),
+		CompileShader(GL_TESS_CONTROL_SHADER,    control_file_path),
+		CompileShader(GL_TESS_EVALUATION_SHADER, evaluation_file_path),
+		CompileShader(GL_FRAGMENT_SHADER,        fragment_file_path)
+	};
+
+	return LinkProgram(ShaderIDs, 4);
+}
+
+
+GLuint LoadShaders(const char * vertex_file_path, const char * geometry_file_path, const char * fragment_file_path){
+
+	GLuint ShaderIDs[3] = {
+		CompileShader(GL_VERTEX_SHADER,   vertex_file_path),
+		CompileShader(GL_GEOMETRY_SHADER, geometry_file_path),
+		CompileShader(GL_FRAGMENT_SHADER, fragment_file_path)
+	};
+
+	return LinkProgram(ShaderIDs, 3);
+}
+
+
+GLuint LoadComputeShader(const char * compute_file_path){
+
+	GLuint ShaderID = CompileShader(GL_COMPUTE_SHADER, compute_file_path);
+
+	return LinkProgram(&ShaderID, 1);
+}
@@ -0,0 +1,181 @@
+#include <iostream>
+
+#include "../../include/utils/StreamBuffer.h"
+
+
+StreamBuffer::StreamBuffer() {
+
+    for(unsigned int i = 0; i < FRAMES_IN_FLIGHT; i++)
+        mFences[i] = 0;
+}
+
+
+StreamBuffer::~StreamBuffer() {
+
+    for(unsigned int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+        if(mFences[i])
+            glDeleteSync(mFences[i]);
+    }
+
+    if(mPersistent && bufferID) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+
+    glDeleteBuffers(1, &bufferID);
+}
+
+
+bool StreamBuffer::initialize(GLsizeiptr frameSize) {
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    if(alignment > 0)
+        mUniformAlignment = alignment;
+
+    // Keep every region aligned for anything we bind out of it
+    mRegionSize = (frameSize + mUniformAlignment - 1) / mUniformAlignment * mUniformAlignment;
+
+    GLsizeiptr size = mRegionSize * FRAMES_IN_FLIGHT;
+
+    glGenBuffers(1, &bufferID);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+
+    mPersistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+
+    if(mPersistent) {
+
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+        mMapping = static_cast<GLubyte *>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+
+        // Fall back to mapping per allocation if the driver won't give us the whole thing
+        if(!mMapping) {
+            glDeleteBuffers(1, &bufferID);
+            glGenBuffers(1, &bufferID);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+            mPersistent = false;
+        }
+    }
+
+    if(!mPersistent)
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    std::cout << "Stream buffer: " << FRAMES_IN_FLIGHT << " x " << mRegionSize << " bytes, "
+              << (mPersistent ? "persistent mapping" : "unsynchronized mapping") << std::endl;
+
+    return true;
+}
+
+
+void StreamBuffer::beginFrame() {
+
+    mUsed = 0;
+
+    GLsync &fence = mFences[mRegion];
+
+    if(!fence)
+        return;
+
+    // Only blocks when the CPU is FRAMES_IN_FLIGHT frames ahead of the GPU
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+
+    for(;;) {
+
+        GLenum result = glClientWaitSync(fence, flags, 1000000);
+
+        if(result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+            break;
+
+        flags = 0;
+    }
+
+    glDeleteSync(fence);
+    fence = 0;
+}
+
+
+void StreamBuffer::endFrame() {
+
+    if(mFences[mRegion])
+        glDeleteSync(mFences[mRegion]);
+
+    mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    mRegion = (mRegion + 1) % FRAMES_IN_FLIGHT;
+}
+
+
+StreamAllocation StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment) {
+
+    StreamAllocation allocation;
+
+    GLsizeiptr start = (mUsed + alignment - 1) / alignment * alignment;
+
+    if(!bufferID || start + size > mRegionSize) {
+
+        if(!mOverflowReported) {
+            std::cout << "Stream buffer is out of space, " << size << " bytes were requested" << std::endl;
+            mOverflowReported = true;
+        }
+
+        return allocation;
+    }
+
+    mUsed = start + size;
+
+    allocation.buffer = bufferID;
+    allocation.offset = mRegion * mRegionSize + start;
+    allocation.size   = size;
+
+    if(mPersistent) {
+        allocation.data = mMapping + allocation.offset;
+    }
+    else {
+        // The fence in beginFrame() made sure nobody reads this range anymore
+        glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+        allocation.data = glMapBufferRange(GL_COPY_WRITE_BUFFER, allocation.offset, size,
+                                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+
+    GLStats::upload(static_cast<unsigned int>(size));
+
+    return allocation;
+}
+
+
+bool StreamBuffer::commit(const StreamAllocation &allocation) {
+
+    // Coherent mappings need nothing, the writes are visible to commands issued after them
+    if(mPersistent || !allocation.data)
+        return true;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+
+    // The contents of the range are undefined when this fails, a display mode change can do that
+    if(glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_FALSE) {
+
+        if(!mLossReported) {
+            std::cout << "Stream buffer mapping was lost, the data is uploaded again" << std::endl;
+            mLossReported = true;
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+
+void StreamBuffer::upload(const StreamAllocation &allocation, const void *data) {
+
+    if(!allocation.buffer)
+        return;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, allocation.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset, allocation.size, data);
+}
@@ -0,0 +1,104 @@
+#include <algorithm>
+
+#include "../../include/utils/WorkerPool.h"
+
+
+WorkerPool::WorkerPool(unsigned int threads)
+    : mNext(0) {
+
+    if(threads == 0) {
+        unsigned int hardware = std::thread::hardware_concurrency();
+        threads = hardware > 1 ? hardware - 1 : 0;
+    }
+
+    for(unsigned int i = 0; i < threads; i++)
+        mThreads.push_back(std::thread(&WorkerPool::workerLoop, this));
+}
+
+
+WorkerPool::~WorkerPool() {
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+
+    mWake.notify_all();
+
+    for(unsigned int i = 0; i < mThreads.size(); i++)
+        mThreads[i].join();
+}
+
+
+void WorkerPool::parallelFor(unsigned int count, unsigned int grain, Job job, void *context) {
+
+    if(count == 0)
+        return;
+
+    grain = std::max(grain, 1u);
+
+    // Not worth waking anybody up
+    if(mThreads.empty() || count <= grain) {
+        job(0, count, context);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mJob     = job;
+        mContext = context;
+        mCount   = count;
+        mGrain   = grain;
+        mBusy    = static_cast<unsigned int>(mThreads.size());
+        mNext.store(0);
+        mGeneration++;
+    }
+
+    mWake.notify_all();
+
+    while(runChunk());
+
+    // Wait for the workers to finish the chunks they already took
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this]() { return mBusy == 0; });
+}
+
+
+void WorkerPool::workerLoop() {
+
+    unsigned int generation = 0;
+
+    for(;;) {
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [this, generation]() { return mQuit || mGeneration != generation; });
+
+            if(mQuit)
+                return;
+
+            generation = mGeneration;
+        }
+
+        while(runChunk());
+
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if(--mBusy == 0)
+            mDone.notify_one();
+    }
+}
+
+
+bool WorkerPool::runChunk() {
+
+    unsigned int begin = mNext.fetch_add(mGrain);
+
+    if(begin >= mCount)
+        return false;
+
+    mJob(begin, std::min(begin + mGrain, mCount), mContext);
+
+    return true;
+}